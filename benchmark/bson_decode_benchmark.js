@@ -0,0 +1,75 @@
+var BSON = require('../lib/mongodb').BSONNative.BSON,
+  Matcher = require('../lib/mongodb').BSONNative.Matcher;
+
+var COUNT = 1000000;
+var BATCH_SIZE = 1000;
+
+// One reply worth of documents sharing the same fields
+var documents = [];
+var size = 0;
+for(var i = 0; i < BATCH_SIZE; i++) {
+  documents.push(BSON.serialize({_id:i, name:'user' + i, status:i % 3 == 0 ? 'active' : 'inactive',
+    country:'US', score:i * 1.5, address:{street:'Main Street', city:'Springfield', zip:i % 100}}, false, true));
+  size = size + documents[documents.length - 1].length;
+}
+
+var batch = new Buffer(size);
+var index = 0;
+for(var i = 0; i < documents.length; i++) {
+  documents[i].copy(batch, index);
+  index = index + documents[i].length;
+}
+
+// Decode the batch and walk the fields of every document
+var run = function(title, decode) {
+  var total = 0, start, end;
+  console.log(COUNT + "x " + title);
+  start = new Date
+
+  for(var j = 0; j < COUNT / BATCH_SIZE; j++) {
+    var docs = decode();
+    for(var k = 0; k < docs.length; k++) {
+      total = total + docs[k]._id + docs[k].score + docs[k].address.zip + docs[k].status.length;
+    }
+  }
+
+  end = new Date
+  console.log("time = ", end - start, "ms -", COUNT * 1000 / (end - start), " docs/sec", total)
+}
+
+run("(BSON.deserialize(document)) and iterate", function() {
+  var docs = new Array(BATCH_SIZE);
+  for(var k = 0; k < BATCH_SIZE; k++) {
+    docs[k] = BSON.deserialize(documents[k]);
+  }
+  return docs;
+});
+
+run("(BSON.deserializeStream(batch, ...)) and iterate", function() {
+  var docs = new Array(BATCH_SIZE);
+  BSON.deserializeStream(batch, 0, BATCH_SIZE, docs, 0);
+  return docs;
+});
+
+run("(BSON.deserializeStream(batch, ..., {internStrings:true})) and iterate", function() {
+  var docs = new Array(BATCH_SIZE);
+  BSON.deserializeStream(batch, 0, BATCH_SIZE, docs, 0, {internStrings:true});
+  return docs;
+});
+
+// Keep the active users, filtering the decoded documents or the serialized ones
+run("(BSON.deserializeStream(batch, ...)) and filter the documents", function() {
+  var docs = new Array(BATCH_SIZE);
+  BSON.deserializeStream(batch, 0, BATCH_SIZE, docs, 0);
+  return docs.filter(function(doc) { return doc.status == 'active' && doc.score >= 300; });
+});
+
+var matcher = new Matcher({status:'active', score:{$gte:300}});
+run("(matcher.filter(batch, ...)) and decode the matches", function() {
+  var matches = matcher.filter(batch, 0, BATCH_SIZE);
+  var docs = new Array(matches.length);
+  for(var k = 0; k < matches.length; k++) {
+    BSON.deserializeStream(batch, matches[k], 1, docs, k);
+  }
+  return docs;
+});
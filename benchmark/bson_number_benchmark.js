@@ -0,0 +1,38 @@
+var BSON = require('../lib/mongodb').BSONNative.BSON,
+  debug = require('util').debug,
+  inspect = require('util').inspect;
+
+var COUNT = 100000;
+
+// Build documents with a mix of int32, large integer and fractional values
+var numbers = [];
+for(var i = 0; i < 100; i++) {
+  numbers.push(Math.floor(Math.random() * 0xffffffff) - 0x7fffffff);
+  numbers.push(Math.floor((Math.random() - 0.5) * 0x20000000000000));
+  numbers.push((Math.random() - 0.5) * 1000);
+}
+
+var object = {numbers:numbers};
+var x, start, end, j;
+
+console.log(COUNT + "x (objectBSON = BSON.serialize(object, false, true))")
+start = new Date
+
+for (j=COUNT; --j>=0; ) {
+  x = BSON.serialize(object, false, true);
+}
+
+end = new Date
+console.log("bson size (bytes): ", x.length)
+console.log("time = ", end - start, "ms -", COUNT * 1000 / (end - start), " ops/sec")
+
+console.log(COUNT + "x (objectBSON = BSON.serialize(object, false, true, false, true))")
+start = new Date
+
+for (j=COUNT; --j>=0; ) {
+  x = BSON.serialize(object, false, true, false, true);
+}
+
+end = new Date
+console.log("bson size (bytes): ", x.length)
+console.log("time = ", end - start, "ms -", COUNT * 1000 / (end - start), " ops/sec")
@@ -34,10 +34,28 @@ Binary::Binary(uint32_t sub_type, uint32_t number_of_bytes, uint32_t index, char
   this->number_of_bytes = number_of_bytes;
   this->index = index;
   this->data = data;  
+  // Let the GC know about the memory we hold on to
+  V8::AdjustAmountOfExternalAllocatedMemory(number_of_bytes);
 }
 
 Binary::~Binary() {
   free(this->data);
+  V8::AdjustAmountOfExternalAllocatedMemory(-(int)this->number_of_bytes);
+}
+
+void Binary::reserve(uint32_t capacity) {
+  if(capacity <= this->number_of_bytes) return;
+  // Reallocate and account for the extra memory
+  this->data = (char *)realloc(this->data, capacity);
+  V8::AdjustAmountOfExternalAllocatedMemory(capacity - this->number_of_bytes);
+  this->number_of_bytes = capacity;
+}
+
+void Binary::grow(uint32_t needed) {
+  if(needed <= this->number_of_bytes) return;
+  // Double the space to keep the number of reallocations logarithmic in the final size
+  uint32_t doubled = this->number_of_bytes * 2;
+  this->reserve(needed > doubled ? needed : doubled);
 }
 
 Handle<Value> Binary::New(const Arguments &args) {
@@ -52,6 +70,12 @@ Handle<Value> Binary::New(const Arguments &args) {
     char *oid_string_bytes = (char *)malloc(256);
     *(oid_string_bytes) = '\0';
     binary = new Binary(BSON_BINARY_SUBTYPE_DEFAULT, 256, 0, oid_string_bytes);
+  } else if(args.Length() == 1 && args[0]->IsUint32()) {
+    // Preallocate the requested capacity
+    uint32_t capacity = args[0]->Uint32Value();
+    char *data = (char *)malloc(capacity + 1);
+    *(data) = '\0';
+    binary = new Binary(BSON_BINARY_SUBTYPE_DEFAULT, capacity, 0, data);
   } else if(args.Length() == 1 && Buffer::HasInstance(args[0])) {
     // Define pointer to data
     char *data;
@@ -73,8 +97,8 @@ Handle<Value> Binary::New(const Arguments &args) {
     char *storedData = (char *)malloc(length * sizeof(char));
     // Copy from one to the other
     memcpy(storedData, data, length);
-    // Create a binary object
-    binary = new Binary(BSON_BINARY_SUBTYPE_DEFAULT, length, 0, storedData);
+    // Create a binary object holding all the bytes of the buffer
+    binary = new Binary(BSON_BINARY_SUBTYPE_DEFAULT, length, length, storedData);
   } else if(args.Length() == 1 && args[0]->IsString()) {
     Local<String> str = args[0]->ToString();
     // Contains the bytes for the data
@@ -108,8 +132,8 @@ Handle<Value> Binary::New(const Arguments &args) {
     memcpy(storedData, data, length);
     // Decode the subtype
     uint32_t sub_type = intr->Uint32Value();
-    // Create a binary object
-    binary = new Binary(sub_type, length, 0, storedData);
+    // Create a binary object holding all the bytes of the buffer
+    binary = new Binary(sub_type, length, length, storedData);
   } else if(args.Length() == 2 && args[1]->IsNumber() && args[0]->IsString()) {    
     Local<String> str = args[0]->ToString();
     Local<Integer> intr = args[1]->ToInteger();
@@ -122,7 +146,7 @@ Handle<Value> Binary::New(const Arguments &args) {
     uint32_t sub_type = intr->Uint32Value();
     binary = new Binary(sub_type, str->Length(), str->Length(), oid_string_bytes);
   } else {
-    return VException("Argument must be either none, a string or a string and a int, a buffer or a buffer and a int");        
+    return VException("Argument must be either none, a capacity, a string or a string and a int, a buffer or a buffer and a int");        
   }
   
   // Wrap it
@@ -133,6 +157,21 @@ Handle<Value> Binary::New(const Arguments &args) {
 
 static Persistent<String> subtype_symbol;
 
+Handle<Value> Binary::NewInstance(uint32_t sub_type, uint32_t number_of_bytes, char *data) {
+  HandleScope scope;
+
+  // Copy the data, keep one byte extra for the null termination like the string constructor
+  char *stored_data = (char *)malloc(number_of_bytes + 1);
+  memcpy(stored_data, data, number_of_bytes);
+  *(stored_data + number_of_bytes) = '\0';
+
+  // Instantiate straight from the instance template, skipping the argument parsing in New
+  Local<Object> binary_obj = constructor_template->InstanceTemplate()->NewInstance();
+  Binary *binary = new Binary(sub_type, number_of_bytes, number_of_bytes, stored_data);
+  binary->Wrap(binary_obj);
+  return scope.Close(binary_obj);
+}
+
 void Binary::Initialize(Handle<Object> target) {
   // Grab the scope of the call from Node
   HandleScope scope;
@@ -152,6 +191,8 @@ void Binary::Initialize(Handle<Object> target) {
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "length", Length);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "put", Put);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "write", Write);
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "writeMany", WriteMany);
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "reserve", Reserve);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "read", Read);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "readInto", ReadInto);
   NODE_SET_PROTOTYPE_METHOD(constructor_template, "toJSON", ToJSON);
@@ -182,6 +223,45 @@ void Binary::SubtypeSetter(Local<String> property, Local<Value> value, const Acc
   }
 }
 
+Handle<Value> Binary::WriteMany(const Arguments &args) {
+  HandleScope scope;
+
+  // Ensure we have the right parameters
+  if(args.Length() != 1 || !args[0]->IsArray()) return VException("Function takes one argument of type Array containing Buffers");
+  Local<Array> buffers = Local<Array>::Cast(args[0]);
+
+  // Total up the length first so we only grow once
+  uint32_t length = 0;
+  for(uint32_t i = 0; i < buffers->Length(); i++) {
+    Local<Value> buffer = buffers->Get(i);
+    if(!Buffer::HasInstance(buffer)) return VException("Function takes one argument of type Array containing Buffers");
+    length = length + Buffer::Length(buffer->ToObject());
+  }
+
+  Binary *binary = ObjectWrap::Unwrap<Binary>(args.This());
+  binary->grow(binary->index + length);
+
+  // Append all the buffers
+  for(uint32_t i = 0; i < buffers->Length(); i++) {
+    Local<Object> buffer = buffers->Get(i)->ToObject();
+    memcpy((binary->data + binary->index), Buffer::Data(buffer), Buffer::Length(buffer));
+    binary->index = binary->index + Buffer::Length(buffer);
+  }
+
+  return scope.Close(Null());
+}
+
+Handle<Value> Binary::Reserve(const Arguments &args) {
+  HandleScope scope;
+
+  // Ensure we have the right parameters
+  if(args.Length() != 1 || !args[0]->IsUint32()) return VException("Function takes one argument of type Integer, the capacity");
+
+  Binary *binary = ObjectWrap::Unwrap<Binary>(args.This());
+  binary->reserve(args[0]->Uint32Value());
+  return scope.Close(Null());
+}
+
 Handle<Value> Binary::Read(const Arguments &args) {
   HandleScope scope;
 
@@ -233,8 +313,8 @@ Handle<Value> Binary::Write(const Arguments &args) {
   HandleScope scope;
   
   // Ensure we have the right parameters
-  if(args.Length() == 1 && (!args[0]->IsString() || Buffer::HasInstance(args[0]))) return VException("Function takes one argument of type String or Buffer");
-  if(args.Length() == 2 && (!args[0]->IsString() || Buffer::HasInstance(args[0])) && !args[1]->IsUint32()) return VException("Function takes one argument of type String or Buffer");
+  if(args.Length() == 1 && !args[0]->IsString() && !Buffer::HasInstance(args[0])) return VException("Function takes one argument of type String or Buffer");
+  if(args.Length() == 2 && ((!args[0]->IsString() && !Buffer::HasInstance(args[0])) || !args[1]->IsUint32())) return VException("Function takes one argument of type String or Buffer");
   
   // Reference variables
   char *data;
@@ -267,15 +347,10 @@ Handle<Value> Binary::Write(const Arguments &args) {
   
   // Ensure we got enough allocated space for the content
   Binary *binary = ObjectWrap::Unwrap<Binary>(args.This());
-  // Check if we have enough space or we need to allocate more space
-  if((binary->index + length) > binary->number_of_bytes) {
-    // Realocate memory (and add double the current space to allow for more writing)
-    binary->data = (char *)realloc(binary->data, ((binary->number_of_bytes * 2) + length));
-    binary->number_of_bytes = (binary->number_of_bytes * 2) + length;
-  }
-  
   // If no offset specified use internal index
   if(offset == 0) offset = binary->index;
+  // Make sure the content fits (doubles the space when full)
+  binary->grow(offset + length);
   
   // Write the element out
   memcpy((binary->data + offset), data, length);
@@ -301,29 +376,19 @@ Handle<Value> Binary::Put(const Arguments &args) {
   ssize_t len = DecodeBytes(str, BINARY);
   if(len != 1) return VException("Function takes one argument of type String containing one character");
 
-  // Let's define the buffer that contains the regexp string
-  // char *data = new char[len + 1];
-  char *data = (char *)malloc(len * sizeof(char) + 1);
-  // Write the data to the buffer from the string object
-  ssize_t written = DecodeWrite(data, len, str, BINARY);
+  // Decode the character
+  char data[2];
+  DecodeWrite(data, len, str, BINARY);
 
   // Unpack the binary object
   Binary *binary = ObjectWrap::Unwrap<Binary>(args.This());
-  // Check if we need to adjust the size of the binary to fit more space
-  if((binary->index + len) > binary->number_of_bytes) {
-    // Realocate memory (and double the allocated space 256-512-1024-2048-4096) to try to lower
-    // the number of times we reallocate memory
-    binary->data = (char *)realloc(binary->data, binary->number_of_bytes * 2);
-    binary->number_of_bytes = binary->number_of_bytes * 2;
-  }
+  // Make sure we have space for one more byte (doubles the space when full)
+  binary->grow(binary->index + 1);
   
   // Write the element out
   *(binary->data + binary->index) = *(data);
   // Update the index pointer
   binary->index = binary->index + 1;
-  // Free up the data
-  // delete data;
-  free(data);
   // Return a null
   return scope.Close(Null());
 }
@@ -18,6 +18,10 @@ class Binary : public ObjectWrap {
     Binary(uint32_t sub_type, uint32_t number_of_bytes, uint32_t index, char *data);
     ~Binary();    
 
+    // Resize the allocated space to at least capacity bytes, grow ensures room for needed bytes doubling the space
+    void reserve(uint32_t capacity);
+    void grow(uint32_t needed);
+
     // Has instance check
     static inline bool HasInstance(Handle<Value> val) {
       if (!val->IsObject()) return false;
@@ -33,6 +37,8 @@ class Binary : public ObjectWrap {
     static Handle<Value> Length(const Arguments &args);
     static Handle<Value> Put(const Arguments &args);
     static Handle<Value> Write(const Arguments &args);
+    static Handle<Value> WriteMany(const Arguments &args);
+    static Handle<Value> Reserve(const Arguments &args);
     static Handle<Value> Read(const Arguments &args);
     static Handle<Value> ToJSON(const Arguments &args);
     
@@ -46,6 +52,8 @@ class Binary : public ObjectWrap {
 
     // Constructor used for creating new Long objects from C++
     static Persistent<FunctionTemplate> constructor_template;
+    // Create a new Binary instance with a copy of data without going through the JS constructor
+    static Handle<Value> NewInstance(uint32_t sub_type, uint32_t number_of_bytes, char *data);
 
     // Getter and Setter for object values
     static Handle<Value> SubtypeGetter(Local<String> property, const AccessorInfo& info);
@@ -22,6 +22,8 @@
 #include "minkey.h"
 #include "maxkey.h"
 #include "double.h"
+#include "matcher.h"
+#include "merger.h"
 
 using namespace v8;
 using namespace node;
@@ -32,6 +34,7 @@ const uint32_t BSON_DATA_STRING = 2;
 const uint32_t BSON_DATA_OBJECT = 3;
 const uint32_t BSON_DATA_ARRAY = 4;
 const uint32_t BSON_DATA_BINARY = 5;
+const uint32_t BSON_DATA_UNDEFINED = 6;
 const uint32_t BSON_DATA_OID = 7;
 const uint32_t BSON_DATA_BOOLEAN = 8;
 const uint32_t BSON_DATA_DATE = 9;
@@ -49,6 +52,11 @@ const uint32_t BSON_DATA_MAX_KEY = 0x7f;
 const int32_t BSON_INT32_MAX = (int32_t)2147483647L;
 const int32_t BSON_INT32_MIN = (int32_t)(-1) * 2147483648L;
 
+// Any integer up to 2^53 can be precisely represented by a double
+const double BSON_JS_INT_MAX = 9007199254740992.0;
+const double BSON_JS_INT_MIN = -9007199254740992.0;
+const int64_t BSON_JS_INT_LIMIT = 9007199254740992LL;
+
 // BSON BINARY DATA SUBTYPES
 const uint32_t BSON_BINARY_SUBTYPE_FUNCTION = 1;
 const uint32_t BSON_BINARY_SUBTYPE_BYTE_ARRAY = 2;
@@ -56,12 +64,35 @@ const uint32_t BSON_BINARY_SUBTYPE_UUID = 3;
 const uint32_t BSON_BINARY_SUBTYPE_MD5 = 4;
 const uint32_t BSON_BINARY_SUBTYPE_USER_DEFINED = 128;
 
+// Slots of the string intern table, a power of two
+const uint32_t BSON_INTERN_TABLE_SIZE = 512;
+// Longest string value in bytes that is interned, the size of InternedString::data
+const uint32_t BSON_INTERN_MAX_LENGTH = 32;
+// Entries of the regular expression cache
+const uint32_t BSON_REGEXP_CACHE_SIZE = 256;
+
+// Compiled regular expressions shared by all decode calls, least recently used first out. Serializing
+// only looks RegExps up, so user RegExps never evict decoded ones or stay alive in the cache
+static CachedRegExp regexp_cache[BSON_REGEXP_CACHE_SIZE];
+static uint64_t regexp_cache_clock = 0;
+// Cache metrics
+static uint32_t regexp_decode_hits = 0;
+static uint32_t regexp_decode_misses = 0;
+static uint32_t regexp_encode_hits = 0;
+static uint32_t regexp_encode_misses = 0;
+static uint32_t regexp_evictions = 0;
+
 static Handle<Value> VException(const char *msg) {
     HandleScope scope;
     return ThrowException(Exception::Error(String::New(msg)));
   };
 
 Persistent<FunctionTemplate> BSON::constructor_template;
+// Names of the fields of a timestamp decoded with the rawTimestamps option
+static Persistent<String> timestamp_seconds_symbol;
+static Persistent<String> timestamp_increment_symbol;
+// Hidden value of a cached RegExp holding the index of its cache entry
+static Persistent<String> regexp_cache_symbol;
 
 void BSON::Initialize(v8::Handle<v8::Object> target) {
   // Grab the scope of the call from Node
@@ -76,10 +107,19 @@ void BSON::Initialize(v8::Handle<v8::Object> target) {
   NODE_SET_METHOD(constructor_template->GetFunction(), "serialize", BSONSerialize);  
   NODE_SET_METHOD(constructor_template->GetFunction(), "serializeWithBufferAndIndex", SerializeWithBufferAndIndex);
   NODE_SET_METHOD(constructor_template->GetFunction(), "deserialize", BSONDeserialize);  
+  NODE_SET_METHOD(constructor_template->GetFunction(), "deserializeStream", BSONDeserializeStream);
   NODE_SET_METHOD(constructor_template->GetFunction(), "encodeLong", EncodeLong);  
   NODE_SET_METHOD(constructor_template->GetFunction(), "toLong", ToLong);
   NODE_SET_METHOD(constructor_template->GetFunction(), "toInt", ToInt);
   NODE_SET_METHOD(constructor_template->GetFunction(), "calculateObjectSize", CalculateObjectSize);
+  NODE_SET_METHOD(constructor_template->GetFunction(), "copyBinaryField", CopyBinaryField);
+  NODE_SET_METHOD(constructor_template->GetFunction(), "fromJSON", FromJSON);
+  NODE_SET_METHOD(constructor_template->GetFunction(), "toJSON", ToJSON);
+  NODE_SET_METHOD(constructor_template->GetFunction(), "regExpCacheStats", RegExpCacheStats);
+
+  timestamp_seconds_symbol = Persistent<String>::New(String::NewSymbol("t"));
+  timestamp_increment_symbol = Persistent<String>::New(String::NewSymbol("i"));
+  regexp_cache_symbol = Persistent<String>::New(String::NewSymbol("bson::regExpCacheEntry"));
 
   target->Set(String::NewSymbol("BSON"), constructor_template->GetFunction());
 }
@@ -98,9 +138,10 @@ Handle<Value> BSON::SerializeWithBufferAndIndex(const Arguments &args) {
 
   //BSON.serializeWithBufferAndIndex = function serializeWithBufferAndIndex(object, checkKeys, buffer, index) {
   // Ensure we have the correct values
-  if(args.Length() > 5) return VException("Four or five parameters required [object, boolean, Buffer, int] or [object, boolean, Buffer, int, boolean]");
+  if(args.Length() > 6) return VException("Four, five or six parameters required [object, boolean, Buffer, int] or [object, boolean, Buffer, int, boolean] or [object, boolean, Buffer, int, boolean, boolean]");
   if(args.Length() == 4 && !args[0]->IsObject() && !args[1]->IsBoolean() && !Buffer::HasInstance(args[2]) && !args[3]->IsUint32()) return VException("Four parameters required [object, boolean, Buffer, int]");
   if(args.Length() == 5 && !args[0]->IsObject() && !args[1]->IsBoolean() && !Buffer::HasInstance(args[2]) && !args[3]->IsUint32() && !args[4]->IsBoolean()) return VException("Four parameters required [object, boolean, Buffer, int, boolean]");
+  if(args.Length() == 6 && !args[0]->IsObject() && !args[1]->IsBoolean() && !Buffer::HasInstance(args[2]) && !args[3]->IsUint32() && !args[4]->IsBoolean() && !args[5]->IsBoolean()) return VException("Six parameters required [object, boolean, Buffer, int, boolean, boolean]");
 
   // Define pointer to data
   char *data;
@@ -120,7 +161,7 @@ Handle<Value> BSON::SerializeWithBufferAndIndex(const Arguments &args) {
   
   uint32_t object_size = 0;
   // Calculate the total size of the document in binary form to ensure we only allocate memory once
-  if(args.Length() == 5) {
+  if(args.Length() >= 5) {
     object_size = BSON::calculate_object_size(args[0], args[4]->BooleanValue());    
   } else {
     object_size = BSON::calculate_object_size(args[0], false);    
@@ -142,12 +183,18 @@ Handle<Value> BSON::SerializeWithBufferAndIndex(const Arguments &args) {
     }
     
     bool serializeFunctions = false;
-    if(args.Length() == 5) {
+    if(args.Length() >= 5) {
       serializeFunctions = args[4]->BooleanValue();
     }
     
+    // Write integers outside the int32 range as int64 instead of double
+    bool long_integers = false;
+    if(args.Length() == 6) {
+      long_integers = args[5]->BooleanValue();
+    }
+    
     // Serialize the object
-    BSON::serialize(serialized_object, 0, Null(), args[0], check_key, serializeFunctions);
+    BSON::serialize(serialized_object, 0, Null(), args[0], check_key, serializeFunctions, long_integers);
   } catch(char *err_msg) {
     // Free up serialized object space
     free(serialized_object);
@@ -174,12 +221,13 @@ Handle<Value> BSON::BSONSerialize(const Arguments &args) {
   if(args.Length() == 2 && !args[0]->IsObject() && !args[1]->IsBoolean()) return VException("One, two or tree arguments required - [object] or [object, boolean] or [object, boolean, boolean]");
   if(args.Length() == 3 && !args[0]->IsObject() && !args[1]->IsBoolean() && !args[2]->IsBoolean()) return VException("One, two or tree arguments required - [object] or [object, boolean] or [object, boolean, boolean]");
   if(args.Length() == 4 && !args[0]->IsObject() && !args[1]->IsBoolean() && !args[2]->IsBoolean() && !args[3]->IsBoolean()) return VException("One, two or tree arguments required - [object] or [object, boolean] or [object, boolean, boolean] or [object, boolean, boolean, boolean]");
-  if(args.Length() > 4) return VException("One, two, tree or four arguments required - [object] or [object, boolean] or [object, boolean, boolean] or [object, boolean, boolean, boolean]");
+  if(args.Length() == 5 && !args[0]->IsObject() && !args[1]->IsBoolean() && !args[2]->IsBoolean() && !args[3]->IsBoolean() && !args[4]->IsBoolean()) return VException("One, two, tree, four or five arguments required - [object] or [object, boolean] or [object, boolean, boolean] or [object, boolean, boolean, boolean] or [object, boolean, boolean, boolean, boolean]");
+  if(args.Length() > 5) return VException("One, two, tree, four or five arguments required - [object] or [object, boolean] or [object, boolean, boolean] or [object, boolean, boolean, boolean] or [object, boolean, boolean, boolean, boolean]");
 
   uint32_t object_size = 0;
   // Calculate the total size of the document in binary form to ensure we only allocate memory once
   // With serialize function
-  if(args.Length() == 4) {
+  if(args.Length() >= 4) {
     object_size = BSON::calculate_object_size(args[0], args[3]->BooleanValue());    
   } else {
     object_size = BSON::calculate_object_size(args[0], false);        
@@ -197,12 +245,18 @@ Handle<Value> BSON::BSONSerialize(const Arguments &args) {
 
     // Check if we have a boolean value
     bool serializeFunctions = false;
-    if(args.Length() == 4 && args[1]->IsBoolean()) {
+    if(args.Length() >= 4 && args[1]->IsBoolean()) {
       serializeFunctions = args[3]->BooleanValue();
     }
     
+    // Write integers outside the int32 range as int64 instead of double
+    bool long_integers = false;
+    if(args.Length() == 5) {
+      long_integers = args[4]->BooleanValue();
+    }
+    
     // Serialize the object
-    BSON::serialize(serialized_object, 0, Null(), args[0], check_key, serializeFunctions);      
+    BSON::serialize(serialized_object, 0, Null(), args[0], check_key, serializeFunctions, long_integers);      
   } catch(char *err_msg) {
     // Free up serialized object space
     free(serialized_object);
@@ -219,7 +273,7 @@ Handle<Value> BSON::BSONSerialize(const Arguments &args) {
   BSON::write_int32((serialized_object), object_size);  
 
   // If we have 3 arguments
-  if(args.Length() == 3 || args.Length() == 4) {
+  if(args.Length() >= 3) {
     // Local<Boolean> asBuffer = args[2]->ToBoolean();    
     Buffer *buffer = Buffer::New(serialized_object, object_size);
     // Release the serialized string
@@ -249,48 +303,1486 @@ Handle<Value> BSON::CalculateObjectSize(const Arguments &args) {
     object_size = BSON::calculate_object_size(args[0], false);
   }
 
-  // Return the object size
-  return scope.Close(Uint32::New(object_size));
-}
+  // Return the object size
+  return scope.Close(Uint32::New(object_size));
+}
+
+
+Handle<Value> BSON::ToLong(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() != 2 && !args[0]->IsString() && !args[1]->IsString()) return VException("Two arguments of type String required");
+  // Create a new Long value and return it
+  Local<Value> argv[] = {args[0], args[1]};
+  Handle<Value> long_obj = Long::constructor_template->GetFunction()->NewInstance(2, argv);    
+  return scope.Close(long_obj);
+}
+
+Handle<Value> BSON::ToInt(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() != 1 && !args[0]->IsNumber() && !args[1]->IsString()) return VException("One argument of type Number required");  
+  // Return int value
+  return scope.Close(args[0]->ToInt32());
+}
+
+Handle<Value> BSON::EncodeLong(const Arguments &args) {
+  HandleScope scope;
+  
+  // Encode the value
+  if(args.Length() != 1 && !Long::HasInstance(args[0])) return VException("One argument required of type Long");
+  // Unpack the object and encode
+  Local<Object> obj = args[0]->ToObject();
+  Long *long_obj = Long::Unwrap<Long>(obj);
+  // Allocate space
+  char *long_str = (char *)malloc(8 * sizeof(char));
+  // Write the content to the char array
+  BSON::write_int64((long_str), long_obj->value);
+  // Encode the data
+  Local<String> long_final_str = Encode(long_str, 8, BINARY)->ToString();
+  // Free up memory
+  free(long_str);
+  // Return the encoded string
+  return scope.Close(long_final_str);
+}
+
+// Copy a range of the bytes of a top level Binary field of a serialized document into a Buffer
+// without deserializing the document, arguments are (document, name, target, targetStart, sourceStart, sourceEnd)
+Handle<Value> BSON::CopyBinaryField(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() != 6 || !Buffer::HasInstance(args[0]) || !args[1]->IsString() || !Buffer::HasInstance(args[2])
+    || !args[3]->IsUint32() || !args[4]->IsUint32() || !args[5]->IsUint32()) {
+    return VException("Six arguments required - [buffer, string, buffer, number, number, number]");
+  }
+
+  Local<Object> document = args[0]->ToObject();
+  Local<Object> target = args[2]->ToObject();
+  char *data = Buffer::Data(document);
+  uint32_t length = Buffer::Length(document);
+  String::Utf8Value name(args[1]);
+  uint32_t target_start = args[3]->Uint32Value();
+  uint32_t source_start = args[4]->Uint32Value();
+  uint32_t source_end = args[5]->Uint32Value();
+
+  // Locate the field
+  int32_t index = BSON::find_field(data, length, *name);
+  if(index < 0) return VException("Field not found in document.");
+  // The type byte sits in front of the field name
+  if(BSON::deserialize_int8(data, index - name.length() - 2) != BSON_DATA_BINARY) return VException("Field is not of type Binary.");
+
+  // Clamp the requested range to the binary data
+  uint32_t number_of_bytes = BSON::deserialize_int32(data, index);
+  if(index + 4 + 1 + number_of_bytes > length) return VException("Binary field exceeds the document.");
+  if(source_end > number_of_bytes) source_end = number_of_bytes;
+  if(source_start > source_end) source_start = source_end;
+  uint32_t copy_length = source_end - source_start;
+  if(target_start + copy_length > Buffer::Length(target)) return VException("Target buffer is too small.");
+
+  // Skip the size and sub type and copy the bytes
+  memcpy(Buffer::Data(target) + target_start, data + index + 4 + 1 + source_start, copy_length);
+  return scope.Close(Uint32::New(copy_length));
+}
+
+// Encode JSON text straight into a BSON document without creating any objects, arguments are
+// (stringOrBuffer, [options]). Objects holding a single $oid, $date or $numberLong field are
+// written as ObjectID, Date and Long values
+Handle<Value> BSON::FromJSON(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() < 1 || args.Length() > 2 || (!args[0]->IsString() && !Buffer::HasInstance(args[0]))) {
+    return VException("One or two arguments required - [string] or [buffer] or [string, object] or [buffer, object]");
+  }
+
+  JSONEncoder encoder;
+  encoder.check_keys = false;
+  if(args.Length() == 2 && args[1]->IsObject()) {
+    encoder.check_keys = args[1]->ToObject()->Get(String::New("checkKeys"))->BooleanValue();
+  }
+
+  // A string is read from its UTF-8 copy, a Buffer in place
+  String::Utf8Value json_string(args[0]->IsString() ? args[0] : Handle<Value>(String::Empty()));
+  if(args[0]->IsString()) {
+    encoder.json = *json_string;
+    encoder.length = json_string.length();
+  } else {
+    encoder.json = Buffer::Data(args[0]->ToObject());
+    encoder.length = Buffer::Length(args[0]->ToObject());
+  }
+
+  encoder.index = 0;
+  encoder.depth = 0;
+  encoder.size = 0;
+  // BSON usually takes about as much space as the JSON text
+  encoder.capacity = encoder.length + 64;
+  encoder.data = (char *)malloc(encoder.capacity * sizeof(char));
+
+  try {
+    BSON::json_skip_whitespace(&encoder);
+    if(encoder.index >= encoder.length || encoder.json[encoder.index] != '{') BSON::json_error(&encoder, "Expected an object");
+    BSON::json_encode_document(&encoder, false);
+    BSON::json_skip_whitespace(&encoder);
+    if(encoder.index < encoder.length) BSON::json_error(&encoder, "Unexpected data after the object");
+  } catch(char *err_msg) {
+    free(encoder.data);
+    // Throw exception with the string
+    Handle<Value> error = VException(err_msg);
+    // free error message
+    free(err_msg);
+    return error;
+  }
+
+  Buffer *buffer = Buffer::New(encoder.data, encoder.size);
+  free(encoder.data);
+  return scope.Close(buffer->handle_);
+}
+
+// Write serialized documents straight out as JSON text without creating any objects, arguments are
+// (bufferOrArrayOfBuffers, [options]). An Array of documents is written as a JSON array, the canonical
+// option writes canonical instead of relaxed extended JSON
+Handle<Value> BSON::ToJSON(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() < 1 || args.Length() > 2 || (!args[0]->IsArray() && !Buffer::HasInstance(args[0]))) {
+    return VException("One or two arguments required - [buffer] or [array] or [buffer, object] or [array, object]");
+  }
+
+  JSONWriter writer;
+  writer.canonical = false;
+  if(args.Length() == 2 && args[1]->IsObject()) {
+    writer.canonical = args[1]->ToObject()->Get(String::New("canonical"))->BooleanValue();
+  }
+
+  writer.depth = 0;
+  writer.size = 0;
+  writer.capacity = 1024;
+  writer.data = (char *)malloc(writer.capacity * sizeof(char));
+
+  try {
+    if(args[0]->IsArray()) {
+      Local<Array> documents = Local<Array>::Cast(args[0]);
+      BSON::json_write(&writer, "[", 1);
+
+      for(uint32_t i = 0; i < documents->Length(); i++) {
+        Local<Value> document = documents->Get(i);
+        if(!Buffer::HasInstance(document)) BSON::json_corrupt();
+        if(i > 0) BSON::json_write(&writer, ",", 1);
+        BSON::json_write_document(&writer, Buffer::Data(document->ToObject()), Buffer::Length(document->ToObject()), false);
+      }
+
+      BSON::json_write(&writer, "]", 1);
+    } else {
+      BSON::json_write_document(&writer, Buffer::Data(args[0]->ToObject()), Buffer::Length(args[0]->ToObject()), false);
+    }
+  } catch(char *err_msg) {
+    free(writer.data);
+    // Throw exception with the string
+    Handle<Value> error = VException(err_msg);
+    // free error message
+    free(err_msg);
+    return error;
+  }
+
+  Buffer *buffer = Buffer::New(writer.data, writer.size);
+  free(writer.data);
+  return scope.Close(buffer->handle_);
+}
+
+// Metrics of the regular expression cache, the decode counts only cover decoding with the cacheRegExps option
+Handle<Value> BSON::RegExpCacheStats(const Arguments &args) {
+  HandleScope scope;
+
+  uint32_t size = 0;
+  for(uint32_t i = 0; i < BSON_REGEXP_CACHE_SIZE; i++) {
+    if(regexp_cache[i].source != NULL) size++;
+  }
+
+  Local<Object> stats = Object::New();
+  stats->Set(String::New("decodeHits"), Uint32::New(regexp_decode_hits));
+  stats->Set(String::New("decodeMisses"), Uint32::New(regexp_decode_misses));
+  stats->Set(String::New("encodeHits"), Uint32::New(regexp_encode_hits));
+  stats->Set(String::New("encodeMisses"), Uint32::New(regexp_encode_misses));
+  stats->Set(String::New("evictions"), Uint32::New(regexp_evictions));
+  stats->Set(String::New("size"), Uint32::New(size));
+  return scope.Close(stats);
+}
+
+// Returns the index of the value of a top level field or -1 if the document has no such field
+int32_t BSON::find_field(char *data, uint32_t length, const char *name) {
+  if(length < 5) return -1;
+  uint32_t size = BSON::deserialize_int32(data, 0);
+  if(size < 5 || size > length) return -1;
+  uint32_t index = 4;
+
+  while(index < size - 1) {
+    uint8_t type = BSON::deserialize_int8(data, index);
+    index = index + 1;
+    // Compare the field name in place
+    char *string_name = data + index;
+    size_t name_length = strnlen(string_name, size - index);
+    if(index + name_length >= size) return -1;
+    index = index + name_length + 1;
+
+    // The value has to end inside the document, also for the field looked for
+    int32_t element_size = BSON::value_size(data, index, type, size - 1);
+    if(element_size < 0) return -1;
+    if(strcmp(string_name, name) == 0) return index;
+    index = index + element_size;
+  }
+
+  return -1;
+}
+
+// Returns the number of bytes taken by an element value of the given type, or -1 for an unknown type
+// or a value not ending by size. The length prefixes are only read when they are inside size
+int32_t BSON::value_size(char *data, uint32_t index, uint8_t type, uint32_t size) {
+  if(index > size) return -1;
+  uint32_t available = size - index;
+  int64_t value_size = 0;
+
+  switch(type) {
+    case BSON_DATA_NUMBER:
+    case BSON_DATA_DATE:
+    case BSON_DATA_TIMESTAMP:
+    case BSON_DATA_LONG:
+      value_size = 8;
+      break;
+    case BSON_DATA_INT:
+      value_size = 4;
+      break;
+    case BSON_DATA_BOOLEAN:
+      value_size = 1;
+      break;
+    case BSON_DATA_OID:
+      value_size = 12;
+      break;
+    case BSON_DATA_NULL:
+    case BSON_DATA_UNDEFINED:
+    case BSON_DATA_MIN_KEY:
+    case BSON_DATA_MAX_KEY:
+      value_size = 0;
+      break;
+    case BSON_DATA_STRING:
+    case BSON_DATA_CODE:
+    case BSON_DATA_SYMBOL:
+      if(available < 4 || (int32_t)BSON::deserialize_int32(data, index) < 1) return -1;
+      value_size = 4 + (int64_t)(int32_t)BSON::deserialize_int32(data, index);
+      break;
+    case BSON_DATA_OBJECT:
+    case BSON_DATA_ARRAY:
+    case BSON_DATA_CODE_W_SCOPE:
+      if(available < 4 || (int32_t)BSON::deserialize_int32(data, index) < 5) return -1;
+      value_size = (int32_t)BSON::deserialize_int32(data, index);
+      break;
+    case BSON_DATA_BINARY:
+      if(available < 4 || (int32_t)BSON::deserialize_int32(data, index) < 0) return -1;
+      value_size = 4 + 1 + (int64_t)(int32_t)BSON::deserialize_int32(data, index);
+      break;
+    case BSON_DATA_REGEXP: {
+      // Pattern and options are two C strings
+      uint32_t pattern_length = strnlen(data + index, available) + 1;
+      if(pattern_length > available) return -1;
+      value_size = pattern_length + strnlen(data + index + pattern_length, available - pattern_length) + 1;
+      break;
+    }
+    default:
+      return -1;
+  }
+
+  if(value_size > available) return -1;
+  return (int32_t)value_size;
+}
+
+// Size of the document at the start of data, length is the number of bytes available
+uint32_t BSON::document_size(char *data, uint32_t length) {
+  if(length < 5) BSON::json_corrupt();
+  uint32_t size = BSON::deserialize_int32(data, 0);
+  if(size < 5 || size > length || data[size - 1] != '\0') BSON::json_corrupt();
+  return size;
+}
+
+// Read the element at index of a document of the given size, returns the index of the next element
+uint32_t BSON::read_element(char *data, uint32_t size, uint32_t index, BSONElement *element) {
+  element->type = BSON::deserialize_int8(data, index);
+  index = index + 1;
+  // Field names must end inside the document
+  element->name = data + index;
+  element->name_length = strnlen(element->name, size - 1 - index);
+  if(index + element->name_length >= size - 1) BSON::json_corrupt();
+  index = index + element->name_length + 1;
+
+  int32_t value_size = BSON::value_size(data, index, element->type, size);
+  if(value_size < 0 || index + value_size > size - 1) BSON::json_corrupt();
+  element->value = data + index;
+  element->size = value_size;
+
+  // Embedded documents are checked once here for everything walking them
+  if(element->type == BSON_DATA_OBJECT || element->type == BSON_DATA_ARRAY) BSON::document_size(element->value, value_size);
+  return index + value_size;
+}
+
+// Rank of a BSON type in the order MongoDB sorts values of different types, the numbers
+// share a rank as do strings and symbols, and null and undefined
+int BSON::canonical_type(uint8_t type) {
+  switch(type) {
+    case BSON_DATA_MIN_KEY:
+      return -1;
+    case BSON_DATA_NULL:
+    case BSON_DATA_UNDEFINED:
+      return 5;
+    case BSON_DATA_NUMBER:
+    case BSON_DATA_INT:
+    case BSON_DATA_LONG:
+      return 10;
+    case BSON_DATA_STRING:
+    case BSON_DATA_SYMBOL:
+      return 15;
+    case BSON_DATA_OBJECT:
+      return 20;
+    case BSON_DATA_ARRAY:
+      return 25;
+    case BSON_DATA_BINARY:
+      return 30;
+    case BSON_DATA_OID:
+      return 35;
+    case BSON_DATA_BOOLEAN:
+      return 40;
+    case BSON_DATA_DATE:
+      return 45;
+    case BSON_DATA_TIMESTAMP:
+      return 47;
+    case BSON_DATA_REGEXP:
+      return 50;
+    case BSON_DATA_CODE:
+      return 60;
+    case BSON_DATA_CODE_W_SCOPE:
+      return 65;
+    case BSON_DATA_MAX_KEY:
+      return 127;
+    default:
+      return 0;
+  }
+}
+
+static int compare_int64(int64_t a, int64_t b) {
+  return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// NaN sorts before every other number and equal to itself
+static int compare_double(double a, double b) {
+  if(std::isnan(a) || std::isnan(b)) return std::isnan(a) ? (std::isnan(b) ? 0 : -1) : 1;
+  return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Compare an integer with a double without rounding the integer
+static int compare_int64_double(int64_t a, double b) {
+  if(std::isnan(b)) return 1;
+  if(b >= 9223372036854775808.0) return -1;
+  if(b < -9223372036854775808.0) return 1;
+  double floor_b = floor(b);
+  int result = compare_int64(a, (int64_t)floor_b);
+  if(result != 0) return result;
+  return b > floor_b ? -1 : 0;
+}
+
+// Compare two length prefixed strings of the given value sizes byte by byte
+int BSON::compare_strings(char *a, uint32_t size_a, char *b, uint32_t size_b) {
+  uint32_t length_a = BSON::json_string_length(a, size_a);
+  uint32_t length_b = BSON::json_string_length(b, size_b);
+  int result = memcmp(a + 4, b + 4, length_a < length_b ? length_a : length_b);
+  if(result != 0) return result < 0 ? -1 : 1;
+  return length_a < length_b ? -1 : (length_a > length_b ? 1 : 0);
+}
+
+// Compare two element values the way MongoDB sorts them, values of different types by the
+// rank of their type. The sizes are the number of bytes the values take
+int BSON::compare_values(uint8_t type_a, char *a, uint32_t size_a, uint8_t type_b, char *b, uint32_t size_b) {
+  int rank_a = BSON::canonical_type(type_a);
+  int rank_b = BSON::canonical_type(type_b);
+  if(rank_a != rank_b) return rank_a < rank_b ? -1 : 1;
+
+  switch(type_a) {
+    case BSON_DATA_NUMBER:
+    case BSON_DATA_INT:
+    case BSON_DATA_LONG: {
+      // Integers compare exactly, doubles only with each other
+      int64_t integer_a = 0, integer_b = 0;
+      double double_a = 0, double_b = 0;
+      if(type_a == BSON_DATA_INT) integer_a = (int32_t)BSON::deserialize_int32(a, 0);
+      else if(type_a == BSON_DATA_LONG) memcpy(&integer_a, a, 8);
+      else memcpy(&double_a, a, 8);
+      if(type_b == BSON_DATA_INT) integer_b = (int32_t)BSON::deserialize_int32(b, 0);
+      else if(type_b == BSON_DATA_LONG) memcpy(&integer_b, b, 8);
+      else memcpy(&double_b, b, 8);
+
+      if(type_a != BSON_DATA_NUMBER && type_b != BSON_DATA_NUMBER) return compare_int64(integer_a, integer_b);
+      if(type_a != BSON_DATA_NUMBER) return compare_int64_double(integer_a, double_b);
+      if(type_b != BSON_DATA_NUMBER) return -compare_int64_double(integer_b, double_a);
+      return compare_double(double_a, double_b);
+    }
+    case BSON_DATA_STRING:
+    case BSON_DATA_SYMBOL:
+    case BSON_DATA_CODE:
+      return BSON::compare_strings(a, size_a, b, size_b);
+    case BSON_DATA_OBJECT:
+    case BSON_DATA_ARRAY:
+      return BSON::compare_documents(a, size_a, b, size_b);
+    case BSON_DATA_BINARY: {
+      // By length, then subtype, then the bytes
+      uint32_t length_a = BSON::deserialize_int32(a, 0);
+      uint32_t length_b = BSON::deserialize_int32(b, 0);
+      if(length_a != length_b) return length_a < length_b ? -1 : 1;
+      if((uint8_t)a[4] != (uint8_t)b[4]) return (uint8_t)a[4] < (uint8_t)b[4] ? -1 : 1;
+      int result = memcmp(a + 5, b + 5, length_a);
+      return result < 0 ? -1 : (result > 0 ? 1 : 0);
+    }
+    case BSON_DATA_OID: {
+      int result = memcmp(a, b, 12);
+      return result < 0 ? -1 : (result > 0 ? 1 : 0);
+    }
+    case BSON_DATA_BOOLEAN:
+      return (a[0] != 0) == (b[0] != 0) ? 0 : (a[0] != 0 ? 1 : -1);
+    case BSON_DATA_DATE: {
+      int64_t date_a, date_b;
+      memcpy(&date_a, a, 8);
+      memcpy(&date_b, b, 8);
+      return compare_int64(date_a, date_b);
+    }
+    case BSON_DATA_TIMESTAMP: {
+      // Unsigned, the seconds are the high half
+      uint64_t timestamp_a, timestamp_b;
+      memcpy(&timestamp_a, a, 8);
+      memcpy(&timestamp_b, b, 8);
+      return timestamp_a < timestamp_b ? -1 : (timestamp_a > timestamp_b ? 1 : 0);
+    }
+    case BSON_DATA_REGEXP: {
+      // By pattern, then options
+      int result = strcmp(a, b);
+      if(result == 0) result = strcmp(a + strlen(a) + 1, b + strlen(b) + 1);
+      return result < 0 ? -1 : (result > 0 ? 1 : 0);
+    }
+    case BSON_DATA_CODE_W_SCOPE: {
+      // By code, then scope. The total size is followed by the code string and the scope document
+      if(size_a < 14 || size_b < 14) BSON::json_corrupt();
+      uint32_t code_size_a = 4 + BSON::json_string_length(a + 4, size_a - 4) + 1;
+      uint32_t code_size_b = 4 + BSON::json_string_length(b + 4, size_b - 4) + 1;
+      int result = BSON::compare_strings(a + 4, code_size_a, b + 4, code_size_b);
+      if(result != 0) return result;
+      return BSON::compare_documents(a + 4 + code_size_a, BSON::document_size(a + 4 + code_size_a, size_a - 4 - code_size_a),
+        b + 4 + code_size_b, BSON::document_size(b + 4 + code_size_b, size_b - 4 - code_size_b));
+    }
+    default:
+      // Null, MinKey and MaxKey have no value
+      return 0;
+  }
+}
+
+// Compare two documents the way MongoDB sorts them, element by element by the rank of
+// the type, the name and then the value. A document sorts before the ones it is a prefix of
+int BSON::compare_documents(char *a, uint32_t size_a, char *b, uint32_t size_b) {
+  size_a = BSON::document_size(a, size_a);
+  size_b = BSON::document_size(b, size_b);
+  uint32_t index_a = 4;
+  uint32_t index_b = 4;
+
+  while(index_a < size_a - 1 && index_b < size_b - 1) {
+    BSONElement element_a, element_b;
+    index_a = BSON::read_element(a, size_a, index_a, &element_a);
+    index_b = BSON::read_element(b, size_b, index_b, &element_b);
+
+    int rank_a = BSON::canonical_type(element_a.type);
+    int rank_b = BSON::canonical_type(element_b.type);
+    if(rank_a != rank_b) return rank_a < rank_b ? -1 : 1;
+
+    int result = strcmp(element_a.name, element_b.name);
+    if(result != 0) return result < 0 ? -1 : 1;
+
+    result = BSON::compare_values(element_a.type, element_a.value, element_a.size, element_b.type, element_b.value, element_b.size);
+    if(result != 0) return result;
+  }
+
+  if(index_a < size_a - 1) return 1;
+  if(index_b < size_b - 1) return -1;
+  return 0;
+}
+
+// Nesting limit of BSON::FromJSON, the server accepts no deeper documents
+const uint32_t JSON_MAX_DEPTH = 100;
+
+// Throw a JSON error naming the position it was found at
+void BSON::json_error(JSONEncoder *encoder, const char *message) {
+  char *error_str = (char *)malloc(256 * sizeof(char));
+  snprintf(error_str, 256, "%s at position %u", message, encoder->index);
+  throw error_str;
+}
+
+// Make room for the given number of bytes after the output written so far
+void BSON::json_reserve(JSONEncoder *encoder, uint32_t bytes) {
+  if(encoder->size + bytes <= encoder->capacity) return;
+
+  uint32_t capacity = encoder->capacity * 2;
+  if(capacity < encoder->size + bytes) capacity = encoder->size + bytes;
+  char *data = (char *)realloc(encoder->data, capacity);
+  if(data == NULL) BSON::json_error(encoder, "Out of memory");
+  encoder->data = data;
+  encoder->capacity = capacity;
+}
+
+void BSON::json_skip_whitespace(JSONEncoder *encoder) {
+  while(encoder->index < encoder->length) {
+    char c = encoder->json[encoder->index];
+    if(c != ' ' && c != '\t' && c != '\n' && c != '\r') return;
+    encoder->index++;
+  }
+}
+
+void BSON::json_expect_literal(JSONEncoder *encoder, const char *literal) {
+  size_t length = strlen(literal);
+  if(encoder->index + length > encoder->length || memcmp(encoder->json + encoder->index, literal, length) != 0) {
+    BSON::json_error(encoder, "Unexpected token");
+  }
+  encoder->index = encoder->index + length;
+}
+
+// Encode the object or array starting at the current position as a document
+void BSON::json_encode_document(JSONEncoder *encoder, bool is_array) {
+  if(++encoder->depth > JSON_MAX_DEPTH) BSON::json_error(encoder, "Documents nested too deeply");
+
+  // Leave room for the size, written once the document is complete
+  uint32_t start = encoder->size;
+  BSON::json_reserve(encoder, 4);
+  encoder->size = encoder->size + 4;
+  encoder->index++;
+
+  char close = is_array ? ']' : '}';
+  uint32_t array_index = 0;
+  BSON::json_skip_whitespace(encoder);
+
+  if(encoder->index < encoder->length && encoder->json[encoder->index] == close) {
+    encoder->index++;
+  } else {
+    while(true) {
+      BSON::json_skip_whitespace(encoder);
+      // The type byte is filled in once the value is known
+      uint32_t type_index = encoder->size;
+      BSON::json_reserve(encoder, 1);
+      encoder->size++;
+
+      if(is_array) {
+        char index_str[16];
+        int len = sprintf(index_str, "%u", array_index++);
+        BSON::json_reserve(encoder, len + 1);
+        memcpy(encoder->data + encoder->size, index_str, len + 1);
+        encoder->size = encoder->size + len + 1;
+      } else {
+        if(encoder->index >= encoder->length || encoder->json[encoder->index] != '"') BSON::json_error(encoder, "Expected a field name");
+        uint32_t name_index = encoder->size;
+        BSON::json_encode_string(encoder, true);
+
+        // Same rules as check_key on the decoded name
+        char *name = encoder->data + name_index;
+        if(encoder->check_keys && *name == '$') {
+          char *error_str = (char *)malloc(256 * sizeof(char));
+          snprintf(error_str, 256, "key %s must not start with '$'", name);
+          throw error_str;
+        } else if(encoder->check_keys && strchr(name, '.') != NULL) {
+          char *error_str = (char *)malloc(256 * sizeof(char));
+          snprintf(error_str, 256, "key %s must not contain '.'", name);
+          throw error_str;
+        }
+
+        BSON::json_skip_whitespace(encoder);
+        BSON::json_expect_literal(encoder, ":");
+      }
+
+      BSON::json_skip_whitespace(encoder);
+      uint8_t type = BSON::json_encode_value(encoder);
+      *(encoder->data + type_index) = type;
+      BSON::json_skip_whitespace(encoder);
+
+      if(encoder->index < encoder->length && encoder->json[encoder->index] == ',') {
+        encoder->index++;
+      } else if(encoder->index < encoder->length && encoder->json[encoder->index] == close) {
+        encoder->index++;
+        break;
+      } else {
+        BSON::json_error(encoder, is_array ? "Expected ',' or ']'" : "Expected ',' or '}'");
+      }
+    }
+  }
+
+  // Terminate the document and write its size
+  BSON::json_reserve(encoder, 1);
+  *(encoder->data + encoder->size) = '\0';
+  encoder->size++;
+  BSON::write_int32(encoder->data + start, encoder->size - start);
+  encoder->depth--;
+}
+
+// Encode the value at the current position and return its BSON type
+uint8_t BSON::json_encode_value(JSONEncoder *encoder) {
+  char c = encoder->index < encoder->length ? encoder->json[encoder->index] : '\0';
+
+  switch(c) {
+    case '"':
+      BSON::json_encode_string(encoder, false);
+      return BSON_DATA_STRING;
+    case '{':
+      return BSON::json_encode_object(encoder);
+    case '[':
+      BSON::json_encode_document(encoder, true);
+      return BSON_DATA_ARRAY;
+    case 't':
+    case 'f':
+      BSON::json_expect_literal(encoder, c == 't' ? "true" : "false");
+      BSON::json_reserve(encoder, 1);
+      *(encoder->data + encoder->size) = c == 't' ? 1 : 0;
+      encoder->size++;
+      return BSON_DATA_BOOLEAN;
+    case 'n':
+      BSON::json_expect_literal(encoder, "null");
+      return BSON_DATA_NULL;
+    default:
+      return BSON::json_encode_number(encoder);
+  }
+}
+
+// Encode an object, one holding nothing but a valid extended JSON field becomes the value it describes
+uint8_t BSON::json_encode_object(JSONEncoder *encoder) {
+  uint32_t index = encoder->index;
+  uint32_t size = encoder->size;
+  uint8_t type = 0;
+
+  encoder->index++;
+  BSON::json_skip_whitespace(encoder);
+  if(BSON::json_match_key(encoder, "$oid")) {
+    type = BSON_DATA_OID;
+  } else if(BSON::json_match_key(encoder, "$date")) {
+    type = BSON_DATA_DATE;
+  } else if(BSON::json_match_key(encoder, "$numberLong")) {
+    type = BSON_DATA_LONG;
+  } else if(BSON::json_match_key(encoder, "$numberInt")) {
+    type = BSON_DATA_INT;
+  } else if(BSON::json_match_key(encoder, "$numberDouble")) {
+    type = BSON_DATA_NUMBER;
+  }
+
+  if(type != 0) {
+    bool valid = false;
+    if(type == BSON_DATA_OID) {
+      valid = BSON::json_encode_oid(encoder);
+    } else if(type == BSON_DATA_DATE) {
+      valid = BSON::json_encode_date(encoder);
+    } else if(type == BSON_DATA_INT) {
+      valid = BSON::json_encode_number_int(encoder);
+    } else if(type == BSON_DATA_NUMBER) {
+      valid = BSON::json_encode_number_double(encoder);
+    } else {
+      valid = BSON::json_encode_number_long(encoder);
+    }
+
+    BSON::json_skip_whitespace(encoder);
+    if(valid && encoder->index < encoder->length && encoder->json[encoder->index] == '}') {
+      encoder->index++;
+      return type;
+    }
+  }
+
+  // A plain object after all, start over
+  encoder->index = index;
+  encoder->size = size;
+  BSON::json_encode_document(encoder, false);
+  return BSON_DATA_OBJECT;
+}
+
+// Skip a field name and the following colon if the name is the given key
+bool BSON::json_match_key(JSONEncoder *encoder, const char *key) {
+  size_t length = strlen(key);
+  uint32_t index = encoder->index;
+
+  if(index + length + 2 > encoder->length || encoder->json[index] != '"'
+    || memcmp(encoder->json + index + 1, key, length) != 0 || encoder->json[index + length + 1] != '"') {
+    return false;
+  }
+
+  encoder->index = index + length + 2;
+  BSON::json_skip_whitespace(encoder);
+  if(encoder->index >= encoder->length || encoder->json[encoder->index] != ':') {
+    encoder->index = index;
+    return false;
+  }
+
+  encoder->index++;
+  BSON::json_skip_whitespace(encoder);
+  return true;
+}
+
+// Encode a number like serialize writes the Number, int32 values as int32 and anything else as a double
+uint8_t BSON::json_encode_number(JSONEncoder *encoder) {
+  double value = 0;
+  if(!BSON::json_scan_number(encoder, &value)) BSON::json_error(encoder, "Unexpected token");
+
+  // Negative zero doesn't survive as an int32
+  if(value >= BSON_INT32_MIN && value <= BSON_INT32_MAX && value == floor(value) && !(value == 0 && 1 / value < 0)) {
+    BSON::json_reserve(encoder, 4);
+    BSON::write_int32(encoder->data + encoder->size, (int32_t)value);
+    encoder->size = encoder->size + 4;
+    return BSON_DATA_INT;
+  }
+
+  BSON::json_reserve(encoder, 8);
+  BSON::write_double(encoder->data + encoder->size, value);
+  encoder->size = encoder->size + 8;
+  return BSON_DATA_NUMBER;
+}
+
+// Read a JSON number, returns false if there is no valid number at the current position
+bool BSON::json_scan_number(JSONEncoder *encoder, double *value) {
+  const char *json = encoder->json;
+  uint32_t length = encoder->length;
+  uint32_t index = encoder->index;
+  uint32_t digits = 0;
+
+  if(index < length && json[index] == '-') index++;
+  if(index < length && json[index] == '0') {
+    index++;
+    digits++;
+  } else {
+    while(index < length && json[index] >= '0' && json[index] <= '9') {
+      index++;
+      digits++;
+    }
+  }
+  if(digits == 0) return false;
+
+  if(index < length && json[index] == '.') {
+    index++;
+    if(index >= length || json[index] < '0' || json[index] > '9') return false;
+    while(index < length && json[index] >= '0' && json[index] <= '9') index++;
+  }
+
+  if(index < length && (json[index] == 'e' || json[index] == 'E')) {
+    index++;
+    if(index < length && (json[index] == '+' || json[index] == '-')) index++;
+    if(index >= length || json[index] < '0' || json[index] > '9') return false;
+    while(index < length && json[index] >= '0' && json[index] <= '9') index++;
+  }
+
+  // Copy the token to terminate it for strtod
+  uint32_t token_length = index - encoder->index;
+  char token_buffer[64];
+  char *token = token_length < sizeof(token_buffer) ? token_buffer : (char *)malloc(token_length + 1);
+  memcpy(token, json + encoder->index, token_length);
+  token[token_length] = '\0';
+
+  *value = strtod(token, NULL);
+  if(token != token_buffer) free(token);
+  encoder->index = index;
+  return true;
+}
+
+// Decode a JSON string into UTF-8, written as a C string for field names or with its size for values
+void BSON::json_encode_string(JSONEncoder *encoder, bool cstring) {
+  uint32_t start = encoder->size;
+  if(!cstring) {
+    BSON::json_reserve(encoder, 4);
+    encoder->size = encoder->size + 4;
+  }
+
+  uint32_t string_start = encoder->size;
+  const char *json = encoder->json;
+  encoder->index++;
+
+  while(true) {
+    if(encoder->index >= encoder->length) BSON::json_error(encoder, "Unterminated string");
+    unsigned char c = json[encoder->index];
+
+    if(c == '"') {
+      encoder->index++;
+      break;
+    } else if(c < 0x20) {
+      BSON::json_error(encoder, "Control character in string");
+    } else if(c != '\\') {
+      // Copy the run of plain characters in one go
+      uint32_t run_start = encoder->index;
+      while(encoder->index < encoder->length && json[encoder->index] != '"' && json[encoder->index] != '\\'
+        && (unsigned char)json[encoder->index] >= 0x20) {
+        encoder->index++;
+      }
+
+      BSON::json_reserve(encoder, encoder->index - run_start);
+      memcpy(encoder->data + encoder->size, json + run_start, encoder->index - run_start);
+      encoder->size = encoder->size + encoder->index - run_start;
+      continue;
+    }
+
+    // Escape sequence
+    if(encoder->index + 1 >= encoder->length) BSON::json_error(encoder, "Unterminated string");
+    char escape = json[encoder->index + 1];
+    encoder->index = encoder->index + 2;
+    uint32_t code_point = 0;
+
+    switch(escape) {
+      case '"': code_point = '"'; break;
+      case '\\': code_point = '\\'; break;
+      case '/': code_point = '/'; break;
+      case 'b': code_point = '\b'; break;
+      case 'f': code_point = '\f'; break;
+      case 'n': code_point = '\n'; break;
+      case 'r': code_point = '\r'; break;
+      case 't': code_point = '\t'; break;
+      case 'u': {
+        // One or two UTF-16 code units
+        for(int unit = 0; unit < 2; unit++) {
+          if(encoder->index + 4 > encoder->length) BSON::json_error(encoder, "Invalid unicode escape");
+          uint32_t code_unit = 0;
+          for(int i = 0; i < 4; i++) {
+            char h = json[encoder->index + i];
+            code_unit = code_unit << 4;
+            if(h >= '0' && h <= '9') code_unit |= h - '0';
+            else if(h >= 'a' && h <= 'f') code_unit |= h - 'a' + 10;
+            else if(h >= 'A' && h <= 'F') code_unit |= h - 'A' + 10;
+            else BSON::json_error(encoder, "Invalid unicode escape");
+          }
+
+          if(unit == 0) {
+            encoder->index = encoder->index + 4;
+            code_point = code_unit;
+            // A high surrogate pairs up with a following \u low surrogate
+            if(code_unit < 0xD800 || code_unit > 0xDBFF || encoder->index + 2 > encoder->length
+              || json[encoder->index] != '\\' || json[encoder->index + 1] != 'u') break;
+            encoder->index = encoder->index + 2;
+          } else if(code_unit >= 0xDC00 && code_unit <= 0xDFFF) {
+            encoder->index = encoder->index + 4;
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (code_unit - 0xDC00);
+          } else {
+            // Leave the second escape for the next round
+            encoder->index = encoder->index - 2;
+          }
+        }
+
+        // Unpaired surrogates become the replacement character
+        if(code_point >= 0xD800 && code_point <= 0xDFFF) code_point = 0xFFFD;
+        break;
+      }
+      default:
+        BSON::json_error(encoder, "Invalid escape");
+    }
+
+    BSON::json_write_utf8(encoder, code_point);
+  }
+
+  if(cstring) {
+    if(memchr(encoder->data + string_start, '\0', encoder->size - string_start) != NULL) {
+      BSON::json_error(encoder, "Field names must not contain null characters");
+    }
+  }
+
+  // Terminate the string and write the size of a value
+  BSON::json_reserve(encoder, 1);
+  *(encoder->data + encoder->size) = '\0';
+  encoder->size++;
+  if(!cstring) BSON::write_int32(encoder->data + start, encoder->size - string_start);
+}
+
+void BSON::json_write_utf8(JSONEncoder *encoder, uint32_t code_point) {
+  BSON::json_reserve(encoder, 4);
+  char *data = encoder->data + encoder->size;
+
+  if(code_point < 0x80) {
+    data[0] = code_point;
+    encoder->size = encoder->size + 1;
+  } else if(code_point < 0x800) {
+    data[0] = 0xC0 | (code_point >> 6);
+    data[1] = 0x80 | (code_point & 0x3F);
+    encoder->size = encoder->size + 2;
+  } else if(code_point < 0x10000) {
+    data[0] = 0xE0 | (code_point >> 12);
+    data[1] = 0x80 | ((code_point >> 6) & 0x3F);
+    data[2] = 0x80 | (code_point & 0x3F);
+    encoder->size = encoder->size + 3;
+  } else {
+    data[0] = 0xF0 | (code_point >> 18);
+    data[1] = 0x80 | ((code_point >> 12) & 0x3F);
+    data[2] = 0x80 | ((code_point >> 6) & 0x3F);
+    data[3] = 0x80 | (code_point & 0x3F);
+    encoder->size = encoder->size + 4;
+  }
+}
+
+// Write the 12 bytes of a 24 digit hex string
+bool BSON::json_encode_oid(JSONEncoder *encoder) {
+  const char *json = encoder->json + encoder->index;
+  if(encoder->index + 26 > encoder->length || json[0] != '"' || json[25] != '"') return false;
+
+  char oid[12];
+  for(int i = 0; i < 24; i++) {
+    char h = json[i + 1];
+    uint8_t nibble = 0;
+    if(h >= '0' && h <= '9') nibble = h - '0';
+    else if(h >= 'a' && h <= 'f') nibble = h - 'a' + 10;
+    else if(h >= 'A' && h <= 'F') nibble = h - 'A' + 10;
+    else return false;
+    oid[i / 2] = (i % 2 == 0) ? (nibble << 4) : (oid[i / 2] | nibble);
+  }
+
+  BSON::json_reserve(encoder, 12);
+  memcpy(encoder->data + encoder->size, oid, 12);
+  encoder->size = encoder->size + 12;
+  encoder->index = encoder->index + 26;
+  return true;
+}
+
+// Read the quoted decimal string of a $numberLong
+static bool json_scan_int64_string(const char *json, uint32_t length, uint32_t *index, int64_t *value) {
+  uint32_t i = *index;
+  if(i >= length || json[i] != '"') return false;
+  i++;
+
+  bool negative = i < length && json[i] == '-';
+  if(negative) i++;
+  uint64_t magnitude = 0;
+  uint32_t digits = 0;
+
+  while(i < length && json[i] >= '0' && json[i] <= '9') {
+    uint64_t next = magnitude * 10 + (json[i] - '0');
+    if(next / 10 != magnitude || next > (uint64_t)9223372036854775807ULL + (negative ? 1 : 0)) return false;
+    magnitude = next;
+    digits++;
+    i++;
+  }
+
+  if(digits == 0 || i >= length || json[i] != '"') return false;
+  *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+  *index = i + 1;
+  return true;
+}
+
+bool BSON::json_encode_number_long(JSONEncoder *encoder) {
+  int64_t value = 0;
+  if(!json_scan_int64_string(encoder->json, encoder->length, &encoder->index, &value)) return false;
+
+  BSON::json_reserve(encoder, 8);
+  BSON::write_int64(encoder->data + encoder->size, value);
+  encoder->size = encoder->size + 8;
+  return true;
+}
+
+bool BSON::json_encode_number_int(JSONEncoder *encoder) {
+  int64_t value = 0;
+  uint32_t index = encoder->index;
+  if(!json_scan_int64_string(encoder->json, encoder->length, &index, &value)
+    || value < BSON_INT32_MIN || value > BSON_INT32_MAX) {
+    return false;
+  }
+
+  encoder->index = index;
+  BSON::json_reserve(encoder, 4);
+  BSON::write_int32(encoder->data + encoder->size, (int32_t)value);
+  encoder->size = encoder->size + 4;
+  return true;
+}
+
+// Encode the quoted number of a $numberDouble, which also spells out NaN and the infinities
+bool BSON::json_encode_number_double(JSONEncoder *encoder) {
+  const char *json = encoder->json;
+  uint32_t index = encoder->index;
+  double value = 0;
+  if(index >= encoder->length || json[index] != '"') return false;
+  index++;
+
+  const char *names[] = {"NaN", "Infinity", "-Infinity"};
+  const double values[] = {std::numeric_limits<double>::quiet_NaN(),
+    std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+  bool named = false;
+  for(int i = 0; i < 3 && !named; i++) {
+    size_t length = strlen(names[i]);
+    if(index + length < encoder->length && memcmp(json + index, names[i], length) == 0 && json[index + length] == '"') {
+      value = values[i];
+      index = index + length;
+      named = true;
+    }
+  }
+
+  if(!named) {
+    encoder->index = index;
+    if(!BSON::json_scan_number(encoder, &value)) return false;
+    index = encoder->index;
+  }
+
+  if(index >= encoder->length || json[index] != '"') return false;
+  encoder->index = index + 1;
+  BSON::json_reserve(encoder, 8);
+  BSON::write_double(encoder->data + encoder->size, value);
+  encoder->size = encoder->size + 8;
+  return true;
+}
+
+// Days between 1970-01-01 and the given date of the proleptic Gregorian calendar
+static int64_t days_from_civil(int64_t year, uint32_t month, uint32_t day) {
+  year = year - (month <= 2 ? 1 : 0);
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  uint32_t year_of_era = (uint32_t)(year - era * 400);
+  uint32_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + (int64_t)day_of_era - 719468;
+}
+
+// Number of days in a month of the proleptic Gregorian calendar
+static uint32_t days_in_month(uint32_t year, uint32_t month) {
+  static const uint32_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+  return month == 2 && leap ? 29 : days[month - 1];
+}
+
+// Read a run of exactly count digits
+static bool json_scan_digits(const char *json, uint32_t length, uint32_t index, uint32_t count, uint32_t *value) {
+  if(index + count > length) return false;
+  *value = 0;
+  for(uint32_t i = 0; i < count; i++) {
+    if(json[index + i] < '0' || json[index + i] > '9') return false;
+    *value = *value * 10 + (json[index + i] - '0');
+  }
+  return true;
+}
+
+// Read a quoted YYYY-MM-DDTHH:MM:SS[.sss](Z|+HH:MM|-HH:MM) date as milliseconds since the epoch
+static bool json_scan_iso_date(const char *json, uint32_t length, uint32_t *index, int64_t *value) {
+  uint32_t i = *index;
+  uint32_t year, month, day, hours, minutes, seconds;
+  if(i >= length || json[i] != '"') return false;
+  i++;
+
+  if(!json_scan_digits(json, length, i, 4, &year) || i + 19 > length || json[i + 4] != '-'
+    || !json_scan_digits(json, length, i + 5, 2, &month) || json[i + 7] != '-'
+    || !json_scan_digits(json, length, i + 8, 2, &day) || json[i + 10] != 'T'
+    || !json_scan_digits(json, length, i + 11, 2, &hours) || json[i + 13] != ':'
+    || !json_scan_digits(json, length, i + 14, 2, &minutes) || json[i + 16] != ':'
+    || !json_scan_digits(json, length, i + 17, 2, &seconds)) {
+    return false;
+  }
+
+  if(month < 1 || month > 12 || day < 1 || day > days_in_month(year, month)
+    || hours > 23 || minutes > 59 || seconds > 59) {
+    return false;
+  }
+  i = i + 19;
+
+  // Milliseconds are the first three fraction digits
+  int64_t milliseconds = 0;
+  if(i < length && json[i] == '.') {
+    i++;
+    uint32_t digits = 0;
+    while(i < length && json[i] >= '0' && json[i] <= '9') {
+      if(digits < 3) milliseconds = milliseconds * 10 + (json[i] - '0');
+      digits++;
+      i++;
+    }
+    if(digits == 0) return false;
+    for(; digits < 3; digits++) milliseconds = milliseconds * 10;
+  }
+
+  int64_t offset_minutes = 0;
+  if(i < length && json[i] == 'Z') {
+    i++;
+  } else if(i < length && (json[i] == '+' || json[i] == '-')) {
+    uint32_t offset_hours, offset_mins;
+    if(!json_scan_digits(json, length, i + 1, 2, &offset_hours) || i + 6 > length || json[i + 3] != ':'
+      || !json_scan_digits(json, length, i + 4, 2, &offset_mins)) {
+      return false;
+    }
+    offset_minutes = (json[i] == '-' ? -1 : 1) * (int64_t)(offset_hours * 60 + offset_mins);
+    i = i + 6;
+  } else {
+    return false;
+  }
+
+  if(i >= length || json[i] != '"') return false;
+  *index = i + 1;
+
+  int64_t days = days_from_civil(year, month, day);
+  *value = (((days * 24 + hours) * 60 + minutes - offset_minutes) * 60 + seconds) * 1000 + milliseconds;
+  return true;
+}
+
+// A date is given as milliseconds since the epoch, a {$numberLong} of them or an ISO-8601 string
+bool BSON::json_encode_date(JSONEncoder *encoder) {
+  int64_t value = 0;
+  char c = encoder->index < encoder->length ? encoder->json[encoder->index] : '\0';
+
+  if(c == '"') {
+    if(!json_scan_iso_date(encoder->json, encoder->length, &encoder->index, &value)) return false;
+  } else if(c == '{') {
+    uint32_t index = encoder->index;
+    encoder->index++;
+    BSON::json_skip_whitespace(encoder);
+    if(!BSON::json_match_key(encoder, "$numberLong") || !json_scan_int64_string(encoder->json, encoder->length, &encoder->index, &value)) {
+      encoder->index = index;
+      return false;
+    }
+    BSON::json_skip_whitespace(encoder);
+    if(encoder->index >= encoder->length || encoder->json[encoder->index] != '}') {
+      encoder->index = index;
+      return false;
+    }
+    encoder->index++;
+  } else {
+    double number = 0;
+    if(!BSON::json_scan_number(encoder, &number)) return false;
+    // Dates keep whole milliseconds
+    if(fabs(number) >= BSON_JS_INT_MAX) return false;
+    value = (int64_t)number;
+  }
+
+  BSON::json_reserve(encoder, 8);
+  BSON::write_int64(encoder->data + encoder->size, value);
+  encoder->size = encoder->size + 8;
+  return true;
+}
+
+// Throw the error for a document that doesn't hold valid BSON
+void BSON::json_corrupt() {
+  char *error_str = (char *)malloc(32 * sizeof(char));
+  strcpy(error_str, "Corrupt BSON document");
+  throw error_str;
+}
+
+// Append bytes to the JSON text, growing the output as needed
+void BSON::json_write(JSONWriter *writer, const char *bytes, uint32_t length) {
+  if(writer->size + length > writer->capacity) {
+    uint32_t capacity = writer->capacity * 2;
+    if(capacity < writer->size + length) capacity = writer->size + length;
+    char *data = (char *)realloc(writer->data, capacity);
+    if(data == NULL) BSON::json_corrupt();
+    writer->data = data;
+    writer->capacity = capacity;
+  }
+
+  memcpy(writer->data + writer->size, bytes, length);
+  writer->size = writer->size + length;
+}
+
+// Write the document at the start of data, length is the number of bytes available
+void BSON::json_write_document(JSONWriter *writer, char *data, uint32_t length, bool is_array) {
+  if(length < 5) BSON::json_corrupt();
+  uint32_t size = BSON::deserialize_int32(data, 0);
+  if(size < 5 || size > length || data[size - 1] != '\0' || writer->depth >= JSON_MAX_DEPTH) BSON::json_corrupt();
+
+  writer->depth++;
+  BSON::json_write(writer, is_array ? "[" : "{", 1);
+  uint32_t index = 4;
+  bool first = true;
+
+  while(index < size - 1) {
+    uint8_t type = BSON::deserialize_int8(data, index);
+    index = index + 1;
+    // Field names must end inside the document
+    char *name = data + index;
+    size_t name_length = strnlen(name, size - 1 - index);
+    if(index + name_length >= size - 1) BSON::json_corrupt();
+
+    if(!first) BSON::json_write(writer, ",", 1);
+    first = false;
+    if(!is_array) {
+      BSON::json_write_string(writer, name, name_length);
+      BSON::json_write(writer, ":", 1);
+    }
+    index = index + name_length + 1;
+
+    int32_t value_size = BSON::value_size(data, index, type, size);
+    if(value_size < 0 || index + value_size > size - 1) BSON::json_corrupt();
+    BSON::json_write_value(writer, data + index, value_size, type);
+    index = index + value_size;
+  }
+
+  BSON::json_write(writer, is_array ? "]" : "}", 1);
+  writer->depth--;
+}
+
+// Length of the length prefixed string at the start of data, size is the number of bytes available
+uint32_t BSON::json_string_length(char *data, uint32_t size) {
+  if(size < 5) BSON::json_corrupt();
+  uint32_t length = BSON::deserialize_int32(data, 0);
+  if(length < 1 || length > size - 4 || data[4 + length - 1] != '\0') BSON::json_corrupt();
+  return length - 1;
+}
+
+// Write the element value of the given type, size is the number of bytes it takes
+void BSON::json_write_value(JSONWriter *writer, char *data, uint32_t size, uint8_t type) {
+  char number[64];
+
+  switch(type) {
+    case BSON_DATA_NUMBER: {
+      double value;
+      memcpy(&value, data, 8);
+      BSON::json_write_double(writer, value);
+      break;
+    }
+    case BSON_DATA_STRING:
+      BSON::json_write_string(writer, data + 4, BSON::json_string_length(data, size));
+      break;
+    case BSON_DATA_OBJECT:
+    case BSON_DATA_ARRAY:
+      BSON::json_write_document(writer, data, size, type == BSON_DATA_ARRAY);
+      break;
+    case BSON_DATA_BINARY: {
+      uint8_t sub_type = (uint8_t)data[4];
+      BSON::json_write(writer, "{\"$binary\":{\"base64\":\"", 22);
+      BSON::json_write_base64(writer, data + 5, size - 5);
+      int length = sprintf(number, "\",\"subType\":\"%02x\"}}", sub_type);
+      BSON::json_write(writer, number, length);
+      break;
+    }
+    case BSON_DATA_OID: {
+      static const char hex[] = "0123456789abcdef";
+      char oid[33] = "{\"$oid\":\"";
+      for(int i = 0; i < 12; i++) {
+        oid[9 + i * 2] = hex[((uint8_t)data[i]) >> 4];
+        oid[9 + i * 2 + 1] = hex[((uint8_t)data[i]) & 0x0F];
+      }
+      BSON::json_write(writer, oid, 33);
+      BSON::json_write(writer, "\"}", 2);
+      break;
+    }
+    case BSON_DATA_BOOLEAN:
+      if(data[0] == 1) {
+        BSON::json_write(writer, "true", 4);
+      } else {
+        BSON::json_write(writer, "false", 5);
+      }
+      break;
+    case BSON_DATA_DATE: {
+      int64_t value;
+      memcpy(&value, data, 8);
+      BSON::json_write_date(writer, value);
+      break;
+    }
+    case BSON_DATA_NULL:
+      BSON::json_write(writer, "null", 4);
+      break;
+    case BSON_DATA_REGEXP: {
+      uint32_t pattern_length = strlen(data);
+      BSON::json_write(writer, "{\"$regularExpression\":{\"pattern\":", 33);
+      BSON::json_write_string(writer, data, pattern_length);
+      BSON::json_write(writer, ",\"options\":", 11);
+      BSON::json_write_string(writer, data + pattern_length + 1, strlen(data + pattern_length + 1));
+      BSON::json_write(writer, "}}", 2);
+      break;
+    }
+    case BSON_DATA_CODE:
+    case BSON_DATA_SYMBOL:
+      if(type == BSON_DATA_CODE) {
+        BSON::json_write(writer, "{\"$code\":", 9);
+      } else {
+        BSON::json_write(writer, "{\"$symbol\":", 11);
+      }
+      BSON::json_write_string(writer, data + 4, BSON::json_string_length(data, size));
+      BSON::json_write(writer, "}", 1);
+      break;
+    case BSON_DATA_CODE_W_SCOPE: {
+      // Total size, code string and scope document
+      if(size < 4 + 5 + 5) BSON::json_corrupt();
+      uint32_t code_length = BSON::json_string_length(data + 4, size - 4);
+      if(4 + 4 + code_length + 1 > size) BSON::json_corrupt();
+      BSON::json_write(writer, "{\"$code\":", 9);
+      BSON::json_write_string(writer, data + 8, code_length);
+      BSON::json_write(writer, ",\"$scope\":", 10);
+      BSON::json_write_document(writer, data + 8 + code_length + 1, size - 8 - code_length - 1, false);
+      BSON::json_write(writer, "}", 1);
+      break;
+    }
+    case BSON_DATA_INT: {
+      int32_t value = (int32_t)BSON::deserialize_int32(data, 0);
+      int length = sprintf(number, writer->canonical ? "{\"$numberInt\":\"%d\"}" : "%d", value);
+      BSON::json_write(writer, number, length);
+      break;
+    }
+    case BSON_DATA_TIMESTAMP: {
+      int length = sprintf(number, "{\"$timestamp\":{\"t\":%u,\"i\":%u}}", BSON::deserialize_int32(data, 4), BSON::deserialize_int32(data, 0));
+      BSON::json_write(writer, number, length);
+      break;
+    }
+    case BSON_DATA_LONG: {
+      int64_t value;
+      memcpy(&value, data, 8);
+      int length = sprintf(number, writer->canonical ? "{\"$numberLong\":\"%lld\"}" : "%lld", (long long)value);
+      BSON::json_write(writer, number, length);
+      break;
+    }
+    case BSON_DATA_MIN_KEY:
+      BSON::json_write(writer, "{\"$minKey\":1}", 13);
+      break;
+    case BSON_DATA_MAX_KEY:
+      BSON::json_write(writer, "{\"$maxKey\":1}", 13);
+      break;
+  }
+}
+
+// Write a UTF-8 string as a quoted JSON string, escaped like JSON.stringify does
+void BSON::json_write_string(JSONWriter *writer, const char *string, uint32_t length) {
+  static const char hex[] = "0123456789abcdef";
+  BSON::json_write(writer, "\"", 1);
+  uint32_t run_start = 0;
+
+  for(uint32_t i = 0; i < length; i++) {
+    unsigned char c = string[i];
+    if(c >= 0x20 && c != '"' && c != '\\') continue;
+
+    // Flush the run of plain characters before the escape
+    BSON::json_write(writer, string + run_start, i - run_start);
+    run_start = i + 1;
+
+    switch(c) {
+      case '"': BSON::json_write(writer, "\\\"", 2); break;
+      case '\\': BSON::json_write(writer, "\\\\", 2); break;
+      case '\b': BSON::json_write(writer, "\\b", 2); break;
+      case '\f': BSON::json_write(writer, "\\f", 2); break;
+      case '\n': BSON::json_write(writer, "\\n", 2); break;
+      case '\r': BSON::json_write(writer, "\\r", 2); break;
+      case '\t': BSON::json_write(writer, "\\t", 2); break;
+      default: {
+        char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F]};
+        BSON::json_write(writer, escape, 6);
+      }
+    }
+  }
+
+  BSON::json_write(writer, string + run_start, length - run_start);
+  BSON::json_write(writer, "\"", 1);
+}
+
+// Write a double the way Number.prototype.toString prints it, non finite values as extended JSON.
+// Canonical output keeps the sign of zero and a ".0" on integral values so it reads back as a double
+void BSON::json_write_double(JSONWriter *writer, double value) {
+  char text[64];
+  char digits[32];
+  int length = 0;
+
+  if(value != value) {
+    strcpy(text, "NaN");
+  } else if(value == std::numeric_limits<double>::infinity()) {
+    strcpy(text, "Infinity");
+  } else if(value == -std::numeric_limits<double>::infinity()) {
+    strcpy(text, "-Infinity");
+  } else if(value == 0) {
+    strcpy(text, writer->canonical && 1 / value < 0 ? "-0" : "0");
+  } else {
+    // Find the fewest significant digits that read back as the same value
+    char scientific[32];
+    for(int precision = 1; precision <= 17; precision++) {
+      sprintf(scientific, "%.*e", precision - 1, value);
+      if(strtod(scientific, NULL) == value) break;
+    }
+
+    // Split d.ddde+x into the digits and the exponent
+    char *mantissa = scientific[0] == '-' ? scientific + 1 : scientific;
+    char *exponent_str = strchr(mantissa, 'e');
+    int exponent = atoi(exponent_str + 1);
+    int number_of_digits = 0;
+    for(char *c = mantissa; c < exponent_str; c++) {
+      if(*c != '.') digits[number_of_digits++] = *c;
+    }
+    while(number_of_digits > 1 && digits[number_of_digits - 1] == '0') number_of_digits--;
+
+    // Position of the decimal point relative to the digits
+    int point = exponent + 1;
+    if(value < 0) text[length++] = '-';
+
+    if(number_of_digits <= point && point <= 21) {
+      memcpy(text + length, digits, number_of_digits);
+      length = length + number_of_digits;
+      for(int i = number_of_digits; i < point; i++) text[length++] = '0';
+    } else if(0 < point && point <= 21) {
+      memcpy(text + length, digits, point);
+      length = length + point;
+      text[length++] = '.';
+      memcpy(text + length, digits + point, number_of_digits - point);
+      length = length + number_of_digits - point;
+    } else if(-6 < point && point <= 0) {
+      text[length++] = '0';
+      text[length++] = '.';
+      for(int i = point; i < 0; i++) text[length++] = '0';
+      memcpy(text + length, digits, number_of_digits);
+      length = length + number_of_digits;
+    } else {
+      text[length++] = digits[0];
+      if(number_of_digits > 1) {
+        text[length++] = '.';
+        memcpy(text + length, digits + 1, number_of_digits - 1);
+        length = length + number_of_digits - 1;
+      }
+      length = length + sprintf(text + length, "e%c%d", point - 1 >= 0 ? '+' : '-', abs(point - 1));
+    }
+
+    text[length] = '\0';
+  }
+
+  // Relaxed JSON only has finite numbers
+  bool finite = value == value && value != std::numeric_limits<double>::infinity() && value != -std::numeric_limits<double>::infinity();
+  if(writer->canonical && finite && strchr(text, '.') == NULL && strchr(text, 'e') == NULL) {
+    strcat(text, ".0");
+  }
 
+  if(writer->canonical || !finite) {
+    BSON::json_write(writer, "{\"$numberDouble\":\"", 18);
+    BSON::json_write(writer, text, strlen(text));
+    BSON::json_write(writer, "\"}", 2);
+  } else {
+    BSON::json_write(writer, text, strlen(text));
+  }
+}
 
-Handle<Value> BSON::ToLong(const Arguments &args) {
-  HandleScope scope;
+// Write a date as ISO-8601 text for the years 1970 to 9999 or as its milliseconds
+void BSON::json_write_date(JSONWriter *writer, int64_t value) {
+  char text[64];
+  int length = 0;
+
+  if(!writer->canonical && value >= 0 && value < 253402300800000LL) {
+    // Civil date of the day since the epoch
+    int64_t days = value / 86400000;
+    int64_t milliseconds = value % 86400000;
+    days = days + 719468;
+    int64_t era = days / 146097;
+    uint32_t day_of_era = (uint32_t)(days - era * 146097);
+    uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    uint32_t month_index = (5 * day_of_year + 2) / 153;
+    uint32_t day = day_of_year - (153 * month_index + 2) / 5 + 1;
+    uint32_t month = month_index < 10 ? month_index + 3 : month_index - 9;
+    int64_t year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+    length = sprintf(text, "{\"$date\":\"%04d-%02u-%02uT%02d:%02d:%02d.%03dZ\"}", (int)year, month, day,
+      (int)(milliseconds / 3600000), (int)(milliseconds / 60000 % 60), (int)(milliseconds / 1000 % 60), (int)(milliseconds % 1000));
+  } else {
+    length = sprintf(text, "{\"$date\":{\"$numberLong\":\"%lld\"}}", (long long)value);
+  }
 
-  if(args.Length() != 2 && !args[0]->IsString() && !args[1]->IsString()) return VException("Two arguments of type String required");
-  // Create a new Long value and return it
-  Local<Value> argv[] = {args[0], args[1]};
-  Handle<Value> long_obj = Long::constructor_template->GetFunction()->NewInstance(2, argv);    
-  return scope.Close(long_obj);
+  BSON::json_write(writer, text, length);
 }
 
-Handle<Value> BSON::ToInt(const Arguments &args) {
-  HandleScope scope;
-
-  if(args.Length() != 1 && !args[0]->IsNumber() && !args[1]->IsString()) return VException("One argument of type Number required");  
-  // Return int value
-  return scope.Close(args[0]->ToInt32());
+// Write bytes as standard padded base64
+void BSON::json_write_base64(JSONWriter *writer, const char *bytes, uint32_t length) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char block[4];
+
+  for(uint32_t i = 0; i < length; i = i + 3) {
+    uint32_t remaining = length - i;
+    uint32_t triple = ((uint8_t)bytes[i]) << 16;
+    if(remaining > 1) triple |= ((uint8_t)bytes[i + 1]) << 8;
+    if(remaining > 2) triple |= (uint8_t)bytes[i + 2];
+
+    block[0] = alphabet[(triple >> 18) & 0x3F];
+    block[1] = alphabet[(triple >> 12) & 0x3F];
+    block[2] = remaining > 1 ? alphabet[(triple >> 6) & 0x3F] : '=';
+    block[3] = remaining > 2 ? alphabet[triple & 0x3F] : '=';
+    BSON::json_write(writer, block, 4);
+  }
 }
 
-Handle<Value> BSON::EncodeLong(const Arguments &args) {
-  HandleScope scope;
-  
-  // Encode the value
-  if(args.Length() != 1 && !Long::HasInstance(args[0])) return VException("One argument required of type Long");
-  // Unpack the object and encode
-  Local<Object> obj = args[0]->ToObject();
-  Long *long_obj = Long::Unwrap<Long>(obj);
-  // Allocate space
-  char *long_str = (char *)malloc(8 * sizeof(char));
-  // Write the content to the char array
-  BSON::write_int32((long_str), long_obj->low_bits);
-  BSON::write_int32((long_str + 4), long_obj->high_bits);
-  // Encode the data
-  Local<String> long_final_str = Encode(long_str, 8, BINARY)->ToString();
-  // Free up memory
-  free(long_str);
-  // Return the encoded string
-  return scope.Close(long_final_str);
+// Check if a double holds an integer that survives a round trip through int64
+bool BSON::is_js_integer(double value) {
+  // Negative zero doesn't survive as an integer
+  return value >= BSON_JS_INT_MIN && value <= BSON_JS_INT_MAX && value == floor(value) && !(value == 0 && 1 / value < 0);
 }
 
 void BSON::write_int32(char *data, uint32_t value) {
@@ -308,47 +1800,54 @@ void BSON::write_int64(char *data, int64_t value) {
   memcpy(data, &value, 8);      
 }
 
-char *BSON::check_key(Local<String> key) {
-  // Allocate space for they key string
-  char *key_str = (char *)malloc(key->Utf8Length() * sizeof(char) + 1);
-  // Error string
-  char *error_str = (char *)malloc(256 * sizeof(char));
-  // Decode the key
-  ssize_t len = DecodeBytes(key, BINARY);
-  ssize_t written = DecodeWrite(key_str, len, key, BINARY);
-  *(key_str + key->Utf8Length()) = '\0';
-  // Check if we have a valid key
-  if(key->Utf8Length() > 0 && *(key_str) == '$') {
-    // Create the string
-    sprintf(error_str, "key %s must not start with '$'", key_str);
-    // Free up memory
-    free(key_str);
-    // Throw exception with string
-    throw error_str;
-  } else if(key->Utf8Length() > 0 && strchr(key_str, '.') != NULL) {
-    // Create the string
-    sprintf(error_str, "key %s must not contain '.'", key_str);
-    // Free up memory
-    free(key_str);
-    // Throw exception with string
-    throw error_str;
+// Check a key already written out as UTF-8, it must not start with '$' or contain a '.'. The
+// error message is only allocated when the key is invalid
+void BSON::check_key(const char *key, uint32_t length) {
+  const char *reason = NULL;
+
+  if(length > 0 && *key == '$') {
+    reason = "must not start with '$'";
+  } else {
+    uint32_t i = 0;
+    // Look for a '.' eight bytes at a time, a word holding one has a zero byte once xor'ed with '.'s
+    for(; i + 8 <= length; i = i + 8) {
+      uint64_t word;
+      memcpy(&word, key + i, 8);
+      word = word ^ 0x2e2e2e2e2e2e2e2eULL;
+      if(((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) != 0) break;
+    }
+
+    for(; i < length; i++) {
+      if(key[i] == '.') {
+        reason = "must not contain '.'";
+        break;
+      }
+    }
   }
-  // Free allocated space
-  free(key_str);
-  free(error_str);
-  // Return No check key error
-  return NULL;
+
+  if(reason == NULL) return;
+
+  char *error_str = (char *)malloc(length + strlen(reason) + 6);
+  memcpy(error_str, "key ", 4);
+  memcpy(error_str + 4, key, length);
+  sprintf(error_str + 4 + length, " %s", reason);
+  throw error_str;
+}
+
+// Write the name of an element as a C string and return the index after it, with check_key the
+// name is checked on the bytes written
+uint32_t BSON::write_name(char *serialized_object, uint32_t index, Handle<Value> name, bool check_key) {
+  ssize_t len = DecodeBytes(name, UTF8);
+  DecodeWrite((serialized_object + index), len, name, UTF8);
+  *(serialized_object + index + len) = '\0';
+  if(check_key) BSON::check_key(serialized_object + index, len);
+  return index + len + 1;
 }
 
-uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value> name, Handle<Value> value, bool check_key, bool serializeFunctions) {
+uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value> name, Handle<Value> value, bool check_key, bool serializeFunctions, bool long_integers) {
   // Scope for method execution
   HandleScope scope;
 
-  // If we have a name check that key is valid
-  if(!name->IsNull() && check_key) {
-    if(BSON::check_key(name->ToString()) != NULL) return -1;
-  }  
-  
   // Handle holder
   Local<String> constructorString;
   // Just check if we have an object
@@ -363,20 +1862,14 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_LONG;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
 
     // Unpack the object and encode
     Local<Object> obj = value->ToObject();
     Long *long_obj = Long::Unwrap<Long>(obj);
     // Write the content to the char array
-    BSON::write_int32((serialized_object + index), long_obj->low_bits);
-    BSON::write_int32((serialized_object + index + 4), long_obj->high_bits);
+    BSON::write_int64((serialized_object + index), long_obj->value);
     // Adjust the index
     index = index + 8;      
   } else if(Timestamp::HasInstance(value)) {
@@ -384,13 +1877,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     uint32_t startIndex = index;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
     
     // Save the string at the offset provided
     *(serialized_object + startIndex) = BSON_DATA_TIMESTAMP;
@@ -407,23 +1895,14 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_OID;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
 
     // Unpack the object and encode
     Local<Object> obj = value->ToObject();
     ObjectID *object_id_obj = ObjectID::Unwrap<ObjectID>(obj);
-    // Fetch the converted oid
-    char *binary_oid = object_id_obj->convert_hex_oid_to_bin();
     // Write the oid to the char array
-    memcpy((serialized_object + index), binary_oid, 12);
-    // Free memory
-    free(binary_oid);
+    memcpy((serialized_object + index), object_id_obj->oid, 12);
     // Adjust the index
     index = index + 12;          
   } else if(Binary::HasInstance(value)) { // || (value->IsObject() && value->ToObject()->GetConstructorName()->Equals(String::New("Binary")))) {
@@ -431,13 +1910,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_BINARY;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
 
     // Unpack the object and encode
     Local<Object> obj = value->ToObject();
@@ -468,20 +1942,20 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     obj->Set(String::New("$id"), oid_value);      
     // obj->Set(String::New("$db"), dbref->Get(String::New("db")));
     if(db_ref_obj->db != NULL) obj->Set(String::New("$db"), dbref->Get(String::New("db")));
+    // The name of the dbref is checked here as its $ fields are written without checking keys
+    if(check_key) {
+      String::Utf8Value key(name);
+      BSON::check_key(*key, key.length());
+    }
     // Encode the variable
-    index = BSON::serialize(serialized_object, index, name, obj, false, serializeFunctions);
+    index = BSON::serialize(serialized_object, index, name, obj, false, serializeFunctions, long_integers);
   } else if(Code::HasInstance(value)) { // || (value->IsObject() && value->ToObject()->GetConstructorName()->Equals(String::New("exports.Code")))) {
     // Save the string at the offset provided
     *(serialized_object + index) = BSON_DATA_CODE_W_SCOPE;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
 
     // Unpack the object and encode
     Local<Object> obj = value->ToObject();
@@ -502,7 +1976,7 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     // Encode the scope
     uint32_t scope_object_size = BSON::calculate_object_size(code_obj->scope_object, serializeFunctions);
     // Serialize the scope object
-    BSON::serialize((serialized_object + index), 0, Null(), code_obj->scope_object, check_key, serializeFunctions);
+    BSON::serialize((serialized_object + index), 0, Null(), code_obj->scope_object, check_key, serializeFunctions, long_integers);
     // Adjust the index
     index = index + scope_object_size;
     // Encode the total size of the object
@@ -513,13 +1987,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_NUMBER;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
 
     // Unpack the double
     Local<Object> doubleHObject = value->ToObject();
@@ -544,13 +2013,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_SYMBOL;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;        
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
     
     // Write the actual string into the char array
     Local<String> str = value->ToString();
@@ -576,7 +2040,7 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
       // Adjust the index
       index = index + 4;
       // Write string to char in utf8 format
-      written = DecodeWrite((serialized_object + index), str->Length(), str, BINARY);
+      ssize_t written = DecodeWrite((serialized_object + index), str->Length(), str, BINARY);
       // Add the null termination
       *(serialized_object + index + str->Length()) = '\0';    
       // Adjust the index
@@ -587,13 +2051,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_STRING;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;        
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
     
     // Write the actual string into the char array
     Local<String> str = value->ToString();
@@ -619,7 +2078,7 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
       // Adjust the index
       index = index + 4;
       // Write string to char in utf8 format
-      written = DecodeWrite((serialized_object + index), str->Length(), str, BINARY);
+      ssize_t written = DecodeWrite((serialized_object + index), str->Length(), str, BINARY);
       // Add the null termination
       *(serialized_object + index + str->Length()) = '\0';    
       // Adjust the index
@@ -630,102 +2089,64 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_MIN_KEY;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
   } else if(MaxKey::HasInstance(value)) {
     // Save the string at the offset provided
     *(serialized_object + index) = BSON_DATA_MAX_KEY;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
   } else if(value->IsNull() || value->IsUndefined()) {
     // Save the string at the offset provided
     *(serialized_object + index) = BSON_DATA_NULL;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
   } else if(value->IsNumber()) {
     uint32_t first_pointer = index;
     // Save the string at the offset provided
     *(serialized_object + index) = BSON_DATA_INT;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
-    
-    Local<Number> number = value->ToNumber();
-    // Get the values
-    double d_number = number->NumberValue();
-    int64_t l_number = number->IntegerValue();
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
     
-    // Check if we have a double value and not a int64
-    double d_result = d_number - l_number;    
-    // If we have a value after subtracting the integer value we have a float
-    if(d_result > 0 || d_result < 0) {
-      // Write the double to the char array
-      BSON::write_double((serialized_object + index), d_number);
-      // Adjust type to be double
-      *(serialized_object + first_pointer) = BSON_DATA_NUMBER;
-      // Adjust index for double
-      index = index + 8;
-    } else if(l_number <= BSON_INT32_MAX && l_number >= BSON_INT32_MIN) {
-      // printf("--------------------------------------------------------------- 2\n");
+    // SMI's and heap numbers holding a 32 bit integer can be written straight away
+    if(value->IsInt32()) {
       // Smaller than 32 bit, write as 32 bit value
-      BSON::write_int32(serialized_object + index, value->ToInt32()->Value());
+      BSON::write_int32(serialized_object + index, value->Int32Value());
       // Adjust the size of the index
       index = index + 4;
-    } else if(l_number <= (2^53) && l_number >= (-2^53)) {
-      // printf("--------------------------------------------------------------- 3\n");
-      // Write the double to the char array
-      BSON::write_double((serialized_object + index), d_number);
-      // Adjust type to be double
-      *(serialized_object + first_pointer) = BSON_DATA_NUMBER;
-      // Adjust index for double
-      index = index + 8;      
     } else {
-      // printf("--------------------------------------------------------------- 4\n");
-      BSON::write_double((serialized_object + index), d_number);
-      // BSON::write_int64((serialized_object + index), d_number);
-      // BSON::write_int64((serialized_object + index), l_number);
-      // Adjust type to be double
-      *(serialized_object + first_pointer) = BSON_DATA_NUMBER;
-      // Adjust the size of the index
+      // Get the value
+      double d_number = value->NumberValue();
+      
+      // Integers up to 2^53 can be written as a 64 bit integer without any loss of precision
+      if(long_integers && BSON::is_js_integer(d_number)) {
+        // Write the integer to the char array
+        BSON::write_int64((serialized_object + index), (int64_t)d_number);
+        // Adjust type to be long
+        *(serialized_object + first_pointer) = BSON_DATA_LONG;
+      } else {
+        // Write the double to the char array
+        BSON::write_double((serialized_object + index), d_number);
+        // Adjust type to be double
+        *(serialized_object + first_pointer) = BSON_DATA_NUMBER;
+      }
+      
+      // Adjust index for double or long
       index = index + 8;
-    }     
+    }
   } else if(value->IsBoolean()) {
     // Save the string at the offset provided
     *(serialized_object + index) = BSON_DATA_BOOLEAN;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
 
     // Save the boolean value
     *(serialized_object + index) = value->BooleanValue() ? '\1' : '\0';
@@ -736,16 +2157,12 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_DATE;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
 
-    // Fetch the Integer value
-    int64_t integer_value = value->IntegerValue();
+    // Read the time value straight out of the Date instead of calling valueOf, invalid dates are written as 0
+    double time_value = Handle<Date>::Cast(value)->NumberValue();
+    int64_t integer_value = std::isnan(time_value) ? 0 : (int64_t)time_value;
     BSON::write_int64((serialized_object + index), integer_value);
     // Adjust the index
     index = index + 8;
@@ -755,18 +2172,20 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_REGEXP;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;    
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
 
-    // Fetch the string for the regexp
+    // Take the source bytes of a regexp that came out of the decoder from the cache
     Handle<RegExp> regExp = Handle<RegExp>::Cast(value);    
-    len = DecodeBytes(regExp->GetSource(), UTF8);
-    written = DecodeWrite((serialized_object + index), len, regExp->GetSource(), UTF8);
+    CachedRegExp *cached = BSON::find_regexp(regExp);
+    ssize_t len;
+    if(cached != NULL) {
+      len = cached->length;
+      memcpy((serialized_object + index), cached->source, len);
+    } else {
+      len = DecodeBytes(regExp->GetSource(), UTF8);
+      DecodeWrite((serialized_object + index), len, regExp->GetSource(), UTF8);
+    }
     int flags = regExp->GetFlags();
     // Add null termiation for the string
     *(serialized_object + index + len) = '\0';    
@@ -798,13 +2217,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
     *(serialized_object + index) = BSON_DATA_ARRAY;
     // Adjust writing position for the first byte
     index = index + 1;
-    // Convert name to char*
-    ssize_t len = DecodeBytes(name, UTF8);
-    ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-    // Add null termiation for the string
-    *(serialized_object + index + len) = '\0';    
-    // Adjust the index
-    index = index + len + 1;        
+    // Write the name, checking it on the way when checking keys
+    index = BSON::write_name(serialized_object, index, name, check_key);
     // Object size
     uint32_t object_size = BSON::calculate_object_size(value, serializeFunctions);
     // Write the size of the object
@@ -816,7 +2230,7 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
       // Add "index" string size for each element
       sprintf(length_str, "%d", i);
       // Encode the values      
-      index = BSON::serialize(serialized_object, index, String::New(length_str), array->Get(Integer::New(i)), check_key, serializeFunctions);
+      index = BSON::serialize(serialized_object, index, String::New(length_str), array->Get(Integer::New(i)), check_key, serializeFunctions, long_integers);
       // Write trailing '\0' for object
       *(serialized_object + index) = '\0';
     }
@@ -833,13 +2247,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
   
       // Adjust writing position for the first byte
       index = index + 1;
-      // Convert name to char*
-      ssize_t len = DecodeBytes(name, UTF8);
-      ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-      // Add null termiation for the string
-      *(serialized_object + index + len) = '\0';    
-      // Adjust the index
-      index = index + len + 1;    
+      // Write the name, checking it on the way when checking keys
+      index = BSON::write_name(serialized_object, index, name, check_key);
   
       // Need to convert function into string
       Local<String> str = value->ToString();
@@ -864,7 +2273,7 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
         // Adjust the index
         index = index + 4;
         // Write string to char in utf8 format
-        written = DecodeWrite((serialized_object + index), str->Length(), str, BINARY);
+        ssize_t written = DecodeWrite((serialized_object + index), str->Length(), str, BINARY);
         // Add the null termination
         *(serialized_object + index + str->Length()) = '\0';    
         // Adjust the index
@@ -904,13 +2313,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
       *(serialized_object + index) = BSON_DATA_OBJECT;
       // Adjust writing position for the first byte
       index = index + 1;
-      // Convert name to char*
-      ssize_t len = DecodeBytes(name, UTF8);
-      ssize_t written = DecodeWrite((serialized_object + index), len, name, UTF8);
-      // Add null termiation for the string
-      *(serialized_object + index + len) = '\0';    
-      // Adjust the index
-      index = index + len + 1;          
+      // Write the name, checking it on the way when checking keys
+      index = BSON::write_name(serialized_object, index, name, check_key);
     }
         
     // Unwrap the object
@@ -933,16 +2337,8 @@ uint32_t BSON::serialize(char *serialized_object, uint32_t index, Handle<Value>
       // Write the next serialized object
       // printf("========== !property->IsFunction() || (property->IsFunction() && serializeFunctions) = %d\n", !property->IsFunction() || (property->IsFunction() && serializeFunctions) == true ? 1 : 0);
       if(!property->IsFunction() || (property->IsFunction() && serializeFunctions)) {
-        // Convert name to char*
-        ssize_t len = DecodeBytes(property_name, UTF8);
-        // char *data = new char[len];
-        char *data = (char *)malloc(len + 1);
-        *(data + len) = '\0';
-        ssize_t written = DecodeWrite(data, len, property_name, UTF8);      
         // Serialize the content
-        index = BSON::serialize(serialized_object, index, property_name, property, check_key, serializeFunctions);      
-        // Free up memory of data
-        free(data);
+        index = BSON::serialize(serialized_object, index, property_name, property, check_key, serializeFunctions, long_integers);      
       }
     }
     // Pad the last item
@@ -1034,28 +2430,17 @@ uint32_t BSON::calculate_object_size(Handle<Value> value, bool serializeFunction
   } else if(Double::HasInstance(value)) {
     object_size = object_size + 8;
   } else if(value->IsNumber()) {
-    // Check if we have a float value or a long value
-    Local<Number> number = value->ToNumber();
-    double d_number = number->NumberValue();
-    int64_t l_number = number->IntegerValue();
-    // Check if we have a double value and not a int64
-    double d_result = d_number - l_number;    
-    // If we have a value after subtracting the integer value we have a float
-    if(d_result > 0 || d_result < 0) {
-      object_size = object_size + 8;      
-    } else if(l_number <= BSON_INT32_MAX && l_number >= BSON_INT32_MIN) {
-      object_size = object_size + 4;
-    } else {
-      object_size = object_size + 8;
-    }
+    // 32 bit integers are stored as int32, everything else as a double or int64
+    object_size = object_size + (value->IsInt32() ? 4 : 8);
   } else if(value->IsBoolean()) {
     object_size = object_size + 1;
   } else if(value->IsDate()) {
     object_size = object_size + 8;
   } else if(value->IsRegExp()) {
-    // Fetch the string for the regexp
+    // Take the source length of a regexp that came out of the decoder from the cache
     Handle<RegExp> regExp = Handle<RegExp>::Cast(value);    
-    ssize_t len = DecodeBytes(regExp->GetSource(), UTF8);
+    CachedRegExp *cached = BSON::find_regexp(regExp);
+    ssize_t len = cached != NULL ? cached->length : DecodeBytes(regExp->GetSource(), UTF8);
     int flags = regExp->GetFlags();
     
     // ignorecase
@@ -1153,10 +2538,15 @@ Handle<Value> BSON::BSONDeserialize(const Arguments &args) {
   HandleScope scope;
 
   // Ensure that we have an parameter
-  if(Buffer::HasInstance(args[0]) && args.Length() > 1) return VException("One argument required - buffer1.");
-  if(args[0]->IsString() && args.Length() > 1) return VException("One argument required - string1.");
+  if(Buffer::HasInstance(args[0]) && args.Length() > 2) return VException("Two arguments max - buffer1, options.");
+  if(args[0]->IsString() && args.Length() > 2) return VException("Two arguments max - string1, options.");
   // Throw an exception if the argument is not of type Buffer
   if(!Buffer::HasInstance(args[0]) && !args[0]->IsString()) return VException("Argument must be a Buffer or String.");
+  if(args.Length() == 2 && !args[1]->IsObject() && !args[1]->IsUndefined() && !args[1]->IsNull()) return VException("Options must be an object.");
+
+  // Unpack the decoding options
+  DeserializeOptions options;
+  BSON::unpack_deserialize_options(args.Length() == 2 ? args[1] : Handle<Value>(Undefined()), &options);
   
   // Define pointer to data
   char *data;
@@ -1175,7 +2565,9 @@ Handle<Value> BSON::BSONDeserialize(const Arguments &args) {
      uint32_t length = Buffer::Length(obj);
     #endif
 
-    return BSON::deserialize(data, NULL);
+    Handle<Value> result = BSON::deserialize(data, false, &options);
+    BSON::free_deserialize_options(&options);
+    return scope.Close(result);
   } else {
     // Let's fetch the encoding
     // enum encoding enc = ParseEncoding(args[1]);
@@ -1189,16 +2581,287 @@ Handle<Value> BSON::BSONDeserialize(const Arguments &args) {
     // Assert that we wrote the same number of bytes as we have length
     assert(written == len);
     // Get result
-    Handle<Value> result = BSON::deserialize(data, NULL);
+    Handle<Value> result = BSON::deserialize(data, false, &options);
     // Free memory
     free(data);
+    BSON::free_deserialize_options(&options);
     // Deserialize the content
     return result;
   }  
 }
 
+// Deserialize a run of consecutive documents into an array in one call, arguments are
+// (data, startIndex, numberOfDocuments, documents, docStartIndex, options), returns the index after the last document
+Handle<Value> BSON::BSONDeserializeStream(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() < 5 || !Buffer::HasInstance(args[0]) || !(args[1]->IsUint32() || args[1]->IsArray()) || !args[2]->IsUint32()
+    || !args[3]->IsArray() || !args[4]->IsUint32()) {
+    return VException("Five or six arguments required - [buffer, number or array, number, array, number, options]");
+  }
+  if(args.Length() == 6 && !args[5]->IsObject() && !args[5]->IsUndefined() && !args[5]->IsNull()) return VException("Options must be an object.");
+
+  DeserializeOptions options;
+  BSON::unpack_deserialize_options(args.Length() == 6 ? args[5] : Handle<Value>(Undefined()), &options);
+  // The documents of a batch mostly repeat the same field names, decode each name once
+  options.names = (InternedString *)calloc(BSON_INTERN_TABLE_SIZE, sizeof(InternedString));
+
+  Local<Object> obj = args[0]->ToObject();
+  char *data = Buffer::Data(obj);
+  uint32_t length = Buffer::Length(obj);
+  // The documents follow each other from index on, or start at the given offsets
+  Local<Array> offsets = args[1]->IsArray() ? Local<Array>::Cast(args[1]) : Local<Array>();
+  uint32_t index = offsets.IsEmpty() ? args[1]->Uint32Value() : 0;
+  uint32_t number_of_documents = args[2]->Uint32Value();
+  Local<Object> documents = args[3]->ToObject();
+  uint32_t insert_index = args[4]->Uint32Value();
+  if(!offsets.IsEmpty() && number_of_documents > offsets->Length()) number_of_documents = offsets->Length();
+
+  for(uint32_t i = 0; i < number_of_documents; i++) {
+    if(!offsets.IsEmpty()) {
+      Local<Value> offset = offsets->Get(i);
+      if(!offset->IsUint32()) {
+        BSON::free_deserialize_options(&options);
+        return VException("Document offsets must be numbers.");
+      }
+      index = offset->Uint32Value();
+    }
+
+    // Make sure the whole document is in the buffer
+    uint32_t size = index + 4 > length ? 0 : BSON::deserialize_int32(data, index);
+    if(size < 5 || index + size > length) {
+      BSON::free_deserialize_options(&options);
+      return VException("Corrupt BSON document stream.");
+    }
+
+    TryCatch try_catch;
+    Handle<Value> document = BSON::deserialize(data + index, false, &options);
+    // Stop at the first document that fails to decode
+    if(try_catch.HasCaught()) {
+      BSON::free_deserialize_options(&options);
+      return try_catch.ReThrow();
+    }
+    documents->Set(Number::New(insert_index + i), document);
+    index = index + size;
+  }
+
+  BSON::free_deserialize_options(&options);
+  return scope.Close(Uint32::New(index));
+}
+
+// Read the decoding options off an options object, any missing option is false,
+// the options must be released with free_deserialize_options
+void BSON::unpack_deserialize_options(Handle<Value> value, DeserializeOptions *options) {
+  options->raw_timestamps = false;
+  options->raw_dates = false;
+  options->fields = NULL;
+  options->number_of_fields = 0;
+  options->external_string_threshold = 0;
+  options->strings = NULL;
+  options->names = NULL;
+  options->cache_regexps = false;
+  if(!value->IsObject()) return;
+
+  Local<Object> options_obj = value->ToObject();
+  options->raw_timestamps = options_obj->Get(String::New("rawTimestamps"))->BooleanValue();
+  options->raw_dates = options_obj->Get(String::New("rawDates"))->BooleanValue();
+  options->external_string_threshold = options_obj->Get(String::New("externalStringThreshold"))->Uint32Value();
+  options->cache_regexps = options_obj->Get(String::New("cacheRegExps"))->BooleanValue();
+
+  // The intern table lives as long as the options, all the documents of a call share it
+  if(options_obj->Get(String::New("internStrings"))->BooleanValue()) {
+    options->strings = (InternedString *)calloc(BSON_INTERN_TABLE_SIZE, sizeof(InternedString));
+  }
+
+  // Copy the names of the fields to decode so they can be compared in place with the keys
+  Local<Value> fields_value = options_obj->Get(String::New("fields"));
+  if(fields_value->IsArray()) {
+    Local<Array> fields = Local<Array>::Cast(fields_value);
+    options->number_of_fields = fields->Length();
+    // One extra slot so an empty projection still gets a non NULL list
+    options->fields = (char **)malloc((options->number_of_fields + 1) * sizeof(char *));
+
+    for(uint32_t i = 0; i < options->number_of_fields; i++) {
+      String::Utf8Value name(fields->Get(i));
+      options->fields[i] = strdup(*name);
+    }
+  }
+}
+
+void BSON::free_deserialize_options(DeserializeOptions *options) {
+  BSON::free_intern_table(options->strings);
+  options->strings = NULL;
+  BSON::free_intern_table(options->names);
+  options->names = NULL;
+
+  if(options->fields == NULL) return;
+
+  for(uint32_t i = 0; i < options->number_of_fields; i++) {
+    free(options->fields[i]);
+  }
+
+  free(options->fields);
+  options->fields = NULL;
+  options->number_of_fields = 0;
+}
+
+// Check if a top level field is part of the decode projection
+bool BSON::is_selected_field(char *name, DeserializeOptions *options) {
+  for(uint32_t i = 0; i < options->number_of_fields; i++) {
+    if(strcmp(name, options->fields[i]) == 0) return true;
+  }
+
+  return false;
+}
+
+void BSON::free_intern_table(InternedString *strings) {
+  if(strings == NULL) return;
+
+  for(uint32_t i = 0; i < BSON_INTERN_TABLE_SIZE; i++) {
+    if(!strings[i].value.IsEmpty()) strings[i].value.Dispose();
+  }
+
+  free(strings);
+}
+
+// Decode a short string through an intern table. The table is direct mapped on a hash
+// of the bytes, a string that lands on a slot holding the same bytes gets the string
+// decoded before, any other string replaces the one in the slot
+Handle<String> BSON::intern_string(char *data, uint32_t length, InternedString *strings, bool symbol) {
+  // FNV-1a
+  uint32_t hash = 2166136261U;
+  for(uint32_t i = 0; i < length; i++) {
+    hash = (hash ^ (uint8_t)data[i]) * 16777619U;
+  }
+
+  InternedString *slot = strings + (hash & (BSON_INTERN_TABLE_SIZE - 1));
+  if(!slot->value.IsEmpty() && slot->length == length && memcmp(slot->data, data, length) == 0) {
+    return slot->value;
+  }
+
+  Local<String> value = symbol ? String::NewSymbol(data, length) : Encode(data, length, UTF8)->ToString();
+  if(!slot->value.IsEmpty()) slot->value.Dispose();
+  slot->value = Persistent<String>::New(value);
+  slot->length = length;
+  memcpy(slot->data, data, length);
+  return value;
+}
+
+// The key of a field, with a name table the documents of a batch share one symbol per
+// name so setting the field skips creating and looking up a new key string
+Handle<String> BSON::field_name(char *name, DeserializeOptions *options) {
+  if(options->names == NULL) return String::New(name);
+
+  uint32_t length = strlen(name);
+  if(length > BSON_INTERN_MAX_LENGTH) return String::New(name, length);
+  return BSON::intern_string(name, length, options->names, true);
+}
+
+// Decode a string value, short values go through the intern table when interning and
+// large ASCII values are copied once outside of the V8 heap into an external string
+Handle<Value> BSON::decode_string(char *data, uint32_t length, DeserializeOptions *options) {
+  if(options->strings != NULL && length <= BSON_INTERN_MAX_LENGTH) {
+    return BSON::intern_string(data, length, options->strings, false);
+  }
+
+  if(options->external_string_threshold > 0 && length >= options->external_string_threshold) {
+    // External ASCII strings can't hold multi byte UTF-8 characters
+    bool ascii = true;
+    for(uint32_t i = 0; i < length && ascii; i++) {
+      ascii = (uint8_t)data[i] < 0x80;
+    }
+
+    if(ascii) {
+      char *bytes = (char *)malloc(length);
+      memcpy(bytes, data, length);
+      return String::NewExternal(new ExternalString(bytes, length));
+    }
+  }
+
+  return Encode(data, length, UTF8)->ToString();
+}
+
+// Decode a regular expression, with the cacheRegExps option a pattern and flags seen
+// before get the RegExp compiled for them the first time
+Handle<Value> BSON::decode_regexp(char *pattern, uint32_t length, int flags, DeserializeOptions *options) {
+  if(!options->cache_regexps) return RegExp::New(String::New(pattern, length), (v8::RegExp::Flags)flags);
+
+  // FNV-1a
+  uint32_t hash = 2166136261U;
+  for(uint32_t i = 0; i < length; i++) {
+    hash = (hash ^ (uint8_t)pattern[i]) * 16777619U;
+  }
+
+  for(uint32_t i = 0; i < BSON_REGEXP_CACHE_SIZE; i++) {
+    CachedRegExp *entry = regexp_cache + i;
+    if(entry->pattern != NULL && entry->hash == hash && entry->flags == flags
+      && entry->pattern_length == length && memcmp(entry->pattern, pattern, length) == 0) {
+      regexp_decode_hits++;
+      entry->last_used = ++regexp_cache_clock;
+      return entry->value;
+    }
+  }
+
+  regexp_decode_misses++;
+  Local<RegExp> value = RegExp::New(String::New(pattern, length), (v8::RegExp::Flags)flags);
+  BSON::cache_regexp(value, pattern, length, hash);
+  return value;
+}
+
+// The cache entry of a RegExp being serialized, NULL unless the decoder handed it out
+CachedRegExp* BSON::find_regexp(Handle<RegExp> regexp) {
+  // Nothing was ever decoded with the cacheRegExps option
+  if(regexp_cache_clock == 0) return NULL;
+
+  // The entry the RegExp was tagged with when cached, it may have been evicted and reused since
+  Local<Value> slot = regexp->GetHiddenValue(regexp_cache_symbol);
+  if(!slot.IsEmpty() && slot->IsUint32() && slot->Uint32Value() < BSON_REGEXP_CACHE_SIZE) {
+    CachedRegExp *entry = regexp_cache + slot->Uint32Value();
+    if(entry->source != NULL && entry->value == regexp) {
+      regexp_encode_hits++;
+      entry->last_used = ++regexp_cache_clock;
+      return entry;
+    }
+  }
+
+  regexp_encode_misses++;
+  return NULL;
+}
+
+// Store a decoded RegExp under its pattern, in place of the least recently used one when the cache is full
+CachedRegExp* BSON::cache_regexp(Handle<RegExp> value, char *pattern, uint32_t pattern_length, uint32_t hash) {
+  CachedRegExp *entry = regexp_cache;
+  for(uint32_t i = 0; i < BSON_REGEXP_CACHE_SIZE && entry->source != NULL; i++) {
+    if(regexp_cache[i].source == NULL || regexp_cache[i].last_used < entry->last_used) entry = regexp_cache + i;
+  }
+
+  if(entry->source != NULL) {
+    regexp_evictions++;
+    free(entry->pattern);
+    free(entry->source);
+    entry->value.Dispose();
+  }
+
+  entry->pattern = (char *)malloc(pattern_length + 1);
+  memcpy(entry->pattern, pattern, pattern_length);
+
+  // Always the bytes of GetSource so the size calculated and the bytes written match even if
+  // the entry is evicted in between
+  String::Utf8Value source(value->GetSource());
+  entry->source = (char *)malloc(source.length() + 1);
+  memcpy(entry->source, *source, source.length());
+  entry->length = source.length();
+  entry->pattern_length = pattern_length;
+  entry->hash = hash;
+  entry->flags = value->GetFlags();
+  entry->last_used = ++regexp_cache_clock;
+  entry->value = Persistent<RegExp>::New(value);
+  value->SetHiddenValue(regexp_cache_symbol, Uint32::New((uint32_t)(entry - regexp_cache)));
+  return entry;
+}
+
 // Deserialize the stream
-Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
+Handle<Value> BSON::deserialize(char *data, bool is_array_item, DeserializeOptions *options) {
   HandleScope scope;
   // Holds references to the objects that are going to be returned
   Local<Object> return_data = Object::New();
@@ -1209,6 +2872,10 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
   uint32_t size = BSON::deserialize_int32(data, index);
   // Adjust the index to point to next piece
   index = index + 4;      
+  // The decode projection only applies to the top level fields
+  DeserializeOptions nested_options = *options;
+  nested_options.fields = NULL;
+  nested_options.number_of_fields = 0;
 
   // While we have data left let's decode
   while(index < size) {
@@ -1218,6 +2885,15 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
     uint32_t insert_index = 0;
     // Adjust index to skip type byte
     index = index + 1;
+
+    // Step over fields outside the projection by their size without creating any values
+    if(options->fields != NULL && type != 0 && !BSON::is_selected_field(data + index, options)) {
+      index = index + strnlen(data + index, size - index) + 1;
+      int32_t element_size = BSON::value_size(data, index, type, size);
+      if(element_size < 0) return VException("Unknown BSON type found.");
+      index = index + element_size;
+      continue;
+    }
     
     if(type == BSON_DATA_STRING) {
       // Read the null terminated index String
@@ -1235,22 +2911,18 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       uint32_t string_size = BSON::deserialize_int32(data, index);
       // Adjust index to point to start of string
       index = index + 4;
-      // Decode the string and add zero terminating value at the end of the string
-      char *value = (char *)malloc((string_size * sizeof(char)));
-      strncpy(value, (data + index), string_size);
-      // Encode the string (string - null termiating character)
-      Local<Value> utf8_encoded_str = Encode(value, string_size - 1, UTF8)->ToString();
+      // Decode the string straight from the buffer (string - null termiating character)
+      Handle<Value> utf8_encoded_str = BSON::decode_string(data + index, string_size - 1, options);
       // Add the value to the data
       if(is_array_item) {
         return_array->Set(Number::New(insert_index), utf8_encoded_str);
       } else {
-        return_data->Set(String::New(string_name), utf8_encoded_str);
+        return_data->Set(BSON::field_name(string_name, options), utf8_encoded_str);
       }
       
       // Adjust index
       index = index + string_size;
       // Free up the memory
-      free(value);
       free(string_name);
     } else if(type == BSON_DATA_INT) {
       // Read the null terminated index String
@@ -1274,7 +2946,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {
         return_array->Set(Integer::New(insert_index), Integer::New(value));
       } else {
-        return_data->Set(String::New(string_name), Integer::New(value));
+        return_data->Set(BSON::field_name(string_name, options), Integer::New(value));
       }          
       // Free up the memory
       free(string_name);
@@ -1290,18 +2962,15 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
         insert_index = atoi(string_name);
       }      
       
-      // Decode the integer value
-      int64_t value = 0;
-      memcpy(&value, (data + index), 8);      
-      // Adjust the index for the size of the value
-      index = index + 8;
-            
       // Add the element to the object
       if(is_array_item) {
-        return_array->Set(Number::New(insert_index), BSON::decodeTimestamp(value));
+        return_array->Set(Number::New(insert_index), BSON::decodeTimestamp(data, index, options->raw_timestamps));
       } else {
-        return_data->Set(String::New(string_name), BSON::decodeTimestamp(value));
+        return_data->Set(BSON::field_name(string_name, options), BSON::decodeTimestamp(data, index, options->raw_timestamps));
       }
+
+      // Adjust the index for the size of the value
+      index = index + 8;
       // Free up the memory
       free(string_name);            
     } else if(type == BSON_DATA_LONG) {
@@ -1321,7 +2990,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {
         return_array->Set(Number::New(insert_index), BSON::decodeLong(data, index));
       } else {
-        return_data->Set(String::New(string_name), BSON::decodeLong(data, index));
+        return_data->Set(BSON::field_name(string_name, options), BSON::decodeLong(data, index));
       }        
 
       // Adjust the index for the size of the value
@@ -1351,7 +3020,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {
         return_array->Set(Number::New(insert_index), Number::New(value));
       } else {
-        return_data->Set(String::New(string_name), Number::New(value));
+        return_data->Set(BSON::field_name(string_name, options), Number::New(value));
       }
       // Free up the memory
       free(string_name);      
@@ -1373,7 +3042,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {
         return_array->Set(Number::New(insert_index), minKey->handle_);
       } else {
-        return_data->Set(String::New(string_name), minKey->handle_);
+        return_data->Set(BSON::field_name(string_name, options), minKey->handle_);
       }      
       // Free up the memory
       free(string_name);      
@@ -1395,7 +3064,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {
         return_array->Set(Number::New(insert_index), maxKey->handle_);
       } else {
-        return_data->Set(String::New(string_name), maxKey->handle_);
+        return_data->Set(BSON::field_name(string_name, options), maxKey->handle_);
       }      
       // Free up the memory
       free(string_name);      
@@ -1415,7 +3084,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {
         return_array->Set(Number::New(insert_index), Null());
       } else {
-        return_data->Set(String::New(string_name), Null());
+        return_data->Set(BSON::field_name(string_name, options), Null());
       }      
       // Free up the memory
       free(string_name);      
@@ -1440,7 +3109,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {
         return_array->Set(Number::New(insert_index), bool_value == 1 ? Boolean::New(true) : Boolean::New(false));
       } else {
-        return_data->Set(String::New(string_name), bool_value == 1 ? Boolean::New(true) : Boolean::New(false));
+        return_data->Set(BSON::field_name(string_name, options), bool_value == 1 ? Boolean::New(true) : Boolean::New(false));
       }            
       // Free up the memory
       free(string_name);      
@@ -1461,11 +3130,13 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       memcpy(&value, (data + index), 8);      
       // Adjust the index for the size of the value
       index = index + 8;
+      // Milliseconds since the epoch, only wrapped in a Date if asked for
+      Local<Value> date_value = options->raw_dates ? Number::New((double)value) : Date::New((double)value);
       // Add the element to the object
       if(is_array_item) {
-        return_array->Set(Number::New(insert_index), Date::New((double)value));
+        return_array->Set(Number::New(insert_index), date_value);
       } else {
-        return_data->Set(String::New(string_name), Date::New((double)value));
+        return_data->Set(BSON::field_name(string_name, options), date_value);
       }     
       // Free up the memory
       free(string_name);        
@@ -1506,9 +3177,9 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       }
 
       // Contains the reg exp
-      char *options = (char *)malloc(options_length * sizeof(char) + 1);
+      char *regexp_options = (char *)malloc(options_length * sizeof(char) + 1);
       // Copy the options from the data to the char *
-      memcpy(options, (data + index), (options_length + 1));      
+      memcpy(regexp_options, (data + index), (options_length + 1));      
       // Adjust the index to skip the option part of the regular expression
       index = index + options_length + 1;      
       // ARRRRGH Google does not expose regular expressions through the v8 api
@@ -1519,23 +3190,24 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
 
       for(int i = 0; i < options_length; i++) {
         // Multiline
-        if(*(options + i) == 'm') {
+        if(*(regexp_options + i) == 'm') {
           flag = flag | 4;
-        } else if(*(options + i) == 'i') {
+        } else if(*(regexp_options + i) == 'i') {
           flag = flag | 2;          
         }
       }
 
       // Add the element to the object
+      Handle<Value> regexp_value = BSON::decode_regexp(reg_exp, length_regexp, flag, options);
       if(is_array_item) {
-        return_array->Set(Number::New(insert_index), RegExp::New(String::New(reg_exp), (v8::RegExp::Flags)flag));
+        return_array->Set(Number::New(insert_index), regexp_value);
       } else {
-        return_data->Set(String::New(string_name), RegExp::New(String::New(reg_exp), (v8::RegExp::Flags)flag));
+        return_data->Set(BSON::field_name(string_name, options), regexp_value);
       }  
       
       // Free memory
       free(reg_exp);          
-      free(options);          
+      free(regexp_options);          
       free(string_name);
     } else if(type == BSON_DATA_OID) {
       // Read the null terminated index String
@@ -1549,28 +3221,16 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
         insert_index = atoi(string_name);
       }      
       
-      // Allocate storage for a 24 character hex oid    
-      char *oid_string = (char *)malloc(12 * 2 * sizeof(char) + 1);
-      char *pbuffer = oid_string;      
-      // Terminate the string
-      *(pbuffer + 24) = '\0';      
-      // Unpack the oid in hex form
-      for(int32_t i = 0; i < 12; i++) {
-        sprintf(pbuffer, "%02x", (unsigned char)*(data + index + i));
-        pbuffer += 2;
-      }      
-
-      // Adjust the index
-      index = index + 12;
-
       // Add the element to the object
       if(is_array_item) {
-        return_array->Set(Number::New(insert_index), BSON::decodeOid(oid_string));
+        return_array->Set(Number::New(insert_index), BSON::decodeOid(data + index));
       } else {
-        return_data->Set(String::New(string_name), BSON::decodeOid(oid_string));
+        return_data->Set(BSON::field_name(string_name, options), BSON::decodeOid(data + index));
       }     
+
+      // Adjust the index
+      index = index + 12;
       // Free memory
-      free(oid_string);                       
       free(string_name);
     } else if(type == BSON_DATA_BINARY) {
       // Read the null terminated index String
@@ -1592,20 +3252,15 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       uint32_t sub_type = (int)*(data + index) & 0xff;
       // Adjust the index
       index = index + 1;
-      // Copy the binary data into a buffer
-      char *buffer = (char *)malloc(number_of_bytes * sizeof(char) + 1);
-      memcpy(buffer, (data + index), number_of_bytes);
-      *(buffer + number_of_bytes) = '\0';
-      // Adjust the index
-      index = index + number_of_bytes;
-      // Add the element to the object
+      // Add the element to the object, the bytes are copied straight out of the data
       if(is_array_item) {
-        return_array->Set(Number::New(insert_index), BSON::decodeBinary(sub_type, number_of_bytes, buffer));
+        return_array->Set(Number::New(insert_index), BSON::decodeBinary(sub_type, number_of_bytes, data + index));
       } else {
-        return_data->Set(String::New(string_name), BSON::decodeBinary(sub_type, number_of_bytes, buffer));
+        return_data->Set(BSON::field_name(string_name, options), BSON::decodeBinary(sub_type, number_of_bytes, data + index));
       }
+      // Adjust the index
+      index = index + number_of_bytes;
       // Free memory
-      free(buffer);                             
       free(string_name);
     } else if(type == BSON_DATA_SYMBOL) {
       // Read the null terminated index String
@@ -1637,7 +3292,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {
         return_array->Set(Number::New(insert_index), symbol_obj);
       } else {
-        return_data->Set(String::New(string_name), symbol_obj);
+        return_data->Set(BSON::field_name(string_name, options), symbol_obj);
       }
       
       // Adjust index
@@ -1661,10 +3316,8 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       uint32_t string_size = BSON::deserialize_int32(data, index);
       // Adjust the index
       index = index + 4;
-      // Read the string
-      char *code = (char *)malloc(string_size * sizeof(char) + 1);
-      // Copy string + terminating 0
-      memcpy(code, (data + index), string_size);
+      // Point to the string
+      char *code = data + index;
 
       // Define empty scope object
       Handle<Value> scope_object = Object::New();
@@ -1672,11 +3325,10 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       // Define the try catch block
       TryCatch try_catch;                
       // Decode the code object
-      Handle<Value> obj = BSON::decodeCode(code, scope_object);
+      Handle<Value> obj = BSON::decodeCode(code, string_size - 1, scope_object);
       // If an error was thrown push it up the chain
       if(try_catch.HasCaught()) {
         free(string_name);
-        free(code);
         // Rethrow exception
         return try_catch.ReThrow();
       }
@@ -1685,10 +3337,11 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {        
         return_array->Set(Number::New(insert_index), obj);
       } else {
-        return_data->Set(String::New(string_name), obj);
+        return_data->Set(BSON::field_name(string_name, options), obj);
       }      
+      // Adjust the index
+      index = index + string_size;
       // Clean up memory allocation
-      free(code);
       free(string_name);
     } else if(type == BSON_DATA_CODE_W_SCOPE) {
       // Read the null terminated index String
@@ -1710,10 +3363,8 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       uint32_t string_size = BSON::deserialize_int32(data, index);
       // Adjust the index
       index = index + 4;
-      // Read the string
-      char *code = (char *)malloc(string_size * sizeof(char) + 1);
-      // Copy string + terminating 0
-      memcpy(code, (data + index), string_size);
+      // Point to the string
+      char *code = data + index;
       // Adjust the index
       index = index + string_size;      
       // Get the scope object (bson object)
@@ -1724,17 +3375,16 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       // Adjust the index
       index = index + bson_object_size;
       // Parse the bson object
-      Handle<Value> scope_object = BSON::deserialize(bson_buffer, false);
+      Handle<Value> scope_object = BSON::deserialize(bson_buffer, false, &nested_options);
       // Define the try catch block
       TryCatch try_catch;                
       // Decode the code object
-      Handle<Value> obj = BSON::decodeCode(code, scope_object);
+      Handle<Value> obj = BSON::decodeCode(code, string_size - 1, scope_object);
       // If an error was thrown push it up the chain
       if(try_catch.HasCaught()) {
         // Clean up memory allocation
         free(string_name);
         free(bson_buffer);
-        free(code);
         // Rethrow exception
         return try_catch.ReThrow();
       }
@@ -1743,10 +3393,9 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {        
         return_array->Set(Number::New(insert_index), obj);
       } else {
-        return_data->Set(String::New(string_name), obj);
+        return_data->Set(BSON::field_name(string_name, options), obj);
       }      
       // Clean up memory allocation
-      free(code);
       free(bson_buffer);      
       free(string_name);
     } else if(type == BSON_DATA_OBJECT) {
@@ -1767,7 +3416,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       // Define the try catch block
       TryCatch try_catch;                
       // Decode the code object
-      Handle<Value> obj = BSON::deserialize(data + index, false);
+      Handle<Value> obj = BSON::deserialize(data + index, false, &nested_options);
       // Adjust the index
       index = index + bson_object_size;
       // If an error was thrown push it up the chain
@@ -1780,7 +3429,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {        
         return_array->Set(Number::New(insert_index), obj);
       } else {
-        return_data->Set(String::New(string_name), obj);
+        return_data->Set(BSON::field_name(string_name, options), obj);
       }
       
       // Clean up memory allocation
@@ -1803,7 +3452,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       TryCatch try_catch;                
 
       // Decode the code object
-      Handle<Value> obj = BSON::deserialize(data + index, true);
+      Handle<Value> obj = BSON::deserialize(data + index, true, &nested_options);
       // If an error was thrown push it up the chain
       if(try_catch.HasCaught()) {
         // Rethrow exception
@@ -1815,7 +3464,7 @@ Handle<Value> BSON::deserialize(char *data, bool is_array_item) {
       if(is_array_item) {        
         return_array->Set(Number::New(insert_index), obj);
       } else {
-        return_data->Set(String::New(string_name), obj);
+        return_data->Set(BSON::field_name(string_name, options), obj);
       }      
       // Clean up memory allocation
       free(string_name);
@@ -1843,76 +3492,57 @@ const char* BSON::ToCString(const v8::String::Utf8Value& value) {
 
 Handle<Value> BSON::decodeDBref(Local<Value> ref, Local<Value> oid, Local<Value> db) {
   HandleScope scope;
-  Local<Value> argv[] = {ref, oid, db};
-  Handle<Value> dbref_obj = DBRef::constructor_template->GetFunction()->NewInstance(3, argv);    
-  return scope.Close(dbref_obj);
+  return scope.Close(DBRef::NewInstance(ref, oid, db));
 }
 
-Handle<Value> BSON::decodeCode(char *code, Handle<Value> scope_object) {
+Handle<Value> BSON::decodeCode(char *code, uint32_t length, Handle<Value> scope_object) {
   HandleScope scope;
-  
-  Local<Value> argv[] = {String::New(code), scope_object->ToObject()};
-  Handle<Value> code_obj = Code::constructor_template->GetFunction()->NewInstance(2, argv);
-  return scope.Close(code_obj);
+  return scope.Close(Code::NewInstance(code, length, scope_object->ToObject()));
 }
 
 Handle<Value> BSON::decodeBinary(uint32_t sub_type, uint32_t number_of_bytes, char *data) {
   HandleScope scope;
-
-  Local<String> str = Encode(data, number_of_bytes, BINARY)->ToString();
-  Local<Value> argv[] = {str, Integer::New(sub_type)};
-  Handle<Value> binary_obj = Binary::constructor_template->GetFunction()->NewInstance(2, argv);
-  return scope.Close(binary_obj);
+  return scope.Close(Binary::NewInstance(sub_type, number_of_bytes, data));
 }
 
 Handle<Value> BSON::decodeOid(char *oid) {
   HandleScope scope;
-  
-  Local<Value> argv[] = {String::New(oid)};
-  Handle<Value> oid_obj = ObjectID::constructor_template->GetFunction()->NewInstance(1, argv);
-  return scope.Close(oid_obj);
+  return scope.Close(ObjectID::NewInstance(oid));
 }
 
 Handle<Value> BSON::decodeLong(char *data, uint32_t index) {
   HandleScope scope;
-  
-  // Decode the integer value
-  int32_t lowBits = 0;
-  int32_t highBits = 0;
-  memcpy(&lowBits, (data + index), 4);        
-  memcpy(&highBits, (data + index + 4), 4);        
-  
+
   // Decode 64bit value
   int64_t value = 0;
-  memcpy(&value, (data + index), 8);        
-  
-  // printf("==================================== %llu\n", value);
-  
-  // if(value >= (-2^53) && value <= (2^53)) {
-  //   printf("----------------------------------------------- 2\n");
-  //   
-  // }
-  
-  // If value is < 2^53 and >-2^53
-  if((highBits < 0x200000 || (highBits == 0x200000 && lowBits == 0)) && highBits >= -0x200000) {
-    // printf("----------------------------------------------- 1\n");
-    int64_t finalValue = 0;
-    memcpy(&finalValue, (data + index), 8);        
-    return scope.Close(Number::New(finalValue));
+  memcpy(&value, (data + index), 8);
+
+  // A Number if it fits in a double without loss
+  if(value >= -BSON_JS_INT_LIMIT && value <= BSON_JS_INT_LIMIT) {
+    return scope.Close(Number::New((double)value));
   }
 
-  // Local<Value> argv[] = {Number::New(value)};
-  Local<Value> argv[] = {Int32::New(lowBits), Int32::New(highBits)};
-  Handle<Value> long_obj = Long::constructor_template->GetFunction()->NewInstance(2, argv);
-  return scope.Close(long_obj);      
+  return scope.Close(Long::NewInstance(value));
 }
 
-Handle<Value> BSON::decodeTimestamp(int64_t value) {
+Handle<Value> BSON::decodeTimestamp(char *data, uint32_t index, bool raw_timestamps) {
   HandleScope scope;
-  
-  Local<Value> argv[] = {Number::New(value)};
-  Handle<Value> timestamp_obj = Timestamp::constructor_template->GetFunction()->NewInstance(1, argv);    
-  return scope.Close(timestamp_obj);      
+
+  // Decode the two 32 bit halves so no precision is lost going through a double
+  uint32_t low_bits = 0;
+  uint32_t high_bits = 0;
+  memcpy(&low_bits, (data + index), 4);
+  memcpy(&high_bits, (data + index + 4), 4);
+
+  // The seconds and the increment in a plain object instead of a wrapped Timestamp
+  if(raw_timestamps) {
+    Local<Object> value = Object::New();
+    value->Set(timestamp_seconds_symbol, Uint32::New(high_bits));
+    value->Set(timestamp_increment_symbol, Uint32::New(low_bits));
+    return scope.Close(value);
+  }
+
+  return scope.Close(Timestamp::NewInstance((int32_t)low_bits, (int32_t)high_bits));
 }
 
 // Search for 0 terminated C string and return the string
@@ -2026,6 +3656,8 @@ extern "C" void init(Handle<Object> target) {
   MinKey::Initialize(target);
   MaxKey::Initialize(target);
   Double::Initialize(target);
+  Matcher::Initialize(target);
+  Merger::Initialize(target);
 }
 
 // NODE_MODULE(bson, BSON::Initialize);
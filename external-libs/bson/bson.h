@@ -8,6 +8,103 @@
 using namespace v8;
 using namespace node;
 
+// A slot of the intern table of short string values, see BSON::intern_string
+struct InternedString {
+  uint32_t length;
+  char data[32];
+  // The decoded string, empty for an unused slot
+  Persistent<String> value;
+};
+
+// Bytes of a large decoded ASCII string kept outside of the V8 heap, the
+// copy is freed when V8 collects the string
+class ExternalString : public String::ExternalAsciiStringResource {
+  public:
+    ExternalString(char *data, size_t length) : data_(data), length_(length) {
+      V8::AdjustAmountOfExternalAllocatedMemory(length);
+    }
+
+    ~ExternalString() {
+      free(data_);
+      V8::AdjustAmountOfExternalAllocatedMemory(-(int)length_);
+    }
+
+    const char *data() const { return data_; }
+    size_t length() const { return length_; }
+
+  private:
+    char *data_;
+    size_t length_;
+};
+
+// An entry of the regular expression cache, see BSON::decode_regexp and BSON::find_regexp
+struct CachedRegExp {
+  // The pattern as read from BSON
+  char *pattern;
+  uint32_t pattern_length;
+  uint32_t hash;
+  int flags;
+  // The UTF-8 bytes of the source written by the serializer, NULL for an unused entry
+  char *source;
+  uint32_t length;
+  uint64_t last_used;
+  Persistent<RegExp> value;
+};
+
+// Options controlling how BSON::deserialize decodes values
+struct DeserializeOptions {
+  // Return timestamps as {t, i} objects of the seconds and the increment instead of Timestamp objects
+  bool raw_timestamps;
+  // Return dates as milliseconds since the epoch instead of Date objects
+  bool raw_dates;
+  // Only decode these top level fields, all fields are decoded if NULL
+  char **fields;
+  uint32_t number_of_fields;
+  // ASCII string values of at least this many bytes are made external strings, 0 to never
+  uint32_t external_string_threshold;
+  // Short string values decoded so far, the same value decodes to the same string, NULL if not interning
+  InternedString *strings;
+  // Field names decoded so far as symbols, NULL to create a new string per field
+  InternedString *names;
+  // Hand out the same RegExp for a repeated pattern and flags from the regular expression cache
+  bool cache_regexps;
+};
+
+// An element of a serialized document, see BSON::read_element
+struct BSONElement {
+  uint8_t type;
+  char *name;
+  uint32_t name_length;
+  // The value bytes and their number
+  char *value;
+  uint32_t size;
+};
+
+// State of BSON::FromJSON, the JSON text read and the BSON written so far
+struct JSONEncoder {
+  const char *json;
+  uint32_t length;
+  uint32_t index;
+  // Output, grown as needed
+  char *data;
+  uint32_t size;
+  uint32_t capacity;
+  // Nesting of the document being written
+  uint32_t depth;
+  bool check_keys;
+};
+
+// State of BSON::ToJSON, the JSON text written so far
+struct JSONWriter {
+  char *data;
+  uint32_t size;
+  uint32_t capacity;
+  // Nesting of the document being written
+  uint32_t depth;
+  // Write canonical instead of relaxed extended JSON
+  bool canonical;
+};
+
 class BSON : public ObjectWrap {
   public:    
     BSON() : ObjectWrap() {}
@@ -16,6 +113,7 @@ class BSON : public ObjectWrap {
     static void Initialize(Handle<Object> target);
     static Handle<Value> BSONSerialize(const Arguments &args);
     static Handle<Value> BSONDeserialize(const Arguments &args);
+    static Handle<Value> BSONDeserializeStream(const Arguments &args);
 
     // Encode functions
     static Handle<Value> EncodeLong(const Arguments &args);
@@ -24,37 +122,95 @@ class BSON : public ObjectWrap {
   
     // Calculate size of function
     static Handle<Value> CalculateObjectSize(const Arguments &args);
+    static Handle<Value> CopyBinaryField(const Arguments &args);
+    static Handle<Value> FromJSON(const Arguments &args);
+    static Handle<Value> ToJSON(const Arguments &args);
+    static Handle<Value> RegExpCacheStats(const Arguments &args);
     static Handle<Value> SerializeWithBufferAndIndex(const Arguments &args);
   
     // Constructor used for creating new BSON objects from C++
     static Persistent<FunctionTemplate> constructor_template;
 
   private:
+    // The matcher and the merger walk and compare the serialized documents with the helpers of the decoder
+    friend class Matcher;
+    friend class Merger;
+
     static Handle<Value> New(const Arguments &args);
-    static Handle<Value> deserialize(char *data, bool is_array_item);
-    static uint32_t serialize(char *serialized_object, uint32_t index, Handle<Value> name, Handle<Value> value, bool check_key, bool serializeFunctions);
+    static Handle<Value> deserialize(char *data, bool is_array_item, DeserializeOptions *options);
+    static void unpack_deserialize_options(Handle<Value> value, DeserializeOptions *options);
+    static void free_deserialize_options(DeserializeOptions *options);
+    static void free_intern_table(InternedString *strings);
+    static bool is_selected_field(char *name, DeserializeOptions *options);
+    static Handle<String> intern_string(char *data, uint32_t length, InternedString *strings, bool symbol);
+    static Handle<String> field_name(char *name, DeserializeOptions *options);
+    static Handle<Value> decode_string(char *data, uint32_t length, DeserializeOptions *options);
+    static Handle<Value> decode_regexp(char *pattern, uint32_t length, int flags, DeserializeOptions *options);
+    static CachedRegExp* find_regexp(Handle<RegExp> regexp);
+    static CachedRegExp* cache_regexp(Handle<RegExp> value, char *pattern, uint32_t pattern_length, uint32_t hash);
+    static uint32_t serialize(char *serialized_object, uint32_t index, Handle<Value> name, Handle<Value> value, bool check_key, bool serializeFunctions, bool long_integers);
 
     static char* extract_string(char *data, uint32_t offset);
+    static int32_t find_field(char *data, uint32_t length, const char *name);
+    static int32_t value_size(char *data, uint32_t index, uint8_t type, uint32_t size);
+    static uint32_t document_size(char *data, uint32_t length);
+    static uint32_t read_element(char *data, uint32_t size, uint32_t index, BSONElement *element);
+    static int canonical_type(uint8_t type);
+    static int compare_values(uint8_t type_a, char *a, uint32_t size_a, uint8_t type_b, char *b, uint32_t size_b);
+    static int compare_strings(char *a, uint32_t size_a, char *b, uint32_t size_b);
+    static int compare_documents(char *a, uint32_t size_a, char *b, uint32_t size_b);
     static const char* ToCString(const v8::String::Utf8Value& value);
     static uint32_t calculate_object_size(Handle<Value> object, bool serializeFunctions);
 
     static void write_int32(char *data, uint32_t value);
     static void write_int64(char *data, int64_t value);
     static void write_double(char *data, double value);
+    static bool is_js_integer(double value);
+
+    // JSON text encoding
+    static void json_error(JSONEncoder *encoder, const char *message);
+    static void json_reserve(JSONEncoder *encoder, uint32_t bytes);
+    static void json_skip_whitespace(JSONEncoder *encoder);
+    static void json_expect_literal(JSONEncoder *encoder, const char *literal);
+    static void json_encode_document(JSONEncoder *encoder, bool is_array);
+    static uint8_t json_encode_value(JSONEncoder *encoder);
+    static uint8_t json_encode_object(JSONEncoder *encoder);
+    static uint8_t json_encode_number(JSONEncoder *encoder);
+    static void json_encode_string(JSONEncoder *encoder, bool cstring);
+    static void json_write_utf8(JSONEncoder *encoder, uint32_t code_point);
+    static bool json_scan_number(JSONEncoder *encoder, double *value);
+    static bool json_encode_oid(JSONEncoder *encoder);
+    static bool json_encode_date(JSONEncoder *encoder);
+    static bool json_encode_number_long(JSONEncoder *encoder);
+    static bool json_encode_number_int(JSONEncoder *encoder);
+    static bool json_encode_number_double(JSONEncoder *encoder);
+    static bool json_match_key(JSONEncoder *encoder, const char *key);
+
+    // JSON text writing
+    static void json_corrupt();
+    static void json_write(JSONWriter *writer, const char *bytes, uint32_t length);
+    static void json_write_document(JSONWriter *writer, char *data, uint32_t length, bool is_array);
+    static void json_write_value(JSONWriter *writer, char *data, uint32_t size, uint8_t type);
+    static void json_write_string(JSONWriter *writer, const char *string, uint32_t length);
+    static void json_write_double(JSONWriter *writer, double value);
+    static void json_write_date(JSONWriter *writer, int64_t value);
+    static void json_write_base64(JSONWriter *writer, const char *bytes, uint32_t length);
+    static uint32_t json_string_length(char *data, uint32_t size);
     static int deserialize_sint8(char *data, uint32_t offset);
     static int deserialize_sint16(char *data, uint32_t offset);
     static long deserialize_sint32(char *data, uint32_t offset);
     static uint16_t deserialize_int8(char *data, uint32_t offset);
     static uint32_t deserialize_int32(char* data, uint32_t offset);
-    static char *check_key(Local<String> key);
+    static void check_key(const char *key, uint32_t length);
+    static uint32_t write_name(char *serialized_object, uint32_t index, Handle<Value> name, bool check_key);
     static char *decode_utf8(char * string, uint32_t length);
         
     // Decode function
     static Handle<Value> decodeLong(char *data, uint32_t index);
-    static Handle<Value> decodeTimestamp(int64_t value);
+    static Handle<Value> decodeTimestamp(char *data, uint32_t index, bool raw_timestamps);
     static Handle<Value> decodeOid(char *oid);
     static Handle<Value> decodeBinary(uint32_t sub_type, uint32_t number_of_bytes, char *data);
-    static Handle<Value> decodeCode(char *code, Handle<Value> scope);
+    static Handle<Value> decodeCode(char *code, uint32_t length, Handle<Value> scope);
     static Handle<Value> decodeDBref(Local<Value> ref, Local<Value> oid, Local<Value> db);
 };
 
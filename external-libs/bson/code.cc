@@ -75,6 +75,21 @@ Handle<Value> Code::New(const Arguments &args) {
   return args.This();    
 }
 
+Handle<Value> Code::NewInstance(char *code, uint32_t length, Handle<Object> scope_object) {
+  HandleScope scope;
+
+  // Copy the code string and add the null termination
+  char *code_data = (char *)malloc(length + 1);
+  memcpy(code_data, code, length);
+  *(code_data + length) = '\0';
+
+  // Instantiate straight from the instance template, skipping the argument parsing in New
+  Local<Object> code_obj = constructor_template->InstanceTemplate()->NewInstance();
+  Code *code_wrap = new Code(code_data, Persistent<Object>::New(scope_object));
+  code_wrap->Wrap(code_obj);
+  return scope.Close(code_obj);
+}
+
 static Persistent<String> code_symbol;
 static Persistent<String> scope_symbol;
 
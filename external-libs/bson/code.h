@@ -30,6 +30,8 @@ class Code : public ObjectWrap {
 
     // Constructor used for creating new Long objects from C++
     static Persistent<FunctionTemplate> constructor_template;
+    // Create a new Code instance with a copy of the code string without going through the JS constructor
+    static Handle<Value> NewInstance(char *code, uint32_t length, Handle<Object> scope_object);
     
     // Setters and Getters for internal properties
     static Handle<Value> CodeGetter(Local<String> property, const AccessorInfo& info);
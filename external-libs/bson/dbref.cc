@@ -69,6 +69,30 @@ Handle<Value> DBRef::New(const Arguments &args) {
   return args.This();
 }
 
+Handle<Value> DBRef::NewInstance(Handle<Value> ref, Handle<Value> oid, Handle<Value> db) {
+  HandleScope scope;
+
+  // Unpack the namespace and the optional db
+  Local<String> ref_str = ref->ToString();
+  char *ref_data = (char *)malloc(ref_str->Length() + 1);
+  node::DecodeWrite(ref_data, ref_str->Length(), ref_str, node::BINARY);
+  *(ref_data + ref_str->Length()) = '\0';
+
+  char *db_data = NULL;
+  if(db->IsString()) {
+    Local<String> db_str = db->ToString();
+    db_data = (char *)malloc(db_str->Length() + 1);
+    node::DecodeWrite(db_data, db_str->Length(), db_str, node::BINARY);
+    *(db_data + db_str->Length()) = '\0';
+  }
+
+  // Instantiate straight from the instance template, skipping the argument parsing in New
+  Local<Object> dbref_obj = constructor_template->InstanceTemplate()->NewInstance();
+  DBRef *dbref = new DBRef(ref_data, Persistent<Value>::New(oid), db_data);
+  dbref->Wrap(dbref_obj);
+  return scope.Close(dbref_obj);
+}
+
 static Persistent<String> namespace_symbol;
 static Persistent<String> oid_symbol;
 static Persistent<String> db_symbol;
@@ -42,6 +42,8 @@ class DBRef : public ObjectWrap {
 
     // Constructor used for creating new Long objects from C++
     static Persistent<FunctionTemplate> constructor_template;
+    // Create a new DBRef instance without going through the JS constructor
+    static Handle<Value> NewInstance(Handle<Value> ref, Handle<Value> oid, Handle<Value> db);
   private:
     static Handle<Value> New(const Arguments &args);
 };
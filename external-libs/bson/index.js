@@ -6,6 +6,8 @@ exports.DBRef = bson.DBRef;
 exports.Code = bson.Code;
 exports.Timestamp = bson.Timestamp;
 exports.Binary = bson.Binary;
+exports.Matcher = bson.Matcher;
+exports.Merger = bson.Merger;
 
 // Just add constants tot he Native BSON parser
 exports.BSON.BSON_BINARY_SUBTYPE_DEFAULT = 0;
@@ -8,43 +8,44 @@
 using namespace v8;
 using namespace node;
 
-class Long : public ObjectWrap {  
+// Enough space for 64 binary digits, a sign and the null termination
+const int32_t LONG_BUFFER_SIZE = 72;
+
+class Long : public ObjectWrap {
   public:
-    int32_t low_bits;
-    int32_t high_bits;
+    int64_t value;
 
-    Long(int32_t low_bits, int32_t high_bits);
+    Long(int64_t value);
     ~Long();
-    
+
     static inline bool HasInstance(Handle<Value> val) {
       if (!val->IsObject()) return false;
       Local<Object> obj = val->ToObject();
       return constructor_template->HasInstance(obj);
-    }    
-        
-    bool isZero();
-    bool isNegative();
-    bool equals(Long *other);
-    Long *div(Long *other);
-    Long *subtract(Long *other);
-    Long *negate();
-    Long *multiply(Long *other);
-    Long *add(Long *other);
-    Long *not_();
-    bool isOdd();
-    bool greaterThanOrEqual(Long *other);
-    bool greaterThan(Long *other);
-    int64_t toNumber();
-    int32_t toInt();
-    int64_t compare(Long *other);
-    int64_t getLowBitsUnsigned();
-	char *toString(int32_t radix, char *buffer);
-    Long *shiftRight(int32_t number_bits);
-    Long *shiftLeft(int32_t number_bits);
+    }
+
+    // Access to the two 32 bit halves of the value
+    inline int32_t lowBits() { return (int32_t)(this->value & 0xFFFFFFFF); }
+    inline int32_t highBits() { return (int32_t)(this->value >> 32); }
 
-    static Long *fromInt(int64_t value);
-    static Long *fromBits(int32_t low_bits, int32_t high_bits);
-    static Long *fromNumber(double value);
+    // Value returning arithmetic (wraps around like the goog.math.Long implementation)
+    static int64_t add(int64_t a, int64_t b);
+    static int64_t subtract(int64_t a, int64_t b);
+    static int64_t multiply(int64_t a, int64_t b);
+    static int64_t div(int64_t a, int64_t b);
+    static int64_t modulo(int64_t a, int64_t b);
+    static int64_t negate(int64_t a);
+    static int64_t shiftLeft(int64_t a, int32_t number_bits);
+    static int64_t shiftRight(int64_t a, int32_t number_bits);
+    static int32_t compare(int64_t a, int64_t b);
+    static char *toString(int64_t value, int32_t radix, char *buffer);
+
+    static int64_t fromBits(int32_t low_bits, int32_t high_bits);
+    static int64_t fromNumber(double value);
+    // Unpack a Long instance or a Number into an int64_t, returns false if neither
+    static bool unpack(Handle<Value> val, int64_t *value);
+    // Create a new Long instance from C++
+    static Handle<Value> NewInstance(int64_t value);
 
     // Getter and Setter for object values
     static Handle<Value> LowGetter(Local<String> property, const AccessorInfo& info);
@@ -52,26 +53,42 @@ class Long : public ObjectWrap {
     static Handle<Value> HighGetter(Local<String> property, const AccessorInfo& info);
     static void HighSetter(Local<String> property, Local<Value> value, const AccessorInfo& info);
     // Functions available from V8
-    static void Initialize(Handle<Object> target);    
+    static void Initialize(Handle<Object> target);
     static Handle<Value> FromNumber(const Arguments &args);
     static Handle<Value> ToString(const Arguments &args);
     static Handle<Value> Inspect(const Arguments &args);
     static Handle<Value> IsZero(const Arguments &args);
+    static Handle<Value> IsNegative(const Arguments &args);
+    static Handle<Value> IsOdd(const Arguments &args);
     static Handle<Value> GetLowBits(const Arguments &args);
     static Handle<Value> GetHighBits(const Arguments &args);
     static Handle<Value> GreatherThan(const Arguments &args);
+    static Handle<Value> GreaterThanOrEqual(const Arguments &args);
+    static Handle<Value> LessThan(const Arguments &args);
+    static Handle<Value> LessThanOrEqual(const Arguments &args);
+    static Handle<Value> Compare(const Arguments &args);
+    static Handle<Value> Add(const Arguments &args);
+    static Handle<Value> Subtract(const Arguments &args);
+    static Handle<Value> Multiply(const Arguments &args);
+    static Handle<Value> Div(const Arguments &args);
+    static Handle<Value> Modulo(const Arguments &args);
+    static Handle<Value> Negate(const Arguments &args);
+    static Handle<Value> ShiftLeft(const Arguments &args);
+    static Handle<Value> ShiftRight(const Arguments &args);
     static Handle<Value> FromInt(const Arguments &args);
+    static Handle<Value> FromBits(const Arguments &args);
     static Handle<Value> FromString(const Arguments &args);
     static Handle<Value> ToInt(const Arguments &args);
     static Handle<Value> ToNumber(const Arguments &args);
     static Handle<Value> ToJSON(const Arguments &args);
     static Handle<Value> Equals(const Arguments &args);
+    static Handle<Value> NotEquals(const Arguments &args);
 
     // Constructor used for creating new Long objects from C++
     static Persistent<FunctionTemplate> constructor_template;
-    
+
   protected:
     static Handle<Value> New(const Arguments &args);
 };
 
-#endif  // LONG_H_
\ No newline at end of file
+#endif  // LONG_H_
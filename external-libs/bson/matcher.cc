@@ -0,0 +1,513 @@
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <v8.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <cstring>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include "bson.h"
+#include "matcher.h"
+
+// BSON types the compiler and the evaluation look at
+const uint8_t BSON_DATA_STRING = 2;
+const uint8_t BSON_DATA_OBJECT = 3;
+const uint8_t BSON_DATA_ARRAY = 4;
+const uint8_t BSON_DATA_BOOLEAN = 8;
+const uint8_t BSON_DATA_NULL = 10;
+const uint8_t BSON_DATA_REGEXP = 11;
+const uint8_t BSON_DATA_SYMBOL = 14;
+const uint8_t BSON_DATA_INT = 16;
+
+// Operators of the conditions
+const uint8_t MATCH_AND = 0;
+const uint8_t MATCH_OR = 1;
+const uint8_t MATCH_EQ = 2;
+const uint8_t MATCH_GT = 3;
+const uint8_t MATCH_GTE = 4;
+const uint8_t MATCH_LT = 5;
+const uint8_t MATCH_LTE = 6;
+const uint8_t MATCH_IN = 7;
+const uint8_t MATCH_EXISTS = 8;
+const uint8_t MATCH_REGEX = 9;
+
+static Handle<Value> VException(const char *msg) {
+    HandleScope scope;
+    return ThrowException(Exception::Error(String::New(msg)));
+  };
+
+Persistent<FunctionTemplate> Matcher::constructor_template;
+
+Matcher::Matcher(char *query) : ObjectWrap() {
+  this->query = query;
+  memset(&this->root, 0, sizeof(MatchCondition));
+  this->root.op = MATCH_AND;
+}
+
+Matcher::~Matcher() {
+  Matcher::free_conditions(&this->root);
+  free(this->query);
+}
+
+Handle<Value> Matcher::New(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() != 1 || !args[0]->IsObject()) {
+    return VException("One argument required - [object] or [buffer]");
+  }
+
+  char *query = NULL;
+  uint32_t length = 0;
+
+  try {
+    if(Buffer::HasInstance(args[0])) {
+      // An already serialized query
+      Local<Object> buffer = args[0]->ToObject();
+      length = Buffer::Length(buffer);
+      query = (char *)malloc(length + 1);
+      memcpy(query, Buffer::Data(buffer), length);
+    } else {
+      length = BSON::calculate_object_size(args[0], false);
+      query = (char *)malloc(length + 1);
+      BSON::serialize(query, 0, Null(), args[0], false, false, false);
+      BSON::write_int32(query, length);
+    }
+  } catch(char *err_msg) {
+    free(query);
+    Handle<Value> error = VException(err_msg);
+    free(err_msg);
+    return error;
+  }
+
+  // Compile the query once, the conditions point into the serialized copy
+  Matcher *matcher = new Matcher(query);
+
+  try {
+    Matcher::compile_document(&matcher->root, query, BSON::document_size(query, length));
+  } catch(char *err_msg) {
+    delete matcher;
+    Handle<Value> error = VException(err_msg);
+    free(err_msg);
+    return error;
+  }
+
+  matcher->Wrap(args.This());
+  return args.This();
+}
+
+void Matcher::Initialize(Handle<Object> target) {
+  // Grab the scope of the call from Node
+  HandleScope scope;
+  // Define a new function template
+  Local<FunctionTemplate> t = FunctionTemplate::New(New);
+  constructor_template = Persistent<FunctionTemplate>::New(t);
+  constructor_template->InstanceTemplate()->SetInternalFieldCount(1);
+  constructor_template->SetClassName(String::NewSymbol("Matcher"));
+
+  // Instance methods
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "test", Test);
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "filter", Filter);
+
+  target->Set(String::NewSymbol("Matcher"), constructor_template->GetFunction());
+}
+
+// Whether the document at index (0 by default) of a buffer matches the query
+Handle<Value> Matcher::Test(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() < 1 || args.Length() > 2 || !Buffer::HasInstance(args[0])) {
+    return VException("One or two arguments required - [buffer] or [buffer, number]");
+  }
+
+  Matcher *matcher = ObjectWrap::Unwrap<Matcher>(args.This());
+  Local<Object> buffer = args[0]->ToObject();
+  uint32_t length = Buffer::Length(buffer);
+  uint32_t index = args.Length() == 2 ? args[1]->Uint32Value() : 0;
+  if(index > length) return VException("Index is outside of the buffer");
+  bool result = false;
+
+  try {
+    result = matcher->matches(Buffer::Data(buffer) + index, length - index);
+  } catch(char *err_msg) {
+    Handle<Value> error = VException(err_msg);
+    free(err_msg);
+    return error;
+  }
+
+  return scope.Close(Boolean::New(result));
+}
+
+// The indexes of the documents matching the query out of numberOfDocuments documents
+// stored back to back in a buffer from index on, like the documents of a reply
+Handle<Value> Matcher::Filter(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() != 3 || !Buffer::HasInstance(args[0]) || !args[1]->IsNumber() || !args[2]->IsNumber()) {
+    return VException("Three arguments required - [buffer, number, number]");
+  }
+
+  Matcher *matcher = ObjectWrap::Unwrap<Matcher>(args.This());
+  Local<Object> buffer = args[0]->ToObject();
+  char *data = Buffer::Data(buffer);
+  uint32_t length = Buffer::Length(buffer);
+  uint32_t index = args[1]->Uint32Value();
+  uint32_t number_of_documents = args[2]->Uint32Value();
+  Local<Array> matches = Array::New();
+  uint32_t number_of_matches = 0;
+
+  try {
+    for(uint32_t i = 0; i < number_of_documents; i++) {
+      if(index > length) BSON::json_corrupt();
+      uint32_t size = BSON::document_size(data + index, length - index);
+      if(matcher->matches(data + index, size)) matches->Set(number_of_matches++, Uint32::New(index));
+      index = index + size;
+    }
+  } catch(char *err_msg) {
+    Handle<Value> error = VException(err_msg);
+    free(err_msg);
+    return error;
+  }
+
+  return scope.Close(matches);
+}
+
+bool Matcher::matches(char *data, uint32_t length) {
+  return Matcher::evaluate(&this->root, data, BSON::document_size(data, length));
+}
+
+// Throw the message for the name of an operator or option the query can't be evaluated with
+void Matcher::error(const char *message, const char *name) {
+  char *error_str = (char *)malloc(strlen(message) + strlen(name) + 1);
+  strcpy(error_str, message);
+  strcat(error_str, name);
+  throw error_str;
+}
+
+// Append an empty condition to the conditions of parent
+MatchCondition* Matcher::add_condition(MatchCondition *parent) {
+  MatchCondition *conditions = (MatchCondition *)realloc(parent->conditions, (parent->number_of_conditions + 1) * sizeof(MatchCondition));
+  if(conditions == NULL) Matcher::error("Out of memory compiling the query", "");
+  parent->conditions = conditions;
+  MatchCondition *condition = conditions + parent->number_of_conditions++;
+  memset(condition, 0, sizeof(MatchCondition));
+  return condition;
+}
+
+void Matcher::free_conditions(MatchCondition *condition) {
+  for(uint32_t i = 0; i < condition->number_of_conditions; i++) {
+    Matcher::free_conditions(condition->conditions + i);
+  }
+
+  free(condition->conditions);
+  if(!condition->regexp.IsEmpty()) condition->regexp.Dispose();
+  if(!condition->test.IsEmpty()) condition->test.Dispose();
+}
+
+// Add the conditions of a query document to parent, all of them have to hold
+void Matcher::compile_document(MatchCondition *parent, char *data, uint32_t size) {
+  uint32_t index = 4;
+
+  while(index < size - 1) {
+    BSONElement element;
+    index = BSON::read_element(data, size, index, &element);
+
+    if(element.name[0] == '$') {
+      bool nor = strcmp(element.name, "$nor") == 0;
+      if(strcmp(element.name, "$and") != 0 && strcmp(element.name, "$or") != 0 && !nor) {
+        Matcher::error("Unsupported query operator ", element.name);
+      }
+      if(element.type != BSON_DATA_ARRAY) Matcher::error("Expected an array of queries for ", element.name);
+
+      // Each document of the array is a clause of its own
+      MatchCondition *condition = Matcher::add_condition(parent);
+      condition->op = strcmp(element.name, "$and") == 0 ? MATCH_AND : MATCH_OR;
+      condition->negate = nor;
+      uint32_t clause_index = 4;
+
+      while(clause_index < element.size - 1) {
+        BSONElement clause;
+        clause_index = BSON::read_element(element.value, element.size, clause_index, &clause);
+        if(clause.type != BSON_DATA_OBJECT) Matcher::error("Expected an array of queries for ", element.name);
+        MatchCondition *clause_condition = Matcher::add_condition(condition);
+        clause_condition->op = MATCH_AND;
+        Matcher::compile_document(clause_condition, clause.value, clause.size);
+      }
+
+      if(condition->number_of_conditions == 0) Matcher::error("Expected a nonempty array of queries for ", element.name);
+    } else if(element.type == BSON_DATA_OBJECT && element.size > 5 && element.value[5] == '$') {
+      // A document of operators, the first name tells it from a document to compare with
+      Matcher::compile_operators(parent, element.name, element.name_length, element.value, element.size);
+    } else if(element.type == BSON_DATA_REGEXP) {
+      MatchCondition *condition = Matcher::add_condition(parent);
+      condition->path = element.name;
+      condition->path_length = element.name_length;
+      uint32_t pattern_length = strlen(element.value);
+      Matcher::compile_regexp(condition, element.value, pattern_length, element.value + pattern_length + 1);
+    } else {
+      MatchCondition *condition = Matcher::add_condition(parent);
+      condition->op = MATCH_EQ;
+      condition->path = element.name;
+      condition->path_length = element.name_length;
+      condition->type = element.type;
+      condition->value = element.value;
+      condition->size = element.size;
+    }
+  }
+}
+
+// Add a condition to parent for each operator of the document of operators on a field
+void Matcher::compile_operators(MatchCondition *parent, char *path, uint32_t path_length, char *data, uint32_t size) {
+  BSONElement regexp, options;
+  regexp.name = NULL;
+  options.name = NULL;
+  uint32_t index = 4;
+
+  while(index < size - 1) {
+    BSONElement element;
+    index = BSON::read_element(data, size, index, &element);
+
+    // The pattern and options of a $regex are compiled together once both are known
+    if(strcmp(element.name, "$regex") == 0) {
+      if(element.type != BSON_DATA_STRING && element.type != BSON_DATA_REGEXP) Matcher::error("Expected a string or regular expression for ", element.name);
+      regexp = element;
+      continue;
+    } else if(strcmp(element.name, "$options") == 0) {
+      if(element.type != BSON_DATA_STRING) Matcher::error("Expected a string for ", element.name);
+      options = element;
+      continue;
+    }
+
+    uint8_t op = MATCH_EQ;
+    bool negate = false;
+    if(strcmp(element.name, "$eq") == 0) op = MATCH_EQ;
+    else if(strcmp(element.name, "$ne") == 0) { op = MATCH_EQ; negate = true; }
+    else if(strcmp(element.name, "$gt") == 0) op = MATCH_GT;
+    else if(strcmp(element.name, "$gte") == 0) op = MATCH_GTE;
+    else if(strcmp(element.name, "$lt") == 0) op = MATCH_LT;
+    else if(strcmp(element.name, "$lte") == 0) op = MATCH_LTE;
+    else if(strcmp(element.name, "$in") == 0) op = MATCH_IN;
+    else if(strcmp(element.name, "$nin") == 0) { op = MATCH_IN; negate = true; }
+    else if(strcmp(element.name, "$exists") == 0) op = MATCH_EXISTS;
+    else Matcher::error("Unsupported query operator ", element.name);
+
+    if(op == MATCH_IN && element.type != BSON_DATA_ARRAY) Matcher::error("Expected an array for ", element.name);
+
+    // {$exists:false} is the negation of {$exists:true}, anything but false, 0 and null is true
+    if(op == MATCH_EXISTS) {
+      char zero[4] = {0, 0, 0, 0};
+      negate = element.type == BSON_DATA_NULL || (element.type == BSON_DATA_BOOLEAN && element.value[0] == 0)
+        || BSON::compare_values(element.type, element.value, element.size, BSON_DATA_INT, zero, 4) == 0;
+    }
+
+    MatchCondition *condition = Matcher::add_condition(parent);
+    condition->op = op;
+    condition->negate = negate;
+    condition->path = path;
+    condition->path_length = path_length;
+    condition->type = element.type;
+    condition->value = element.value;
+    condition->size = element.size;
+  }
+
+  if(regexp.name != NULL) {
+    MatchCondition *condition = Matcher::add_condition(parent);
+    condition->path = path;
+    condition->path_length = path_length;
+
+    if(regexp.type == BSON_DATA_REGEXP) {
+      // $options take the place of the flags of a regular expression
+      uint32_t pattern_length = strlen(regexp.value);
+      Matcher::compile_regexp(condition, regexp.value, pattern_length, options.name != NULL ? options.value + 4 : regexp.value + pattern_length + 1);
+    } else {
+      Matcher::compile_regexp(condition, regexp.value + 4, BSON::json_string_length(regexp.value, regexp.size), options.name != NULL ? options.value + 4 : "");
+    }
+  } else if(options.name != NULL) {
+    Matcher::error("Expected a $regex with ", options.name);
+  }
+}
+
+// Make a condition a $regex test, searching for the pattern in the bytes of the strings if it has no special characters
+void Matcher::compile_regexp(MatchCondition *condition, char *pattern, uint32_t pattern_length, const char *options) {
+  int flags = 0;
+
+  for(const char *option = options; *option != '\0'; option++) {
+    if(*option == 'i') flags = flags | RegExp::kIgnoreCase;
+    else if(*option == 'm') flags = flags | RegExp::kMultiline;
+    else {
+      char name[2] = {*option, '\0'};
+      Matcher::error("Unsupported regular expression option ", name);
+    }
+  }
+
+  condition->op = MATCH_REGEX;
+  condition->anchored = pattern_length > 0 && pattern[0] == '^';
+  condition->pattern = condition->anchored ? pattern + 1 : pattern;
+  condition->pattern_length = condition->anchored ? pattern_length - 1 : pattern_length;
+  // Case folding and ^ matching after line breaks need the regular expression engine
+  condition->literal = (flags & RegExp::kIgnoreCase) == 0 && !(condition->anchored && (flags & RegExp::kMultiline) != 0);
+
+  for(uint32_t i = 0; i < condition->pattern_length && condition->literal; i++) {
+    if(strchr("\\^$.|?*+()[]{}", condition->pattern[i]) != NULL) condition->literal = false;
+  }
+
+  if(condition->literal) return;
+
+  HandleScope scope;
+  TryCatch try_catch;
+  Local<RegExp> regexp = RegExp::New(String::New(pattern, pattern_length), (RegExp::Flags)flags);
+  if(regexp.IsEmpty()) Matcher::error("Invalid regular expression ", pattern);
+  condition->regexp = Persistent<RegExp>::New(regexp);
+  condition->test = Persistent<Function>::New(Local<Function>::Cast(regexp->Get(String::NewSymbol("test"))));
+}
+
+bool Matcher::evaluate(MatchCondition *condition, char *data, uint32_t size) {
+  bool result;
+
+  if(condition->op == MATCH_AND) {
+    result = true;
+    for(uint32_t i = 0; i < condition->number_of_conditions && result; i++) {
+      result = Matcher::evaluate(condition->conditions + i, data, size);
+    }
+  } else if(condition->op == MATCH_OR) {
+    result = false;
+    for(uint32_t i = 0; i < condition->number_of_conditions && !result; i++) {
+      result = Matcher::evaluate(condition->conditions + i, data, size);
+    }
+  } else {
+    result = Matcher::match_path(condition, data, size, condition->path, condition->path_length);
+  }
+
+  return condition->negate ? !result : result;
+}
+
+// Test the field at a dotted path of the document at the start of data. An array on the path
+// matches if one of its embedded documents does, or the element picked by a number in the path
+bool Matcher::match_path(MatchCondition *condition, char *data, uint32_t size, char *path, uint32_t path_length) {
+  uint32_t name_length = 0;
+  while(name_length < path_length && path[name_length] != '.') name_length++;
+
+  // Look the first name of the path up
+  BSONElement element;
+  bool found = false;
+  uint32_t index = 4;
+
+  while(index < size - 1 && !found) {
+    index = BSON::read_element(data, size, index, &element);
+    found = element.name_length == name_length && memcmp(element.name, path, name_length) == 0;
+  }
+
+  if(!found) return Matcher::match_missing(condition);
+  if(name_length == path_length) return Matcher::match_value(condition, &element);
+
+  char *rest = path + name_length + 1;
+  uint32_t rest_length = path_length - name_length - 1;
+  if(element.type == BSON_DATA_OBJECT) return Matcher::match_path(condition, element.value, element.size, rest, rest_length);
+  if(element.type != BSON_DATA_ARRAY) return Matcher::match_missing(condition);
+
+  if(rest_length > 0 && rest[0] >= '0' && rest[0] <= '9') {
+    if(Matcher::match_path(condition, element.value, element.size, rest, rest_length)) return true;
+  }
+
+  bool embedded = false;
+  index = 4;
+
+  while(index < element.size - 1) {
+    BSONElement item;
+    index = BSON::read_element(element.value, element.size, index, &item);
+    if(item.type != BSON_DATA_OBJECT) continue;
+    embedded = true;
+    if(Matcher::match_path(condition, item.value, item.size, rest, rest_length)) return true;
+  }
+
+  return !embedded && Matcher::match_missing(condition);
+}
+
+// Test a field value, an array also matches if one of its elements does
+bool Matcher::match_value(MatchCondition *condition, BSONElement *element) {
+  if(condition->op == MATCH_EXISTS) return true;
+  if(Matcher::match_scalar(condition, element)) return true;
+  if(element->type != BSON_DATA_ARRAY) return false;
+
+  uint32_t index = 4;
+  while(index < element->size - 1) {
+    BSONElement item;
+    index = BSON::read_element(element->value, element->size, index, &item);
+    if(Matcher::match_scalar(condition, &item)) return true;
+  }
+
+  return false;
+}
+
+bool Matcher::match_scalar(MatchCondition *condition, BSONElement *element) {
+  if(condition->op == MATCH_REGEX) {
+    if(element->type != BSON_DATA_STRING && element->type != BSON_DATA_SYMBOL) return false;
+    return Matcher::match_regexp(condition, element->value + 4, BSON::json_string_length(element->value, element->size));
+  }
+
+  if(condition->op == MATCH_IN) {
+    uint32_t index = 4;
+    while(index < condition->size - 1) {
+      BSONElement item;
+      index = BSON::read_element(condition->value, condition->size, index, &item);
+      if(BSON::canonical_type(item.type) == BSON::canonical_type(element->type)
+        && BSON::compare_values(element->type, element->value, element->size, item.type, item.value, item.size) == 0) return true;
+    }
+
+    return false;
+  }
+
+  // Only values sorting with the same types compare, {$gt:5} never matches a string
+  if(BSON::canonical_type(element->type) != BSON::canonical_type(condition->type)) return false;
+  int result = BSON::compare_values(element->type, element->value, element->size, condition->type, condition->value, condition->size);
+
+  switch(condition->op) {
+    case MATCH_EQ:
+      return result == 0;
+    case MATCH_GT:
+      return result > 0;
+    case MATCH_GTE:
+      return result >= 0;
+    case MATCH_LT:
+      return result < 0;
+    default:
+      return result <= 0;
+  }
+}
+
+// A missing field is null to $eq, $gte, $lte and $in
+bool Matcher::match_missing(MatchCondition *condition) {
+  if(condition->op == MATCH_IN) {
+    uint32_t index = 4;
+    while(index < condition->size - 1) {
+      BSONElement item;
+      index = BSON::read_element(condition->value, condition->size, index, &item);
+      if(item.type == BSON_DATA_NULL) return true;
+    }
+
+    return false;
+  }
+
+  return condition->type == BSON_DATA_NULL && (condition->op == MATCH_EQ || condition->op == MATCH_GTE || condition->op == MATCH_LTE);
+}
+
+bool Matcher::match_regexp(MatchCondition *condition, char *string, uint32_t length) {
+  if(condition->literal) {
+    if(condition->pattern_length > length) return false;
+    if(condition->anchored) return memcmp(string, condition->pattern, condition->pattern_length) == 0;
+
+    for(uint32_t i = 0; i + condition->pattern_length <= length; i++) {
+      if(memcmp(string + i, condition->pattern, condition->pattern_length) == 0) return true;
+    }
+
+    return false;
+  }
+
+  // Only strings tested by a regular expression are decoded
+  HandleScope scope;
+  Handle<Value> argv[1] = {Encode(string, length, UTF8)};
+  return condition->test->Call(condition->regexp, 1, argv)->BooleanValue();
+}
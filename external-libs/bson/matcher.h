@@ -0,0 +1,87 @@
+#ifndef MATCHER_H_
+#define MATCHER_H_
+
+#include <node.h>
+#include <node_object_wrap.h>
+#include <v8.h>
+
+#include "bson.h"
+
+using namespace v8;
+using namespace node;
+
+// A test of a compiled query, see Matcher::compile_document
+struct MatchCondition {
+  // One of the MATCH_ operators
+  uint8_t op;
+  // Match where the test fails, for $ne, $nin, $nor and {$exists:false}
+  bool negate;
+  // The dotted path of the field tested, points into the serialized query
+  char *path;
+  uint32_t path_length;
+  // The operand, points into the serialized query
+  uint8_t type;
+  char *value;
+  uint32_t size;
+  // The clauses of $and, $or and $nor or the conditions of a clause
+  struct MatchCondition *conditions;
+  uint32_t number_of_conditions;
+  // A $regex without special characters is searched for in the bytes, anchored if it starts with ^
+  bool literal;
+  bool anchored;
+  char *pattern;
+  uint32_t pattern_length;
+  // Any other $regex is run on the string decoded from the document
+  Persistent<RegExp> regexp;
+  Persistent<Function> test;
+};
+
+class Matcher : public ObjectWrap {
+  public:
+    // The serialized query the conditions point into
+    char *query;
+    // All the conditions of the query have to hold
+    MatchCondition root;
+
+    Matcher(char *query);
+    ~Matcher();
+
+    // Has instance check
+    static inline bool HasInstance(Handle<Value> val) {
+      if (!val->IsObject()) return false;
+      Local<Object> obj = val->ToObject();
+      return constructor_template->HasInstance(obj);
+    }
+
+    // Evaluate the query on the document at the start of data, length is the number of bytes available
+    bool matches(char *data, uint32_t length);
+
+    // Functions available from V8
+    static void Initialize(Handle<Object> target);
+    static Handle<Value> Test(const Arguments &args);
+    static Handle<Value> Filter(const Arguments &args);
+
+    // Constructor used for creating new Matcher objects from C++
+    static Persistent<FunctionTemplate> constructor_template;
+
+  private:
+    static Handle<Value> New(const Arguments &args);
+
+    // Compiling
+    static MatchCondition* add_condition(MatchCondition *parent);
+    static void free_conditions(MatchCondition *condition);
+    static void compile_document(MatchCondition *parent, char *data, uint32_t size);
+    static void compile_operators(MatchCondition *parent, char *path, uint32_t path_length, char *data, uint32_t size);
+    static void compile_regexp(MatchCondition *condition, char *pattern, uint32_t pattern_length, const char *options);
+    static void error(const char *message, const char *name);
+
+    // Evaluating
+    static bool evaluate(MatchCondition *condition, char *data, uint32_t size);
+    static bool match_path(MatchCondition *condition, char *data, uint32_t size, char *path, uint32_t path_length);
+    static bool match_value(MatchCondition *condition, BSONElement *element);
+    static bool match_scalar(MatchCondition *condition, BSONElement *element);
+    static bool match_missing(MatchCondition *condition);
+    static bool match_regexp(MatchCondition *condition, char *string, uint32_t length);
+};
+
+#endif  // MATCHER_H_
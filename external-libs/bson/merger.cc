@@ -0,0 +1,368 @@
+#include <assert.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <v8.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <cstring>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include "bson.h"
+#include "merger.h"
+
+// BSON types the sort keys are picked from
+const uint8_t BSON_DATA_OBJECT = 3;
+const uint8_t BSON_DATA_ARRAY = 4;
+const uint8_t BSON_DATA_NULL = 10;
+
+static Handle<Value> VException(const char *msg) {
+    HandleScope scope;
+    return ThrowException(Exception::Error(String::New(msg)));
+  };
+
+// The key of a document missing a field of the sort
+static BSONElement null_key = {BSON_DATA_NULL, NULL, 0, NULL, 0};
+// The key of an empty array, no type has its rank so it sorts after MinKey and before null like on the server
+static BSONElement empty_array_key = {0, NULL, 0, NULL, 0};
+
+Persistent<FunctionTemplate> Merger::constructor_template;
+
+Merger::Merger() : ObjectWrap() {
+  this->fields = NULL;
+  this->number_of_fields = 0;
+  this->keys = NULL;
+}
+
+Merger::~Merger() {
+  for(uint32_t i = 0; i < this->number_of_fields; i++) {
+    free(this->fields[i].path);
+  }
+
+  free(this->fields);
+  free(this->keys);
+}
+
+// Compile a sort in any of the forms Cursor#sort takes, a field name, an array of field names
+// and [name, direction] pairs or an object of directions by name. Without a sort the whole
+// documents are compared
+Handle<Value> Merger::New(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() > 1) {
+    return VException("Zero or one argument required - [] or [string] or [array] or [object]");
+  }
+
+  Merger *merger = new Merger();
+
+  try {
+    if(args.Length() == 0 || args[0]->IsNull() || args[0]->IsUndefined()) {
+      // Whole documents
+    } else if(args[0]->IsString()) {
+      merger->add_field(args[0], Integer::New(1));
+    } else if(args[0]->IsArray()) {
+      Local<Array> sort = Local<Array>::Cast(args[0]);
+
+      for(uint32_t i = 0; i < sort->Length(); i++) {
+        Local<Value> field = sort->Get(i);
+
+        if(field->IsString()) {
+          merger->add_field(field, Integer::New(1));
+        } else if(field->IsArray()) {
+          merger->add_field(field->ToObject()->Get(0), field->ToObject()->Get(1));
+        } else {
+          Merger::error("Illegal sort clause, must be of the form [['field1', '(ascending|descending)'], ['field2', '(ascending|descending)']]");
+        }
+      }
+    } else if(args[0]->IsObject() && !Buffer::HasInstance(args[0])) {
+      Local<Object> sort = args[0]->ToObject();
+      Local<Array> names = sort->GetPropertyNames();
+
+      for(uint32_t i = 0; i < names->Length(); i++) {
+        merger->add_field(names->Get(i), sort->Get(names->Get(i)));
+      }
+    } else {
+      Merger::error("Illegal sort clause, must be of the form [['field1', '(ascending|descending)'], ['field2', '(ascending|descending)']]");
+    }
+
+    merger->keys = (BSONElement *)malloc((2 * merger->number_of_fields + 1) * sizeof(BSONElement));
+  } catch(char *err_msg) {
+    delete merger;
+    Handle<Value> error = VException(err_msg);
+    free(err_msg);
+    return error;
+  }
+
+  merger->Wrap(args.This());
+  return args.This();
+}
+
+void Merger::Initialize(Handle<Object> target) {
+  // Grab the scope of the call from Node
+  HandleScope scope;
+  // Define a new function template
+  Local<FunctionTemplate> t = FunctionTemplate::New(New);
+  constructor_template = Persistent<FunctionTemplate>::New(t);
+  constructor_template->InstanceTemplate()->SetInternalFieldCount(1);
+  constructor_template->SetClassName(String::NewSymbol("Merger"));
+
+  // Instance methods
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "compare", Compare);
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "merge", Merge);
+
+  target->Set(String::NewSymbol("Merger"), constructor_template->GetFunction());
+}
+
+// -1, 0 or 1 as the first of two serialized documents sorts before, with or after the second
+Handle<Value> Merger::Compare(const Arguments &args) {
+  HandleScope scope;
+
+  if(args.Length() != 2 || !Buffer::HasInstance(args[0]) || !Buffer::HasInstance(args[1])) {
+    return VException("Two arguments required - [buffer, buffer]");
+  }
+
+  Merger *merger = ObjectWrap::Unwrap<Merger>(args.This());
+  Local<Object> a = args[0]->ToObject();
+  Local<Object> b = args[1]->ToObject();
+  int result = 0;
+
+  try {
+    result = merger->compare(Buffer::Data(a), Buffer::Length(a), Buffer::Data(b), Buffer::Length(b));
+  } catch(char *err_msg) {
+    Handle<Value> error = VException(err_msg);
+    free(err_msg);
+    return error;
+  }
+
+  return scope.Close(Integer::New(result));
+}
+
+// Merge arrays of serialized documents, each sorted by the sort, into one array of the same Buffers
+// in sorted order. Documents sorting together keep the order of their streams. Arguments are
+// (arrayOfArraysOfBuffers, [limit]), a limit of 0 merges every document
+Handle<Value> Merger::Merge(const Arguments &args) {
+  HandleScope scope;
+
+  // A null or undefined limit is no limit, like leaving it out
+  if(args.Length() < 1 || args.Length() > 2 || !args[0]->IsArray()
+    || (args.Length() == 2 && !args[1]->IsNumber() && !args[1]->IsNull() && !args[1]->IsUndefined())) {
+    return VException("One or two arguments required - [array] or [array, number]");
+  }
+
+  Merger *merger = ObjectWrap::Unwrap<Merger>(args.This());
+  Local<Array> streams = Local<Array>::Cast(args[0]);
+  uint32_t number_of_streams = streams->Length();
+  uint32_t limit = args.Length() == 2 && args[1]->IsNumber() ? args[1]->Uint32Value() : 0;
+  if(limit == 0) limit = std::numeric_limits<uint32_t>::max();
+  Local<Array> merged = Array::New();
+  uint32_t number_merged = 0;
+
+  // A head per stream in a binary heap of the streams left, the smallest document on top
+  MergeHead *heads = (MergeHead *)malloc((number_of_streams + 1) * sizeof(MergeHead));
+  MergeHead **heap = (MergeHead **)malloc((number_of_streams + 1) * sizeof(MergeHead *));
+  BSONElement *keys = (BSONElement *)malloc((number_of_streams * merger->number_of_fields + 1) * sizeof(BSONElement));
+  uint32_t heap_size = 0;
+
+  try {
+    for(uint32_t i = 0; i < number_of_streams; i++) {
+      // Release the handles of each stream and document as we go
+      HandleScope iteration_scope;
+      Local<Value> stream = streams->Get(i);
+      if(!stream->IsArray()) Merger::error("Expected an array of documents for each stream");
+
+      MergeHead *head = heads + i;
+      head->stream = i;
+      head->position = 0;
+      head->length = Local<Array>::Cast(stream)->Length();
+      head->keys = keys + i * merger->number_of_fields;
+      if(merger->load(head, Local<Array>::Cast(stream))) heap[heap_size++] = head;
+    }
+
+    for(uint32_t i = heap_size / 2; i > 0; i--) {
+      merger->sift_down(heap, heap_size, i - 1);
+    }
+
+    while(heap_size > 0 && number_merged < limit) {
+      HandleScope iteration_scope;
+      MergeHead *head = heap[0];
+      Local<Array> stream = Local<Array>::Cast(streams->Get(head->stream));
+      merged->Set(number_merged++, stream->Get(head->position));
+
+      // Move on in the stream, dropping it once it runs out
+      head->position = head->position + 1;
+      if(!merger->load(head, stream)) heap[0] = heap[--heap_size];
+      merger->sift_down(heap, heap_size, 0);
+    }
+  } catch(char *err_msg) {
+    free(heads);
+    free(heap);
+    free(keys);
+    Handle<Value> error = VException(err_msg);
+    free(err_msg);
+    return error;
+  }
+
+  free(heads);
+  free(heap);
+  free(keys);
+  return scope.Close(merged);
+}
+
+int Merger::compare(char *a, uint32_t size_a, char *b, uint32_t size_b) {
+  size_a = BSON::document_size(a, size_a);
+  size_b = BSON::document_size(b, size_b);
+  if(this->number_of_fields == 0) return BSON::compare_documents(a, size_a, b, size_b);
+
+  this->find_keys(a, size_a, this->keys);
+  this->find_keys(b, size_b, this->keys + this->number_of_fields);
+  return this->compare_keys(this->keys, this->keys + this->number_of_fields);
+}
+
+void Merger::error(const char *message) {
+  char *error_str = (char *)malloc(strlen(message) + 1);
+  strcpy(error_str, message);
+  throw error_str;
+}
+
+// Append a field of the sort, the direction takes the values Cursor#formatSortValue does
+void Merger::add_field(Handle<Value> name, Handle<Value> direction) {
+  String::Utf8Value direction_str(direction->ToString());
+  int value = 0;
+
+  if(strcasecmp(*direction_str, "ascending") == 0 || strcasecmp(*direction_str, "asc") == 0 || direction->NumberValue() == 1) {
+    value = 1;
+  } else if(strcasecmp(*direction_str, "descending") == 0 || strcasecmp(*direction_str, "desc") == 0 || direction->NumberValue() == -1) {
+    value = -1;
+  } else {
+    Merger::error("Illegal sort clause, must be of the form [['field1', '(ascending|descending)'], ['field2', '(ascending|descending)']]");
+  }
+
+  SortField *fields = (SortField *)realloc(this->fields, (this->number_of_fields + 1) * sizeof(SortField));
+  if(fields == NULL) Merger::error("Out of memory compiling the sort");
+  this->fields = fields;
+
+  String::Utf8Value name_str(name->ToString());
+  SortField *field = fields + this->number_of_fields++;
+  field->path_length = name_str.length();
+  field->path = (char *)malloc(field->path_length + 1);
+  memcpy(field->path, *name_str, field->path_length + 1);
+  field->direction = value;
+}
+
+// Pick the sort key of the document at the start of data, one element per field
+void Merger::find_keys(char *data, uint32_t size, BSONElement *keys) {
+  for(uint32_t i = 0; i < this->number_of_fields; i++) {
+    SortField *field = this->fields + i;
+    bool found = false;
+    Merger::find_key(field, data, size, field->path, field->path_length, keys + i, &found);
+    if(!found) keys[i] = null_key;
+  }
+}
+
+// Offer the values at a dotted path of the document at the start of data as the key of a field.
+// The elements of an array are offered one by one, as are the fields of the documents embedded
+// in an array on the path unless it's followed by a number picking one of the elements. A
+// missing field is null, an empty array sorts before it
+void Merger::find_key(SortField *field, char *data, uint32_t size, char *path, uint32_t path_length, BSONElement *key, bool *found) {
+  uint32_t name_length = 0;
+  while(name_length < path_length && path[name_length] != '.') name_length++;
+
+  // Look the first name of the path up
+  BSONElement element;
+  bool present = false;
+  uint32_t index = 4;
+
+  while(index < size - 1 && !present) {
+    index = BSON::read_element(data, size, index, &element);
+    present = element.name_length == name_length && memcmp(element.name, path, name_length) == 0;
+  }
+
+  if(!present) return Merger::offer_key(field, &null_key, key, found);
+
+  if(name_length == path_length) {
+    if(element.type != BSON_DATA_ARRAY) return Merger::offer_key(field, &element, key, found);
+    if(element.size <= 5) return Merger::offer_key(field, &empty_array_key, key, found);
+    index = 4;
+
+    while(index < element.size - 1) {
+      BSONElement item;
+      index = BSON::read_element(element.value, element.size, index, &item);
+      Merger::offer_key(field, &item, key, found);
+    }
+
+    return;
+  }
+
+  char *rest = path + name_length + 1;
+  uint32_t rest_length = path_length - name_length - 1;
+  if(element.type == BSON_DATA_OBJECT) return Merger::find_key(field, element.value, element.size, rest, rest_length, key, found);
+  if(element.type != BSON_DATA_ARRAY) return Merger::offer_key(field, &null_key, key, found);
+  if(rest_length > 0 && rest[0] >= '0' && rest[0] <= '9') return Merger::find_key(field, element.value, element.size, rest, rest_length, key, found);
+
+  bool embedded = false;
+  index = 4;
+
+  while(index < element.size - 1) {
+    BSONElement item;
+    index = BSON::read_element(element.value, element.size, index, &item);
+    if(item.type != BSON_DATA_OBJECT) continue;
+    embedded = true;
+    Merger::find_key(field, item.value, item.size, rest, rest_length, key, found);
+  }
+
+  if(!embedded) Merger::offer_key(field, &null_key, key, found);
+}
+
+// Keep the smallest value offered for an ascending field and the largest for a descending one
+void Merger::offer_key(SortField *field, BSONElement *candidate, BSONElement *key, bool *found) {
+  if(*found && BSON::compare_values(candidate->type, candidate->value, candidate->size, key->type, key->value, key->size) * field->direction >= 0) return;
+  *key = *candidate;
+  *found = true;
+}
+
+int Merger::compare_keys(BSONElement *keys_a, BSONElement *keys_b) {
+  for(uint32_t i = 0; i < this->number_of_fields; i++) {
+    int result = BSON::compare_values(keys_a[i].type, keys_a[i].value, keys_a[i].size, keys_b[i].type, keys_b[i].value, keys_b[i].size);
+    if(result != 0) return result * this->fields[i].direction;
+  }
+
+  return 0;
+}
+
+// Order the heads by their documents, then by their streams
+int Merger::compare_heads(MergeHead *a, MergeHead *b) {
+  int result = this->number_of_fields == 0
+    ? BSON::compare_documents(a->data, a->size, b->data, b->size)
+    : this->compare_keys(a->keys, b->keys);
+  if(result != 0) return result;
+  return a->stream < b->stream ? -1 : (a->stream > b->stream ? 1 : 0);
+}
+
+// Read the document at the position of the head in its stream, returns false at the end of the stream
+bool Merger::load(MergeHead *head, Local<Array> stream) {
+  if(head->position >= head->length) return false;
+
+  Local<Value> document = stream->Get(head->position);
+  if(!Buffer::HasInstance(document)) Merger::error("Expected a buffer for each document");
+  head->data = Buffer::Data(document->ToObject());
+  head->size = BSON::document_size(head->data, Buffer::Length(document->ToObject()));
+  if(this->number_of_fields > 0) this->find_keys(head->data, head->size, head->keys);
+  return true;
+}
+
+// Move the head at index down the heap until the heads below it sort after it
+void Merger::sift_down(MergeHead **heap, uint32_t size, uint32_t index) {
+  while(2 * index + 1 < size) {
+    uint32_t child = 2 * index + 1;
+    if(child + 1 < size && this->compare_heads(heap[child + 1], heap[child]) < 0) child = child + 1;
+    if(this->compare_heads(heap[index], heap[child]) <= 0) return;
+
+    MergeHead *head = heap[index];
+    heap[index] = heap[child];
+    heap[child] = head;
+    index = child;
+  }
+}
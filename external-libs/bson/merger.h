@@ -0,0 +1,82 @@
+#ifndef MERGER_H_
+#define MERGER_H_
+
+#include <node.h>
+#include <node_object_wrap.h>
+#include <v8.h>
+
+#include "bson.h"
+
+using namespace v8;
+using namespace node;
+
+// A field of a sort, see Merger::add_field
+struct SortField {
+  // The dotted path of the field
+  char *path;
+  uint32_t path_length;
+  // 1 for ascending, -1 for descending
+  int direction;
+};
+
+// The next document of one of the sorted streams being merged
+struct MergeHead {
+  // The stream and the position of the document in it
+  uint32_t stream;
+  uint32_t position;
+  uint32_t length;
+  // The document and its sort key, one element per field of the sort
+  char *data;
+  uint32_t size;
+  BSONElement *keys;
+};
+
+class Merger : public ObjectWrap {
+  public:
+    // The fields of the sort, none compares whole documents
+    SortField *fields;
+    uint32_t number_of_fields;
+    // Room for the keys of the two documents compared by Merger::compare
+    BSONElement *keys;
+
+    Merger();
+    ~Merger();
+
+    // Has instance check
+    static inline bool HasInstance(Handle<Value> val) {
+      if (!val->IsObject()) return false;
+      Local<Object> obj = val->ToObject();
+      return constructor_template->HasInstance(obj);
+    }
+
+    // Compare the documents at the start of a and b by the sort, the sizes are the number of bytes available
+    int compare(char *a, uint32_t size_a, char *b, uint32_t size_b);
+
+    // Functions available from V8
+    static void Initialize(Handle<Object> target);
+    static Handle<Value> Compare(const Arguments &args);
+    static Handle<Value> Merge(const Arguments &args);
+
+    // Constructor used for creating new Merger objects from C++
+    static Persistent<FunctionTemplate> constructor_template;
+
+  private:
+    static Handle<Value> New(const Arguments &args);
+
+    // Compiling
+    void add_field(Handle<Value> name, Handle<Value> direction);
+    static void error(const char *message);
+
+    // Sort keys
+    void find_keys(char *data, uint32_t size, BSONElement *keys);
+    static void find_key(SortField *field, char *data, uint32_t size, char *path, uint32_t path_length, BSONElement *key, bool *found);
+    static void offer_key(SortField *field, BSONElement *candidate, BSONElement *key, bool *found);
+
+    // Merging
+    int compare_keys(BSONElement *keys_a, BSONElement *keys_b);
+    int compare_heads(MergeHead *a, MergeHead *b);
+    bool load(MergeHead *head, Local<Array> stream);
+    void sift_down(MergeHead **heap, uint32_t size, uint32_t index);
+};
+
+#endif  // MERGER_H_
@@ -19,7 +19,9 @@ static Handle<Value> VException(const char *msg) {
 
 Persistent<FunctionTemplate> ObjectID::constructor_template;
 
-ObjectID::ObjectID(char *o) : ObjectWrap() {
+static const char *hex_digits = "0123456789abcdef";
+
+ObjectID::ObjectID(const char *o) : ObjectWrap() {
     memcpy(this->oid, o, OBJECTID_SIZE);
 }
 
@@ -31,12 +33,11 @@ char *ObjectID::uint32_to_char(uint32_t value, char *buf) {
   *(buf + 1) = (char)((value >> 8) & 0xff);
   *(buf + 2) = (char)((value >> 16) & 0xff);
   *(buf + 3) = (char)((value >> 24) & 0xff);
-  *(buf + 4) = '\0';
   return buf;
 }
 
-// Generates a new oid
-char *ObjectID::oid_id_generator(char *oid_string) {
+// Generates the 12 bytes of a new oid
+char *ObjectID::oid_id_generator(char *oid) {
   // Blatant copy of the code from mongodb-c driver
   static int incr = 0;
   int fuzz = 0;
@@ -50,89 +51,100 @@ char *ObjectID::oid_id_generator(char *oid_string) {
     fuzz = rand();
   }
   
-  // Build a 12 byte char string based on the address of the current object, the rand number and the current time
-  char oid_string_c[12 * sizeof(char) + 1];
-  
-  *(oid_string_c + 12) = '\0';
-  
-  ObjectID::uint32_to_char(t,oid_string_c);
-  ObjectID::uint32_to_char(fuzz,oid_string_c + 4);
-  ObjectID::uint32_to_char(i,oid_string_c + 8);
-
-  // Allocate storage for a 24 character hex oid    
-  char *pbuffer = oid_string;
-  // Terminate the string
-  *(pbuffer + 24) = '\0';      
-  // Unpack the oid in hex form
-  for(int32_t i = 0; i < 12; i++) {
-    sprintf(pbuffer, "%02x", (unsigned char)*(oid_string_c + i));
-    pbuffer += 2;
-  }        
-  
-  return oid_string;
+  // Build a 12 byte oid based on the the rand number, the current time and the counter
+  ObjectID::uint32_to_char(t, oid);
+  ObjectID::uint32_to_char(fuzz, oid + 4);
+  ObjectID::uint32_to_char(i, oid + 8);
+  return oid;
+}
+
+// Convert 24 hex characters into 12 bytes, returns false on an invalid character
+bool ObjectID::hex_to_bin(const char *hex, char *buffer) {
+  for(int32_t i = 0; i < 24; i++) {
+    char c = *(hex + i);
+    uint8_t value;
+
+    if(c >= '0' && c <= '9') {
+      value = c - '0';
+    } else if(c >= 'a' && c <= 'f') {
+      value = c - 'a' + 10;
+    } else if(c >= 'A' && c <= 'F') {
+      value = c - 'A' + 10;
+    } else {
+      return false;
+    }
+
+    if(i % 2 == 0) {
+      *(buffer + i/2) = (char)(value << 4);
+    } else {
+      *(buffer + i/2) |= (char)value;
+    }
+  }
+
+  return true;
+}
+
+// Write the oid as 24 hex characters plus the null termination into buffer
+char *ObjectID::toHexString(char *buffer) {
+  for(int32_t i = 0; i < OBJECTID_SIZE; i++) {
+    uint8_t value = (uint8_t)*(this->oid + i);
+    *(buffer + i*2) = hex_digits[value >> 4];
+    *(buffer + i*2 + 1) = hex_digits[value & 0x0f];
+  }
+
+  *(buffer + 24) = '\0';
+  return buffer;
 }
 
 Handle<Value> ObjectID::New(const Arguments &args) {
   HandleScope scope;
+  // Contains the final oid bytes
+  char oid_bytes[OBJECTID_SIZE];
   
-  // If no arguments are passed in we generate a new ID automagically
-  if(args.Length() == 0) {
-    // Instantiate a ObjectID object
-    char oid_string[OBJECTID_SIZE];
-    ObjectID::oid_id_generator(oid_string);
-    ObjectID *oid = new ObjectID(oid_string);
-    
-    // Wrap it
-    oid->Wrap(args.This());
-    // Return the object
-    return args.This();        
+  // If no arguments or null is passed in we generate a new ID automagically
+  if(args.Length() == 0 || (args.Length() == 1 && args[0]->IsNull())) {
+    ObjectID::oid_id_generator(oid_bytes);
   } else {
     // Ensure we have correct parameters passed in
-    if(args.Length() != 1 && (!args[0]->IsString() || !args[0]->IsNull())) {
+    if(args.Length() != 1) {
       return VException("Argument passed in must be a single String of 12 bytes or a string of 24 hex characters in hex format");
     }
 
-    // Contains the final oid string
-    char oid_string_c[OBJECTID_SIZE];    
+    // Convert the argument to a String
+    Local<String> oid_string = args[0]->ToString();  
+    if(oid_string->Length() != 12 && oid_string->Length() != 24) {
+      return VException("Argument passed in must be a single String of 12 bytes or a string of 24 hex characters in hex format");
+    }
 
-    // If we have a null generate a new oid
-    if(args[0]->IsNull()) {
-      ObjectID::oid_id_generator(oid_string_c);
+    if(oid_string->Length() == 12) {            
+      // Decode the 12 bytes of the oid
+      node::DecodeWrite(oid_bytes, OBJECTID_SIZE, oid_string, node::BINARY);    
     } else {
-      *(oid_string_c + 24) = '\0';      
-      
-      // Convert the argument to a String
-      Local<String> oid_string = args[0]->ToString();  
-      if(oid_string->Length() != 12 && oid_string->Length() != 24) {
+      // Decode the hex characters and convert them
+      char oid_hex[OBJECTID_HEX_SIZE];
+      node::DecodeWrite(oid_hex, 24, oid_string, node::BINARY);        
+      if(!ObjectID::hex_to_bin(oid_hex, oid_bytes)) {
         return VException("Argument passed in must be a single String of 12 bytes or a string of 24 hex characters in hex format");
       }
-  
-      if(oid_string->Length() == 12) {            
-        // Contains the bytes for the string
-        char oid_string_bytes[13];
-        // Decode the 12 bytes of the oid
-        node::DecodeWrite(oid_string_bytes, 13, oid_string, node::BINARY);    
-        // Unpack the String object to char*
-        char *pbuffer = oid_string_c;      
-        // Unpack the oid in hex form
-        for(int32_t i = 0; i < 12; i++) {
-          sprintf(pbuffer, "%02x", (unsigned char)*(oid_string_bytes + i));
-          pbuffer += 2;
-        } 
-      } else {
-        // Decode the content
-        node::DecodeWrite(oid_string_c, 25, oid_string, node::BINARY);        
-      }      
-    }
-  
-    // Instantiate a ObjectID object
-    ObjectID *oid = new ObjectID(oid_string_c);
-
-    // Wrap it
-    oid->Wrap(args.This());
-    // Return the object
-    return args.This();    
-  }  
+    }      
+  }
+
+  // Instantiate a ObjectID object
+  ObjectID *oid = new ObjectID(oid_bytes);
+  // Wrap it
+  oid->Wrap(args.This());
+  // Return the object
+  return args.This();    
+}
+
+Handle<Value> ObjectID::NewInstance(const char *oid) {
+  HandleScope scope;
+
+  // Instantiate straight from the instance template, skipping the argument parsing in New
+  Local<Object> oid_obj = constructor_template->InstanceTemplate()->NewInstance();
+  ObjectID *object_id = new ObjectID(oid);
+  object_id->Wrap(oid_obj);
+  return scope.Close(oid_obj);
 }
 
 static Persistent<String> id_symbol;
@@ -187,14 +199,10 @@ Handle<Value> ObjectID::Equals(const Arguments &args) {
 Handle<Value> ObjectID::CreatePk(const Arguments &args) {
   HandleScope scope;
   
-  char oid_string[OBJECTID_SIZE];
-  ObjectID::oid_id_generator(oid_string);
-  // Return the value  
-  Local<Value> argv[] = {String::New(oid_string)};
-  Handle<Value> object_id_obj = ObjectID::constructor_template->GetFunction()->NewInstance(1, argv);    
-
+  char oid_bytes[OBJECTID_SIZE];
+  ObjectID::oid_id_generator(oid_bytes);
   // Return the close object
-  return scope.Close(object_id_obj);
+  return scope.Close(ObjectID::NewInstance(oid_bytes));
 }
 
 Handle<Value> ObjectID::IdGetter(Local<String> property, const AccessorInfo& info) {
@@ -202,49 +210,14 @@ Handle<Value> ObjectID::IdGetter(Local<String> property, const AccessorInfo& inf
   
   // Unpack the long object
   ObjectID *objectid_obj = ObjectWrap::Unwrap<ObjectID>(info.Holder());
-  // Convert the hex oid to bin
-  char *binary_oid = objectid_obj->convert_hex_oid_to_bin();
   // Create string and return it
-  Local<String> final_str = Encode(binary_oid, 12, BINARY)->ToString();
-  // Free the memory for binary_oid
-  free(binary_oid);
+  Local<String> final_str = Encode(objectid_obj->oid, OBJECTID_SIZE, BINARY)->ToString();
   // Close the scope
   return scope.Close(final_str);
 }
 
 bool ObjectID::equals(ObjectID *object_id) {
-  char *current_id = this->oid;
-  char *compare_id = object_id->oid;
-  
-  for(uint32_t i = 0; i < 24; i++) {
-    if(*(current_id + i) != *(compare_id + i)) {
-      return false;
-    }
-  }
-  
-  return true;
-}
-
-char *ObjectID::convert_hex_oid_to_bin() {
-  // Turn the oid into the binary equivalent
-  char *binary_oid = (char *)malloc(12 * sizeof(char) + 1);
-  *(binary_oid + 12) = '\0';
-  char *nval_str = (char *)malloc(3);
-  *(nval_str + 2) = '\0';  
-  uint32_t x1;
-
-  // Let's convert the hex value to binary
-  for(uint32_t i = 0; i < 12; i++) {
-    nval_str[0] = *(this->oid + (i*2));
-    nval_str[1] = *(this->oid + (i*2) + 1);    
-    sscanf(nval_str, "%x", &x1);
-    *(binary_oid + i) = (char)(x1);
-  }
-
-  // release the memory for the n_val_str
-  free(nval_str);
-  // Return the pointer to the converted string
-  return binary_oid;
+  return memcmp(this->oid, object_id->oid, OBJECTID_SIZE) == 0;
 }
 
 void ObjectID::IdSetter(Local<String> property, Local<Value> value, const AccessorInfo& info) {
@@ -274,8 +247,9 @@ Handle<Value> ObjectID::ToString(const Arguments &args) {
 
   // Unpack the ObjectID instance
   ObjectID *oid = ObjectWrap::Unwrap<ObjectID>(args.This());  
-  // Return the id
-  return String::New(oid->oid);
+  // Return the id in hex form
+  char oid_hex[OBJECTID_HEX_SIZE];
+  return scope.Close(String::New(oid->toHexString(oid_hex)));
 }
 
 Handle<Value> ObjectID::ToJSON(const Arguments &args) {
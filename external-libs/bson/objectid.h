@@ -11,11 +11,13 @@ using namespace node;
 class ObjectID : public ObjectWrap {  
   public:
     
-    static const int32_t OBJECTID_SIZE = 24+1;
+    static const int32_t OBJECTID_SIZE = 12;
+    static const int32_t OBJECTID_HEX_SIZE = 24+1;
     
+    // The raw 12 bytes of the oid
     char oid[OBJECTID_SIZE];
     
-    ObjectID(char *oid);
+    ObjectID(const char *oid);
     ~ObjectID();    
 
     static inline bool HasInstance(Handle<Value> val) {
@@ -40,8 +42,10 @@ class ObjectID : public ObjectWrap {
 
     // Constructor used for creating new Long objects from C++
     static Persistent<FunctionTemplate> constructor_template;
+    // Create a new ObjectID instance from the 12 raw bytes without going through the JS constructor
+    static Handle<Value> NewInstance(const char *oid);
     // Instance methods
-    char *convert_hex_oid_to_bin();    
+    char *toHexString(char *buffer);
 		bool equals(ObjectID *object_id);
   private:
     static Handle<Value> New(const Arguments &args);
@@ -49,6 +53,7 @@ class ObjectID : public ObjectWrap {
     // Generates oid's (Based on BSON C lib)
     static char *oid_id_generator(char* buffer);
     static char *uint32_to_char(uint32_t value, char* buffer);    
+    static bool hex_to_bin(const char *hex, char *buffer);
 };
 
 #endif  // OBJECTID_H_
\ No newline at end of file
@@ -14,6 +14,8 @@ var sys = require('util'),
   Symbol = require('../../lib/mongodb/bson/bson').Symbol,  
   Double = require('../../lib/mongodb/bson/bson').Double,  
   Timestamp = require('../../lib/mongodb/bson/bson').Timestamp,  
+  Matcher = require('../../lib/mongodb/bson/bson').Matcher,
+  Merger = require('../../lib/mongodb/bson/bson').Merger,
   assert = require('assert');
  
 var Long2 = require('./bson').Long,
@@ -23,7 +25,9 @@ var Long2 = require('./bson').Long,
     Symbol2 = require('./bson').Symbol,
     Double2 = require('./bson').Double,
     Timestamp2 = require('./bson').Timestamp,
-    DBRef2 = require('./bson').DBRef;
+    DBRef2 = require('./bson').DBRef,
+    Matcher2 = require('./bson').Matcher,
+    Merger2 = require('./bson').Merger;
     
 sys.puts("=== EXECUTING TEST_BSON ===");
 
@@ -102,6 +106,38 @@ assert.equal(10, a);
 var a = Long2.fromNumber(9223372036854775807);
 assert.equal(9223372036854775807, a);
 
+// Long arithmetic must match the goog.math.Long implementation, including overflow
+var values = [0, 1, -1, 7, -7, 2147483647, -2147483648, 4294967296, 9223372036800, -9223372036800, 9223372036854775807, -9223372036854775808];
+for(var i = 0; i < values.length; i++) {
+  for(var j = 0; j < values.length; j++) {
+    var a = Long.fromNumber(values[i]), b = Long.fromNumber(values[j]);
+    var a2 = Long2.fromNumber(values[i]), b2 = Long2.fromNumber(values[j]);
+    assert.equal(a.add(b).toString(), a2.add(b2).toString());
+    assert.equal(a.subtract(b).toString(), a2.subtract(b2).toString());
+    assert.equal(a.multiply(b).toString(), a2.multiply(b2).toString());
+    assert.equal(a.compare(b), a2.compare(b2));
+    assert.equal(a.equals(b), a2.equals(b2));
+    assert.equal(a.lessThan(b), a2.lessThan(b2));
+    assert.equal(a.greaterThan(b), a2.greaterThan(b2));
+
+    if(!b.isZero()) {
+      assert.equal(a.div(b).toString(), a2.div(b2).toString());
+      assert.equal(a.modulo(b).toString(), a2.modulo(b2).toString());
+    }
+  }
+
+  assert.equal(a.negate().toString(), a2.negate().toString());
+  assert.equal(a.shiftLeft(13).toString(), a2.shiftLeft(13).toString());
+  assert.equal(a.shiftRight(13).toString(), a2.shiftRight(13).toString());
+  assert.equal(a.toString(16), a2.toString(16));
+  assert.equal(a.toString(2), a2.toString(2));
+}
+
+// Numbers can be used directly as the operand
+assert.equal('101', Long2.fromNumber(100).add(1).toString());
+assert.ok(Long2.fromNumber(100).greaterThan(0));
+assert.throws(function() { Long2.fromNumber(100).div(0); });
+
 // Simple serialization and deserialization test for a Single String value
 var doc = {doc:'Serialize'};
 var simple_string_serialized = BSON.serialize(doc, true, false);
@@ -131,6 +167,46 @@ var simple_string_serialized = BSON.serialize(doc, false, true);
 assert.deepEqual(simple_string_serialized, BSONJS.serialize(doc, false, true));
 assert.deepEqual(BSONJS.deserialize(new Buffer(simple_string_serialized, 'binary')), BSON.deserialize(simple_string_serialized));
 
+// Integers around the 2^53 boundary are written as doubles and survive the round trip
+var doc = {a:9007199254740992, b:-9007199254740992, c:9007199254740994, d:4294967295};
+var simple_string_serialized = BSON.serialize(doc, false, true);
+assert.equal(BSON.calculateObjectSize(doc), simple_string_serialized.length);
+assert.deepEqual(doc, BSON.deserialize(simple_string_serialized));
+
+// Random numeric values must classify to the right BSON type and decode to the same number
+var numbers = [0, -0, 1, -1, 2147483647, -2147483648, 2147483648, -2147483649, 4294967295,
+  9007199254740992, -9007199254740992, 9007199254740994, 1.5, -1.5, 1e300, NaN, Infinity, -Infinity];
+for(var i = 0; i < 1000; i++) {
+  numbers.push(Math.floor(Math.random() * 0xffffffff) - 0x7fffffff);
+  numbers.push(Math.floor((Math.random() - 0.5) * 0x20000000000000));
+  numbers.push((Math.random() - 0.5) * 0x20000000000000);
+  numbers.push(Math.random() * 1e300);
+}
+
+for(var i = 0; i < numbers.length; i++) {
+  var value = numbers[i];
+  // Negative zero is written as a double to keep its sign
+  var isNegativeZero = value === 0 && 1 / value < 0;
+  var isInt32 = (value | 0) === value && !isNegativeZero;
+  var isJsInteger = Math.floor(value) === value && Math.abs(value) <= 0x20000000000000 && !isNegativeZero;
+
+  // Default mode, int32 or double
+  var serialized = BSON.serialize({doc:value}, false, true);
+  assert.equal(BSON.calculateObjectSize({doc:value}), serialized.length);
+  assert.equal(isInt32 ? 16 : 1, serialized[4]);
+  var decoded = BSON.deserialize(serialized).doc;
+  assert.ok(decoded === value || (value !== value && decoded !== decoded));
+  assert.equal(isNegativeZero, decoded === 0 && 1 / decoded < 0);
+
+  // Long integer mode, int32, int64 or double
+  var serialized = BSON.serialize({doc:value}, false, true, false, true);
+  assert.equal(BSON.calculateObjectSize({doc:value}), serialized.length);
+  assert.equal(isInt32 ? 16 : (isJsInteger ? 18 : 1), serialized[4]);
+  var decoded = BSON.deserialize(serialized).doc;
+  assert.ok(decoded === value || (value !== value && decoded !== decoded));
+  assert.equal(isNegativeZero, decoded === 0 && 1 / decoded < 0);
+}
+
 // Simple serialization and deserialization test for a Long value
 var doc = {doc:Long2.fromNumber(9223372036854775807)};
 var simple_string_serialized = BSON.serialize(doc, false, true);
@@ -142,6 +218,31 @@ var simple_string_serialized = BSON.serialize(doc, false, true);
 assert.deepEqual(simple_string_serialized, BSONJS.serialize({doc:Long.fromNumber(-9223372036854775807)}, false, true));
 assert.deepEqual(BSONJS.deserialize(new Buffer(simple_string_serialized, 'binary')), BSON.deserialize(simple_string_serialized));
 
+// Long.fromString rejects strings that aren't all digits and values that don't fit
+assert.equal('31', Long2.fromString('0x1f', 16).toString());
+assert.equal('-9223372036854775808', Long2.fromString('-9223372036854775808').toString());
+assert.throws(function() { Long2.fromString('0x', 16); }, /Invalid number string/);
+assert.throws(function() { Long2.fromString('12abc'); }, /Invalid number string/);
+assert.throws(function() { Long2.fromString('9223372036854775808'); }, /Number string out of range/);
+
+// rawTimestamps returns timestamps as their seconds and increment without a wrapper, large longs stay Longs
+var doc = {long:Long2.fromString("9223372036854775807"), small:Long2.fromNumber(-42), ts:new Timestamp2(7, 1316013127)};
+var simple_string_serialized = BSON.serialize(doc, false, true);
+var options = {rawTimestamps:true};
+var doc1 = BSON.deserialize(simple_string_serialized, options);
+var doc2 = BSONJS.deserialize(new Buffer(simple_string_serialized, 'binary'), options);
+assert.equal("9223372036854775807", doc1.long.toString());
+assert.equal(-42, doc1.small);
+assert.deepEqual({t:1316013127, i:7}, doc1.ts);
+assert.deepEqual({t:1316013127, i:7}, doc2.ts);
+assert.equal("9223372036854775807", doc2.long.toString());
+// The halves are unsigned
+assert.deepEqual({t:4294967295, i:4294967294}, BSON.deserialize(BSON.serialize({ts:new Timestamp2(-2, -1)}, false, true), options).ts);
+// Without rawTimestamps no precision is lost decoding the Timestamp
+var doc1 = BSON.deserialize(simple_string_serialized);
+assert.equal(7, doc1.ts.getLowBits());
+assert.equal(1316013127, doc1.ts.getHighBits());
+
 // Simple serialization and deserialization for a Float value
 var doc = {doc:2222.3333};
 var simple_string_serialized = BSON.serialize(doc, false, true);
@@ -172,6 +273,17 @@ var simple_string_serialized = BSON.serialize(doc, false, true);
 assert.deepEqual(simple_string_serialized, BSONJS.serialize(doc, false, true));
 assert.deepEqual(BSONJS.deserialize(new Buffer(simple_string_serialized, 'binary')), BSON.deserialize(simple_string_serialized));
 
+// rawDates returns the milliseconds without creating Date objects, dates before the epoch included
+var doc = {doc:date, old:new Date(-2208988800000), list:[date]};
+var simple_string_serialized = BSON.serialize(doc, false, true);
+var doc1 = BSON.deserialize(simple_string_serialized, {rawDates:true});
+assert.equal(date.getTime(), doc1.doc);
+assert.equal(-2208988800000, doc1.old);
+assert.equal(date.getTime(), doc1.list[0]);
+assert.deepEqual(BSONJS.deserialize(new Buffer(simple_string_serialized, 'binary'), {rawDates:true}), doc1);
+// Invalid dates are written as 0
+assert.equal(0, BSON.deserialize(BSON.serialize({doc:new Date(NaN)}, false, true), {rawDates:true}).doc);
+
 // Simple serialization and deserialization for a boolean value
 var doc = {doc:/abcd/mi};
 var simple_string_serialized = BSON.serialize(doc, false, true);
@@ -191,6 +303,14 @@ var doc2 = {doc:ObjectID.createFromHexString(doc.doc.toHexString())};
 assert.deepEqual(simple_string_serialized, BSONJS.serialize(doc2, false, true));
 assert.deepEqual(BSONJS.deserialize(new Buffer(simple_string_serialized, 'binary')).doc.toString(), BSON.deserialize(simple_string_serialized).doc.toString());
 
+// Decoded ObjectIDs are real instances holding the same bytes, hex input is normalized and validated
+var decoded = BSON.deserialize(simple_string_serialized).doc;
+assert.ok(decoded instanceof ObjectID2);
+assert.ok(decoded.equals(doc.doc));
+assert.equal(doc.doc.id, decoded.id);
+assert.equal(doc.doc.toHexString(), ObjectID2.createFromHexString(doc.doc.toHexString().toUpperCase()).toHexString());
+assert.throws(function() { new ObjectID2('zzzzzzzzzzzzzzzzzzzzzzzz'); });
+
 // Simple serialization and deserialization for a Binary value
 var binary = new Binary2();
 var string = 'binstring'
@@ -204,6 +324,254 @@ var simple_string_serialized = BSON.serialize({doc:binary}, false, true);
 assert.deepEqual(simple_string_serialized, BSONJS.serialize({doc:binary2}, false, true));
 assert.deepEqual(BSONJS.deserialize(new Buffer(simple_string_serialized, 'binary')).doc.value(), BSON.deserialize(simple_string_serialized).doc.value());
 
+// Only decode the top level fields of the projection
+var doc = {a:1, b:{c:[1, {a:2}], d:'e'}, r:/x/g, s:'string', n:null, bin:new Binary2(new Buffer('ab')), z:{q:1}};
+var serialized = BSON.serialize(doc, false, true);
+assert.deepEqual({a:1, b:{c:[1, {a:2}], d:'e'}, z:{q:1}}, BSON.deserialize(serialized, {fields:['a', 'b', 'z']}));
+assert.deepEqual({a:1, b:{c:[1, {a:2}], d:'e'}, z:{q:1}}, BSONJS.deserialize(serialized, {fields:['a', 'b', 'z']}));
+assert.deepEqual({s:'string'}, BSON.deserialize(serialized, {fields:['s', 'missing']}));
+assert.deepEqual({}, BSON.deserialize(serialized, {fields:[]}));
+
+// Deserialize a run of documents in one call
+var first = BSON.serialize({a:1}, false, true), second = BSON.serialize({b:'hello'}, false, true);
+var stream = new Buffer(first.length + second.length + 2);
+first.copy(stream, 2);
+second.copy(stream, 2 + first.length);
+var documents = [];
+assert.equal(stream.length, BSON.deserializeStream(stream, 2, 2, documents, 0));
+assert.deepEqual([{a:1}, {b:'hello'}], documents);
+assert.equal(stream.length, BSONJS.deserializeStream(stream, 2, 2, documents, 2));
+assert.deepEqual([{a:1}, {b:'hello'}, {a:1}, {b:'hello'}], documents);
+assert.throws(function() { BSON.deserializeStream(stream, 2, 3, [], 0); });
+// Or the documents at a list of offsets
+var documents = [];
+assert.equal(2 + first.length, BSON.deserializeStream(stream, [2 + first.length, 2], 2, documents, 0));
+assert.equal(2 + first.length, BSONJS.deserializeStream(stream, [2 + first.length, 2], 2, documents, 2));
+assert.deepEqual([{b:'hello'}, {a:1}, {b:'hello'}, {a:1}], documents);
+assert.throws(function() { BSON.deserializeStream(stream, [3], 1, [], 0); });
+
+// Copy a range of a Binary field straight out of a serialized document
+var doc = BSON.serialize({_id:new ObjectID2(), r:/a/i, n:2, data:new Binary2(new Buffer('hello world'))}, false, true);
+var target = new Buffer(5);
+assert.equal(5, BSON.copyBinaryField(doc, 'data', target, 0, 6, 100));
+assert.equal('world', target.toString());
+assert.equal(3, BSONJS.copyBinaryField(doc, 'data', target, 2, 0, 3));
+assert.equal('wohel', target.toString());
+assert.throws(function() { BSON.copyBinaryField(doc, 'n', target, 0, 0, 1); });
+assert.throws(function() { BSONJS.copyBinaryField(doc, 'missing', target, 0, 0, 1); });
+
+// Encode JSON text straight into a document
+var json = '{"_id":{"$oid":"4f2a3b4c5d6e7f8091a2b3c4"},"n":1,"f":1.5,"s":"caf\\u00e9","a":[true,null,{}],'
+  + '"d":{"$date":"2012-01-02T03:04:05.678Z"},"l":{"$numberLong":"9007199254740993"},"o":{"$oid":"not hex"}}';
+var encoded = BSON.fromJSON(json);
+assert.deepEqual(encoded, BSONJS.fromJSON(new Buffer(json)));
+var decoded = BSON.deserialize(encoded);
+assert.equal('4f2a3b4c5d6e7f8091a2b3c4', decoded._id.toHexString());
+assert.equal('caf\u00e9', decoded.s);
+assert.deepEqual([true, null, {}], decoded.a);
+assert.equal(1325473445678, decoded.d.getTime());
+assert.equal('9007199254740993', decoded.l.toString());
+assert.deepEqual({$oid:'not hex'}, decoded.o);
+// Offsets across the end of February and negative zero encode the same on both sides
+var json = '{"d":{"$date":"2001-03-01T00:30:00+01:00"},"e":{"$date":"2000-03-01T00:30:00+01:00"},"z":-0}';
+var encoded = BSON.fromJSON(json);
+assert.deepEqual(encoded, BSONJS.fromJSON(json));
+var decoded = BSON.deserialize(encoded);
+assert.equal('2001-02-28T23:30:00.000Z', decoded.d.toISOString());
+assert.equal('2000-02-29T23:30:00.000Z', decoded.e.toISOString());
+assert.equal(-Infinity, 1 / decoded.z);
+// Days past the end of their month aren't dates, leap days are
+var json = '{"a":{"$date":"2020-02-31T00:00:00Z"},"b":{"$date":"2019-02-29T00:00:00Z"},"c":{"$date":"2020-04-31T00:00:00Z"},'
+  + '"d":{"$date":"2020-02-29T00:00:00Z"},"e":{"$date":"2000-02-29T00:00:00Z"},"f":{"$date":"1900-02-29T00:00:00Z"}}';
+var encoded = BSON.fromJSON(json);
+assert.deepEqual(encoded, BSONJS.fromJSON(json));
+var decoded = BSON.deserialize(encoded);
+assert.deepEqual({$date:'2020-02-31T00:00:00Z'}, decoded.a);
+assert.deepEqual({$date:'2019-02-29T00:00:00Z'}, decoded.b);
+assert.deepEqual({$date:'2020-04-31T00:00:00Z'}, decoded.c);
+assert.equal('2020-02-29T00:00:00.000Z', decoded.d.toISOString());
+assert.equal('2000-02-29T00:00:00.000Z', decoded.e.toISOString());
+assert.deepEqual({$date:'1900-02-29T00:00:00Z'}, decoded.f);
+assert.throws(function() { BSON.fromJSON('{"a":1,}'); });
+assert.throws(function() { BSON.fromJSON('[1]'); });
+assert.throws(function() { BSON.fromJSON('{"a.b":1}', {checkKeys:true}); });
+
+// Interned short string values decode the same as copies
+var internDocs = [BSON.serialize({s:'active', c:'US', a:['GET', 'GET', ''], l:new Array(40).join('x')}, false, true),
+  BSON.serialize({s:'active', c:'FR', a:['PUT'], l:new Array(40).join('x')}, false, true)];
+var internStream = new Buffer(internDocs[0].length + internDocs[1].length);
+internDocs[0].copy(internStream, 0);
+internDocs[1].copy(internStream, internDocs[0].length);
+var internedNative = [], internedJS = [];
+BSON.deserializeStream(internStream, 0, 2, internedNative, 0, {internStrings:true});
+BSONJS.deserializeStream(internStream, 0, 2, internedJS, 0, {internStrings:true});
+assert.deepEqual([BSON.deserialize(internDocs[0]), BSON.deserialize(internDocs[1])], internedNative);
+assert.deepEqual(internedNative, internedJS);
+assert.deepEqual(BSON.deserialize(internDocs[0]), BSON.deserialize(internDocs[0], {internStrings:true}));
+
+// Field names shared across a stream batch, more names than name table slots
+var wide = {};
+for(var i = 0; i < 600; i++) wide['field' + i] = {field0:i, x:[i]};
+var wideDoc = BSON.serialize(wide, false, true);
+var wideStream = new Buffer(wideDoc.length * 2);
+wideDoc.copy(wideStream, 0);
+wideDoc.copy(wideStream, wideDoc.length);
+var wideDocs = [];
+BSON.deserializeStream(wideStream, 0, 2, wideDocs, 0);
+assert.deepEqual([wide, wide], wideDocs);
+assert.deepEqual(Object.keys(wide), Object.keys(wideDocs[1]));
+
+// Repeated regular expressions decode to the cached RegExp
+var regExpDoc = BSON.serialize({a:/^ab+c/i, b:[/x$/m, /^ab+c/i]}, false, true);
+var regExpStats = BSON.regExpCacheStats();
+var firstRegExps = BSON.deserialize(regExpDoc, {cacheRegExps:true});
+var secondRegExps = BSON.deserialize(regExpDoc, {cacheRegExps:true});
+assert.ok(firstRegExps.a === secondRegExps.a);
+assert.ok(firstRegExps.a === firstRegExps.b[1]);
+assert.ok(BSON.deserialize(regExpDoc).a !== firstRegExps.a);
+assert.equal(regExpStats.decodeHits + 4, BSON.regExpCacheStats().decodeHits);
+assert.equal(regExpStats.decodeMisses + 2, BSON.regExpCacheStats().decodeMisses);
+assert.deepEqual(regExpDoc, BSON.serialize(secondRegExps, false, true));
+assert.ok(BSON.regExpCacheStats().encodeHits > regExpStats.encodeHits);
+// Serializing other RegExps leaves the cache alone
+var regExpStats = BSON.regExpCacheStats();
+assert.deepEqual(BSONJS.serialize({a:/^serialized only$/}, false, true), BSON.serialize({a:/^serialized only$/}, false, true));
+assert.equal(regExpStats.size, BSON.regExpCacheStats().size);
+assert.deepEqual(BSONJS.deserialize(regExpDoc, {cacheRegExps:true}), firstRegExps);
+
+// Invalid keys are rejected at any depth when checking keys
+assert.throws(function() { BSON.serialize({a:{'$b':1}}, true, true); }, /key \$b must not start with '\$'/);
+assert.throws(function() { BSON.serialize({a:[{'long.field.name':1}]}, true, true); }, /key long.field.name must not contain '.'/);
+assert.throws(function() { BSON.serialize({'a.b':new DBRef2('test', new ObjectID2(), 'db')}, true, true); });
+assert.deepEqual(BSONJS.serialize({'$b':1, 'c.d':2}, false, true), BSON.serialize({'$b':1, 'c.d':2}, false, true));
+assert.deepEqual(BSONJS.serialize({r:dbref1, 'caf\u00e9':1}, true, true),
+  BSON.serialize({r:dbref2, 'caf\u00e9':1}, true, true));
+
+// Large ASCII strings decode to external strings of the same value
+var text = new Array(2049).join('ab');
+var textDoc = BSON.serialize({t:text, u:text + '\u00e9', s:'short'}, false, true);
+var external = BSON.deserialize(textDoc, {externalStringThreshold:1024});
+assert.deepEqual(BSON.deserialize(textDoc), external);
+assert.equal(4096, external.t.length);
+assert.equal(text + '\u00e9', external.u);
+
+// Write documents straight out as JSON text
+var doc = BSON.serialize({_id:new ObjectID2('4f2a3b4c5d6e7f8091a2b3c4'), n:1, f:1.5, s:'a"\n', d:new Date(1325473445678),
+  l:Long2.fromNumber(5), b:new Binary2(new Buffer('hi')), a:[true, null, {}]}, false, true);
+var json = '{"_id":{"$oid":"4f2a3b4c5d6e7f8091a2b3c4"},"n":1,"f":1.5,"s":"a\\"\\n","d":{"$date":"2012-01-02T03:04:05.678Z"},'
+  + '"l":5,"b":{"$binary":{"base64":"aGk=","subType":"00"}},"a":[true,null,{}]}';
+assert.equal(json, BSON.toJSON(doc).toString());
+assert.equal(json, BSONJS.toJSON(doc).toString());
+assert.equal('[' + json + ',{}]', BSON.toJSON([doc, BSON.serialize({}, false, true)]).toString());
+assert.equal(BSONJS.toJSON(doc, {canonical:true}).toString(), BSON.toJSON(doc, {canonical:true}).toString());
+var roundTrip = BSON.serialize({d:new Date(5), s:'x', o:{n:[1, 2.5]}}, false, true);
+assert.deepEqual(roundTrip, BSON.fromJSON(BSON.toJSON(roundTrip)));
+// Canonical output keeps doubles apart from int32 values and reads back as the same document
+var canonicalDoc = BSON.serialize({one:new Double2(1), z:-0, h:0.5, big:new Double2(1e21), nan:NaN, inf:-Infinity,
+  i:7, l:Long2.fromNumber(5)}, false, true);
+var canonicalJSON = BSON.toJSON(canonicalDoc, {canonical:true}).toString();
+assert.equal('{"one":{"$numberDouble":"1.0"},"z":{"$numberDouble":"-0.0"},"h":{"$numberDouble":"0.5"},'
+  + '"big":{"$numberDouble":"1e+21"},"nan":{"$numberDouble":"NaN"},"inf":{"$numberDouble":"-Infinity"},'
+  + '"i":{"$numberInt":"7"},"l":{"$numberLong":"5"}}', canonicalJSON);
+assert.equal(canonicalJSON, BSONJS.toJSON(canonicalDoc, {canonical:true}).toString());
+assert.deepEqual(canonicalDoc, BSON.fromJSON(canonicalJSON));
+assert.deepEqual(canonicalDoc, BSONJS.fromJSON(canonicalJSON));
+// Wrappers that don't hold a valid value stay plain objects
+var json = '{"a":{"$numberInt":"2147483648"},"b":{"$numberDouble":"01"},"c":{"$numberDouble":1}}';
+assert.deepEqual(BSON.fromJSON(json), BSONJS.fromJSON(json));
+assert.deepEqual({a:{$numberInt:'2147483648'}, b:{$numberDouble:'01'}, c:{$numberDouble:1}}, BSON.deserialize(BSON.fromJSON(json)));
+assert.throws(function() { BSON.toJSON(doc.slice(0, 20)); });
+
+// Queries are evaluated on the serialized documents
+var feed = [{_id:1, type:'error', n:5, tags:['a', 'b'], source:{host:'web1', port:80}},
+  {_id:2, type:'warning', n:Long2.fromNumber(5), source:{host:'db1'}, items:[{sku:'x', qty:3}, {sku:'y', qty:7}]},
+  {_id:3, type:'info', n:'5', tags:[], source:null},
+  {_id:4, type:'Error', n:5.5}];
+var feedDocs = feed.map(function(doc) { return BSON.serialize(doc, false, true); });
+var matching = function(query) {
+  var matcher = new Matcher2(query), matcherJS = new Matcher(query);
+  return feedDocs.filter(function(doc) {
+    assert.equal(matcherJS.test(doc), matcher.test(doc));
+    return matcher.test(doc);
+  }).map(function(doc) { return BSON.deserialize(doc)._id; });
+}
+assert.deepEqual([1, 2], matching({n:5}));
+assert.deepEqual([1, 2, 4], matching({n:{$gte:5}}));
+assert.deepEqual([3], matching({n:{$lt:'6'}}));
+assert.deepEqual([3, 4], matching({n:{$nin:[5]}}));
+assert.deepEqual([1, 4], matching({type:/^error/i}));
+assert.deepEqual([2], matching({type:{$regex:'^warn'}}));
+assert.deepEqual([1], matching({'source.host':{$regex:'web'}, 'source.port':{$exists:true}}));
+assert.deepEqual([3, 4], matching({'source.host':null}));
+assert.deepEqual([2], matching({'items.qty':{$gt:5}}));
+assert.deepEqual([2], matching({'items.1.sku':'y'}));
+assert.deepEqual([1, 3], matching({tags:{$exists:true}, $or:[{tags:'b'}, {tags:[]}]}));
+assert.deepEqual([2, 4], matching({$nor:[{type:'error'}, {type:'info'}]}));
+var feedBatch = Buffer.concat(feedDocs);
+assert.deepEqual([0, feedDocs[0].length], new Matcher2({n:5}).filter(feedBatch, 0, 4));
+assert.deepEqual(new Matcher({n:5}).filter(feedBatch, 0, 4), new Matcher2({n:5}).filter(feedBatch, 0, 4));
+assert.throws(function() { new Matcher2({n:{$size:1}}); }, /Unsupported query operator \$size/);
+assert.throws(function() { new Matcher2({n:5}).test(feedDocs[0].slice(0, 20)); }, /Corrupt BSON document/);
+
+// Sorted streams of serialized documents are merged by a sort
+var shard1 = [{_id:1, n:null}, {_id:2, n:1, s:'b'}, {_id:3, n:[7, 2]}].map(function(doc) { return BSON.serialize(doc, false, true); });
+var shard2 = [{_id:4}, {_id:5, n:Long2.fromNumber(2), s:'a'}, {_id:6, n:2.5}, {_id:7, n:'2'}].map(function(doc) { return BSON.serialize(doc, false, true); });
+var mergedIds = function(merger, streams, limit) {
+  return merger.merge(streams, limit).map(function(doc) { return BSON.deserialize(doc)._id; });
+}
+assert.deepEqual([1, 4, 2, 3, 5, 6, 7], mergedIds(new Merger2({n:1}), [shard1, shard2]));
+assert.deepEqual([1, 4, 2, 3, 5, 6, 7], mergedIds(new Merger('n'), [shard1, shard2]));
+assert.deepEqual([7, 3, 6], mergedIds(new Merger2([['n', 'desc']]), [shard1.slice(0).reverse(), shard2.slice(0).reverse()], 3));
+assert.deepEqual(mergedIds(new Merger([['n', -1], '_id']), [[shard1[2]], [shard2[2], shard2[1]]]),
+  mergedIds(new Merger2([['n', -1], '_id']), [[shard1[2]], [shard2[2], shard2[1]]]));
+assert.ok(new Merger2({n:1}).merge([shard1, shard2])[0] === shard1[0]);
+assert.equal(7, new Merger2('n').merge([shard1, shard2], null).length);
+assert.equal(-1, new Merger2('s').compare(shard2[1], shard1[1]));
+assert.equal(0, new Merger2('n').compare(shard1[0], shard2[0]));
+assert.equal(-1, new Merger2().compare(shard1[0], shard1[1]));
+assert.equal(new Merger().compare(shard2[3], shard2[2]), new Merger2().compare(shard2[3], shard2[2]));
+assert.throws(function() { new Merger2([['n', 'up']]); }, /Illegal sort clause/);
+assert.throws(function() { new Merger2('n').merge([[shard1[0].slice(0, 6)]]); }, /Corrupt BSON document/);
+// An empty array sorts after MinKey and before null, undefined sorts with null
+var shard3 = [{_id:8, n:null}, {_id:9, n:[]}, {_id:10, n:null}].map(function(doc) { return BSON.serialize(doc, false, true); });
+// Turn the null of the first document into a MinKey
+shard3[0][shard3[0].length - 4] = 0xff;
+var shard4 = [{_id:11, n:[]}, {_id:12}, {_id:13, n:0}].map(function(doc) { return BSON.serialize(doc, false, true); });
+assert.deepEqual([8, 9, 11, 10, 12, 13], mergedIds(new Merger2('n'), [shard3, shard4]));
+assert.deepEqual([8, 9, 11, 10, 12, 13], mergedIds(new Merger('n'), [shard3, shard4]));
+var undefinedDoc = new Buffer([8, 0, 0, 0, 6, 0x6e, 0, 0]);
+assert.equal(0, new Merger2('n').compare(undefinedDoc, shard3[2]));
+assert.equal(0, new Merger('n').compare(undefinedDoc, shard3[2]));
+assert.equal(1, new Merger2('n').compare(undefinedDoc, shard4[0]));
+assert.equal(1, new Merger('n').compare(undefinedDoc, shard4[0]));
+
+// A regular expression running past the end of its document is corrupt
+var truncatedRegExp = new Buffer([8, 0, 0, 0, 0x0B, 0x61, 0, 0]);
+assert.equal(-1, BSONJS.findField(truncatedRegExp, 'x'));
+assert.throws(function() { new Matcher({a:1}).test(truncatedRegExp); }, /Corrupt BSON document/);
+assert.throws(function() { BSONJS.compareDocuments(truncatedRegExp, 0, truncatedRegExp, 0); }, /Corrupt BSON document/);
+assert.throws(function() { BSONJS.toJSON(truncatedRegExp); }, /Corrupt BSON document/);
+
+// Binary with a preallocated capacity, reserve and writeMany
+var binary = new Binary2(4);
+assert.equal(0, binary.length());
+binary.put('a');
+binary.writeMany([new Buffer('bcd'), new Buffer('efgh')]);
+binary.reserve(1024);
+binary.write(new Buffer('ij'));
+assert.equal('abcdefghij', binary.value());
+var binary2 = new Binary(4);
+binary2.put('a');
+binary2.writeMany([new Buffer('bcd'), new Buffer('efgh'), new Buffer('ij')]);
+assert.deepEqual(BSON.serialize({doc:binary}, false, true), BSONJS.serialize({doc:binary2}, false, true));
+assert.throws(function() { binary.writeMany(['abc']); });
+
+// Decoded Binary values are real instances with their sub type
+var decoded = BSON.deserialize(BSON.serialize({doc:new Binary2(new Buffer('binstring'), 3)}, false, true)).doc;
+assert.ok(decoded instanceof Binary2);
+assert.equal(3, decoded.sub_type);
+assert.equal('binstring', decoded.value());
+
 // Simple serialization and deserialization for a Code value
 var code = new Code2('this.a > i', {'i': 1});
 var code2 = new Code('this.a > i', {'i': 1});
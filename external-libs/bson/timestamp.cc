@@ -92,6 +92,16 @@ Handle<Value> Timestamp::New(const Arguments &args) {
   }
 }
 
+Handle<Value> Timestamp::NewInstance(int32_t low_bits, int32_t high_bits) {
+  HandleScope scope;
+
+  // Instantiate straight from the instance template, skipping the argument parsing in New
+  Local<Object> timestamp_obj = constructor_template->InstanceTemplate()->NewInstance();
+  Timestamp *l = new Timestamp(low_bits, high_bits);
+  l->Wrap(timestamp_obj);
+  return scope.Close(timestamp_obj);
+}
+
 void Timestamp::Initialize(Handle<Object> target) {
   // Grab the scope of the call from Node
   HandleScope scope;
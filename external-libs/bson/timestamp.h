@@ -71,6 +71,8 @@ class Timestamp : public ObjectWrap {
 
     // Constructor used for creating new Timestamp objects from C++
     static Persistent<FunctionTemplate> constructor_template;
+    // Create a new Timestamp instance without going through the JS constructor
+    static Handle<Value> NewInstance(int32_t low_bits, int32_t high_bits);
     
   protected:
     static Handle<Value> New(const Arguments &args);
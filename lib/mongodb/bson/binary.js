@@ -11,7 +11,7 @@ var bson = require('./bson'),
 /**
  * Binary constructor.
  *
- * @param {Buffer} buffer (optional)
+ * @param {Buffer|Number} buffer (optional) initial content or the capacity to preallocate
  */
 
 function Binary(buffer, subType) {  
@@ -21,7 +21,10 @@ function Binary(buffer, subType) {
     this.sub_type = subType == null ? bson.BSON.BSON_BINARY_SUBTYPE_DEFAULT : subType;
   }
 
-  if(buffer != null && !(buffer instanceof Number)) {
+  if(typeof buffer == 'number') {
+    this.buffer = new Buffer(buffer);
+    this.position = 0;
+  } else if(buffer != null && !(buffer instanceof Number)) {
     this.buffer = typeof buffer == 'string' ? new Buffer(buffer) : buffer;
     this.position = buffer.length;
   } else {
@@ -37,15 +40,33 @@ function Binary(buffer, subType) {
  */
 
 Binary.prototype.put = function put (byte_value) {
-  if (this.buffer.length > this.position) {
-    this.buffer[this.position++] = byte_value.charCodeAt(0);
-  } else {
-    // Create additional overflow buffer
-    var buffer = new Buffer(Binary.BUFFER_SIZE + this.buffer.length);
-    // Combine the two buffers together
-    this.buffer.copy(buffer, 0, 0, this.buffer.length);
+  this.grow(this.position + 1);
+  this.buffer[this.position++] = byte_value.charCodeAt(0);
+};
+
+/**
+ * Makes sure at least `capacity` bytes are allocated.
+ *
+ * @param {Number} capacity
+ */
+
+Binary.prototype.reserve = function reserve (capacity) {
+  if (this.buffer.length < capacity) {
+    var buffer = new Buffer(capacity);
+    this.buffer.copy(buffer, 0, 0, this.position);
     this.buffer = buffer;
-    this.buffer[this.position++] = byte_value.charCodeAt(0);
+  }
+};
+
+/**
+ * Makes room for `needed` bytes, doubling the allocated space when full.
+ *
+ * @param {Number} needed
+ */
+
+Binary.prototype.grow = function grow (needed) {
+  if (this.buffer.length < needed) {
+    this.reserve(Math.max(needed, this.buffer.length * 2));
   }
 };
 
@@ -60,12 +81,7 @@ Binary.prototype.write = function write (string, offset) {
   offset = offset ? offset : this.position;
 
   // If the buffer is to small let's extend the buffer
-  if (this.buffer.length < offset + string.length) {
-    var buffer = new Buffer(this.buffer.length + string.length);
-    this.buffer.copy(buffer, 0, 0, this.buffer.length);
-    // Assign the new buffer
-    this.buffer = buffer;
-  }
+  this.grow(offset + string.length);
 
   if (string instanceof Buffer) {
     string.copy(this.buffer, offset, 0, string.length);
@@ -76,6 +92,27 @@ Binary.prototype.write = function write (string, offset) {
   this.position = offset + string.length;
 };
 
+/**
+ * Appends all the Buffers in `buffers`.
+ *
+ * @param {Array} buffers
+ */
+
+Binary.prototype.writeMany = function writeMany (buffers) {
+  var length = 0;
+  for (var i = 0; i < buffers.length; i++) {
+    if (!(buffers[i] instanceof Buffer)) throw new Error("writeMany takes an Array of Buffers");
+    length = length + buffers[i].length;
+  }
+
+  // Grow once for all of the content
+  this.grow(this.position + length);
+  for (var i = 0; i < buffers.length; i++) {
+    buffers[i].copy(this.buffer, this.position, 0, buffers[i].length);
+    this.position = this.position + buffers[i].length;
+  }
+};
+
 /**
  * Reads `length` bytes starting at `position`.
  *
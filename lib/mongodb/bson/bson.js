@@ -37,6 +37,7 @@ BSON.BSON_DATA_STRING = 2;
 BSON.BSON_DATA_OBJECT = 3;
 BSON.BSON_DATA_ARRAY = 4;
 BSON.BSON_DATA_BINARY = 5;
+BSON.BSON_DATA_UNDEFINED = 6;
 BSON.BSON_DATA_OID = 7;
 BSON.BSON_DATA_BOOLEAN = 8;
 BSON.BSON_DATA_DATE = 9;
@@ -59,6 +60,12 @@ BSON.BSON_BINARY_SUBTYPE_UUID = 3;
 BSON.BSON_BINARY_SUBTYPE_MD5 = 4;
 BSON.BSON_BINARY_SUBTYPE_USER_DEFINED = 128;
 
+// String intern table, slots (a power of two) and longest interned value in bytes
+BSON.INTERN_TABLE_SIZE = 512;
+BSON.INTERN_MAX_LENGTH = 32;
+// Entries of the regular expression cache
+BSON.REGEXP_CACHE_SIZE = 256;
+
 /**
  * Serialize `data` as BSON.
  *
@@ -104,7 +111,7 @@ BSON.calculateObjectSize = function(object, serializeFunctions) {
         keysIndex = 0;
         keyLength = keys.length;
       } else if((typeof value == 'number' || toString.call(value) === '[object Number]') &&
-                value === parseInt(value, 10) &&
+                value === parseInt(value, 10) && !(value === 0 && 1 / value < 0) &&
                 value.toString().match(/\./) == null) {                    
         // Write the type
         var int64 = value >= BSON.BSON_INT32_MAX || value < BSON.BSON_INT32_MIN;
@@ -294,7 +301,7 @@ BSON.serializeWithBufferAndIndex = function serializeWithBufferAndIndex(object,
           // Write zero
           buffer[index++] = 0;
         } else if((typeof value == 'number' || toString.call(value) === '[object Number]') &&
-                  value === parseInt(value, 10) &&
+                  value === parseInt(value, 10) && !(value === 0 && 1 / value < 0) &&
                   value.toString().match(/\./) == null) {                    
           // Write the type
           var int64 = value >= BSON.BSON_INT32_MAX || value < BSON.BSON_INT32_MIN;          
@@ -815,7 +822,7 @@ var crc32 =  function(string, start, end) {
  * @return {TODO}
  */
  
-BSON.deserialize = function(data, options) {
+BSON.deserialize = function(data, options, strings) {
   if(!(data instanceof Buffer)) throw new Error("data stream not a buffer object");
   // Finial object returned to user
   var object = {};
@@ -841,6 +848,17 @@ BSON.deserialize = function(data, options) {
   var evalFunctions = options['evalFunctions'] == null ? false : options['evalFunctions'];
   var cacheFunctions = options['cacheFunctions'] == null ? false : options['cacheFunctions'];
   var cacheFunctionsCrc32 = options['cacheFunctionsCrc32'] == null ? false : options['cacheFunctionsCrc32'];
+  var rawTimestamps = options['rawTimestamps'] == null ? false : options['rawTimestamps'];
+  var rawDates = options['rawDates'] == null ? false : options['rawDates'];
+  var cacheRegExps = options['cacheRegExps'] == null ? false : options['cacheRegExps'];
+  // Intern table of the short string values, deserializeStream shares one across its documents
+  if(strings == null && options['internStrings']) strings = new Array(BSON.INTERN_TABLE_SIZE);
+  // Only decode these top level fields
+  var fields = null;
+  if(Array.isArray(options['fields'])) {
+    fields = {};
+    for(var i = 0; i < options['fields'].length; i++) fields[options['fields'][i]] = true;
+  }
   
   // Decode 
   var size = data[index] | data[index + 1] << 8 | data[index + 2] << 16 | data[index + 3] << 24;
@@ -876,6 +894,18 @@ BSON.deserialize = function(data, options) {
         currentObject[currentObjectInstance.name] = value;
       }
     }
+
+    // Step over top level fields outside the projection by their size
+    if(fields != null && stackIndex === 0 && type !== 0) {
+      string_end_index = index;
+      while(data[string_end_index++] !== 0);
+      if(fields[data.toString('utf8', index, string_end_index - 1)] !== true) {
+        var valueSize = BSON.valueSize(data, string_end_index, type);
+        if(valueSize == -1) throw new Error("Unknown BSON type " + type);
+        index = string_end_index + valueSize;
+        continue;
+      }
+    }
     
     if(type === BSON.BSON_DATA_OBJECT || type === BSON.BSON_DATA_ARRAY) {
       // Read the null terminated string (indexof until first 0)
@@ -917,6 +947,8 @@ BSON.deserialize = function(data, options) {
       index = index + 4;
       // Read the string
       value = string_size == 0 ? '' : data.toString('utf8', index, index + string_size - 1);
+      // Hand out the string decoded before for a repeated short value
+      if(strings != null && string_size - 1 <= BSON.INTERN_MAX_LENGTH) value = internString(strings, data, index, string_size - 1, value);
       // Adjust the index with the size of the string
       index = index + string_size;
       
@@ -955,7 +987,7 @@ BSON.deserialize = function(data, options) {
       }
 
       // Regular expression
-      var value = new RegExp(reg_exp, options_array.join(''));
+      var value = cacheRegExps ? decodeRegExp(reg_exp, options_array.join('')) : new RegExp(reg_exp, options_array.join(''));
 
       // Set object property
       currentObject[Array.isArray(currentObject) ? parseInt(string_name, 10) : string_name] = value;
@@ -981,9 +1013,13 @@ BSON.deserialize = function(data, options) {
   
       // Create to integers
       var value_in_seconds = new Long(low_bits, high_bits).toNumber();
-      // Calculate date with miliseconds
-      var value = new Date();
-      value.setTime(value_in_seconds);
+      // Calculate date with miliseconds, unless the raw milliseconds are wanted
+      if(rawDates) {
+        var value = value_in_seconds;
+      } else {
+        var value = new Date();
+        value.setTime(value_in_seconds);
+      }
       
       // Set object property
       currentObject[Array.isArray(currentObject) ? parseInt(string_name, 10) : string_name] = value;
@@ -1155,10 +1191,13 @@ BSON.deserialize = function(data, options) {
         // Convert to long
         value = new Long(low_bits, high_bits);
 
-        // Convert to number
+        // Convert to number if it can be represented exactly
         if(value.lessThanOrEqual(JS_INT_MAX_LONG) && value.greaterThanOrEqual(JS_INT_MIN_LONG)) {
           value = value.toNumber();
         }
+      } else if(rawTimestamps) {
+        // The seconds and the increment
+        value = {t:high_bits >>> 0, i:low_bits >>> 0};
       } else {
         value = new Timestamp(low_bits, high_bits);
       }
@@ -1272,6 +1311,722 @@ BSON.deserialize = function(data, options) {
   return object;
 }
  
+// Compiled regular expressions by flags and pattern shared by all decode calls, least recently used first out
+var regExpCache = {};
+var regExpCacheSize = 0;
+var regExpCacheClock = 0;
+var regExpCacheStats = {decodeHits:0, decodeMisses:0, encodeHits:0, encodeMisses:0, evictions:0};
+
+/**
+ * Return the RegExp compiled for a pattern and flags before or compile and cache it.
+ *
+ * @ignore
+ * @api private
+ */
+var decodeRegExp = function(pattern, flags) {
+  var key = flags + '/' + pattern;
+  var entry = regExpCache[key];
+
+  if(entry != null) {
+    regExpCacheStats.decodeHits = regExpCacheStats.decodeHits + 1;
+    entry.used = ++regExpCacheClock;
+    return entry.value;
+  }
+
+  regExpCacheStats.decodeMisses = regExpCacheStats.decodeMisses + 1;
+  // Make room by dropping the least recently used entry
+  if(regExpCacheSize >= BSON.REGEXP_CACHE_SIZE) {
+    var oldest = null;
+    for(var name in regExpCache) {
+      if(oldest == null || regExpCache[name].used < regExpCache[oldest].used) oldest = name;
+    }
+
+    delete regExpCache[oldest];
+    regExpCacheSize = regExpCacheSize - 1;
+    regExpCacheStats.evictions = regExpCacheStats.evictions + 1;
+  }
+
+  entry = regExpCache[key] = {value:new RegExp(pattern, flags), used:++regExpCacheClock};
+  regExpCacheSize = regExpCacheSize + 1;
+  return entry.value;
+}
+
+/**
+ * Metrics of the regular expression cache used by decoding with the cacheRegExps option.
+ * The encode counts are kept by the native parser only, which also looks up the source
+ * of the RegExp values it serializes in the cache.
+ *
+ * @return {Object} decodeHits, decodeMisses, encodeHits, encodeMisses, evictions and size.
+ */
+BSON.regExpCacheStats = function() {
+  return {decodeHits:regExpCacheStats.decodeHits, decodeMisses:regExpCacheStats.decodeMisses,
+    encodeHits:regExpCacheStats.encodeHits, encodeMisses:regExpCacheStats.encodeMisses,
+    evictions:regExpCacheStats.evictions, size:regExpCacheSize};
+}
+
+/**
+ * Return the string of a short value from the intern table, the table is direct
+ * mapped on a hash of the bytes so a value replaces a different one in its slot.
+ *
+ * @ignore
+ * @api private
+ */
+var internString = function(strings, data, index, length, value) {
+  var hash = 0;
+  for(var i = 0; i < length; i++) {
+    hash = (hash * 31 + data[index + i]) | 0;
+  }
+
+  var slot = hash & (BSON.INTERN_TABLE_SIZE - 1);
+  if(strings[slot] === value) return strings[slot];
+  strings[slot] = value;
+  return value;
+}
+
+/**
+ * Deserialize a run of consecutive documents, or the documents at a list of offsets, into an array.
+ *
+ * @param {Buffer} data the buffer holding the documents
+ * @param {Number|Array} startIndex where the first document starts in the buffer, or where each document starts
+ * @param {Number} numberOfDocuments the number of documents to deserialize, at most the number of offsets
+ * @param {Array} documents the array the documents are stored in
+ * @param {Number} docStartIndex the index in the array of the first document
+ * @param {Object} options the same options as BSON.deserialize
+ * @return {Number} the index in the buffer after the last document
+ */
+BSON.deserializeStream = function(data, startIndex, numberOfDocuments, documents, docStartIndex, options) {
+  var offsets = Array.isArray(startIndex) ? startIndex : null;
+  var index = offsets == null ? startIndex : 0;
+  var strings = options != null && options['internStrings'] ? new Array(BSON.INTERN_TABLE_SIZE) : null;
+  if(offsets != null) numberOfDocuments = Math.min(numberOfDocuments, offsets.length);
+
+  for(var i = 0; i < numberOfDocuments; i++) {
+    if(offsets != null) index = offsets[i];
+    // Make sure the whole document is in the buffer
+    var size = data[index] | data[index + 1] << 8 | data[index + 2] << 16 | data[index + 3] << 24;
+    if(index + 4 > data.length || size < 5 || index + size > data.length) throw new Error("Corrupt BSON document stream.");
+    documents[docStartIndex + i] = BSON.deserialize(data.slice(index, index + size), options, strings);
+    index = index + size;
+  }
+
+  return index;
+};
+
+/**
+ * Copy a range of the bytes of a top level Binary field of a serialized
+ * document into a Buffer without deserializing the document.
+ *
+ * @param {Buffer} document the serialized document
+ * @param {String} name the name of the Binary field
+ * @param {Buffer} target the Buffer to copy into
+ * @param {Number} targetStart where to start writing in the target
+ * @param {Number} sourceStart the first byte of the binary data to copy
+ * @param {Number} sourceEnd the byte after the last one to copy, clamped to the binary length
+ * @return {Number} the number of bytes copied
+ */
+BSON.copyBinaryField = function(document, name, target, targetStart, sourceStart, sourceEnd) {
+  var index = BSON.findField(document, name);
+  if(index == -1) throw Error("Field not found in document.");
+  if(document[index - Buffer.byteLength(name) - 2] != BSON.BSON_DATA_BINARY) throw Error("Field is not of type Binary.");
+
+  // Clamp the requested range to the binary data
+  var number_of_bytes = document[index] | document[index + 1] << 8 | document[index + 2] << 16 | document[index + 3] << 24;
+  if(index + 4 + 1 + number_of_bytes > document.length) throw Error("Binary field exceeds the document.");
+  sourceEnd = Math.min(sourceEnd, number_of_bytes);
+  sourceStart = Math.min(sourceStart, sourceEnd);
+  if(targetStart + sourceEnd - sourceStart > target.length) throw Error("Target buffer is too small.");
+
+  // Skip the size and sub type and copy the bytes
+  document.copy(target, targetStart, index + 4 + 1 + sourceStart, index + 4 + 1 + sourceEnd);
+  return sourceEnd - sourceStart;
+};
+
+/**
+ * Find the index of the value of a top level field in a serialized document.
+ *
+ * @param {Buffer} document the serialized document
+ * @param {String} name the field name
+ * @return {Number} the index of the value or -1 if the document has no such field
+ * @api private
+ */
+BSON.findField = function(document, name) {
+  var size = document[0] | document[1] << 8 | document[2] << 16 | document[3] << 24;
+  if(document.length < 5 || size < 5 || size > document.length) return -1;
+  var index = 4;
+
+  while(index < size - 1) {
+    var type = document[index++];
+    // Read the field name
+    var string_end_index = index;
+    while(string_end_index < size && document[string_end_index] !== 0) string_end_index++;
+    if(string_end_index >= size) return -1;
+    var string_name = document.toString('utf8', index, string_end_index);
+    index = string_end_index + 1;
+
+    // The value has to end inside the document, also for the field looked for
+    var valueSize = BSON.valueSize(document, index, type, size - 1);
+    if(valueSize < 0) return -1;
+    if(string_name == name) return index;
+    index = index + valueSize;
+  }
+
+  return -1;
+};
+
+/**
+ * The number of bytes taken by an element value of the given type.
+ *
+ * @param {Buffer} data the serialized document
+ * @param {Number} index the start of the value
+ * @param {Number} type the BSON type of the element
+ * @param {Number} [end] the index the value has to end by, the end of data by default
+ * @return {Number} the size of the value or -1 for an unknown type or a value running past end
+ * @api private
+ */
+BSON.valueSize = function(data, index, type, end) {
+  end = end == null || end > data.length ? data.length : end;
+  var size = -1;
+
+  switch(type) {
+    case BSON.BSON_DATA_NUMBER:
+    case BSON.BSON_DATA_DATE:
+    case BSON.BSON_DATA_TIMESTAMP:
+    case BSON.BSON_DATA_LONG:
+      size = 8;
+      break;
+    case BSON.BSON_DATA_INT:
+      size = 4;
+      break;
+    case BSON.BSON_DATA_BOOLEAN:
+      size = 1;
+      break;
+    case BSON.BSON_DATA_OID:
+      size = 12;
+      break;
+    case BSON.BSON_DATA_NULL:
+    case BSON.BSON_DATA_UNDEFINED:
+    case BSON.BSON_DATA_MIN_KEY:
+    case BSON.BSON_DATA_MAX_KEY:
+      size = 0;
+      break;
+    case BSON.BSON_DATA_STRING:
+    case BSON.BSON_DATA_CODE:
+    case BSON.BSON_DATA_SYMBOL:
+      if(index + 4 > end || readInt32(data, index) < 1) return -1;
+      size = 4 + readInt32(data, index);
+      break;
+    case BSON.BSON_DATA_OBJECT:
+    case BSON.BSON_DATA_ARRAY:
+    case BSON.BSON_DATA_CODE_W_SCOPE:
+      if(index + 4 > end || readInt32(data, index) < 5) return -1;
+      size = readInt32(data, index);
+      break;
+    case BSON.BSON_DATA_BINARY:
+      if(index + 4 > end || readInt32(data, index) < 0) return -1;
+      size = 4 + 1 + readInt32(data, index);
+      break;
+    case BSON.BSON_DATA_REGEXP:
+      // Pattern and options are two C strings
+      var end_index = regExpEnd(data, index, end);
+      if(end_index == -1) return -1;
+      end_index = regExpEnd(data, end_index + 1, end);
+      if(end_index == -1) return -1;
+      return end_index + 1 - index;
+    default:
+      return -1;
+  }
+
+  return index + size > end ? -1 : size;
+};
+
+// The index of the terminator of the C string of a regular expression at index, -1 if there is none before end
+var regExpEnd = function(data, index, end) {
+  while(index < end && data[index] !== 0) index++;
+  return index < end ? index : -1;
+}
+
+// Rank of each BSON type in the order MongoDB sorts values of different types
+var canonicalTypes = {};
+canonicalTypes[BSON.BSON_DATA_MIN_KEY] = -1;
+canonicalTypes[BSON.BSON_DATA_NULL] = 5;
+canonicalTypes[BSON.BSON_DATA_UNDEFINED] = 5;
+canonicalTypes[BSON.BSON_DATA_NUMBER] = 10;
+canonicalTypes[BSON.BSON_DATA_INT] = 10;
+canonicalTypes[BSON.BSON_DATA_LONG] = 10;
+canonicalTypes[BSON.BSON_DATA_STRING] = 15;
+canonicalTypes[BSON.BSON_DATA_SYMBOL] = 15;
+canonicalTypes[BSON.BSON_DATA_OBJECT] = 20;
+canonicalTypes[BSON.BSON_DATA_ARRAY] = 25;
+canonicalTypes[BSON.BSON_DATA_BINARY] = 30;
+canonicalTypes[BSON.BSON_DATA_OID] = 35;
+canonicalTypes[BSON.BSON_DATA_BOOLEAN] = 40;
+canonicalTypes[BSON.BSON_DATA_DATE] = 45;
+canonicalTypes[BSON.BSON_DATA_TIMESTAMP] = 47;
+canonicalTypes[BSON.BSON_DATA_REGEXP] = 50;
+canonicalTypes[BSON.BSON_DATA_CODE] = 60;
+canonicalTypes[BSON.BSON_DATA_CODE_W_SCOPE] = 65;
+canonicalTypes[BSON.BSON_DATA_MAX_KEY] = 127;
+
+/**
+ * The rank of a BSON type in the order MongoDB sorts values of different types in,
+ * the numbers share a rank as do strings and symbols, and null and undefined.
+ *
+ * @param {Number} type the BSON type
+ * @return {Number} the rank
+ * @api private
+ */
+BSON.canonicalType = function(type) {
+  var rank = canonicalTypes[type];
+  return rank == null ? 0 : rank;
+};
+
+/**
+ * Compare two element values the way MongoDB sorts them, values of different types
+ * by the rank of their type.
+ *
+ * @param {Buffer} a the data holding the first value
+ * @param {Number} aIndex the start of the first value
+ * @param {Number} aType the BSON type of the first value
+ * @param {Buffer} b the data holding the second value
+ * @param {Number} bIndex the start of the second value
+ * @param {Number} bType the BSON type of the second value
+ * @return {Number} -1, 0 or 1 as the first value sorts before, with or after the second
+ * @api private
+ */
+BSON.compareValues = function(a, aIndex, aType, b, bIndex, bType) {
+  var rankA = BSON.canonicalType(aType);
+  var rankB = BSON.canonicalType(bType);
+  if(rankA != rankB) return rankA < rankB ? -1 : 1;
+
+  switch(aType) {
+    case BSON.BSON_DATA_NUMBER:
+    case BSON.BSON_DATA_INT:
+    case BSON.BSON_DATA_LONG:
+      // Integers compare exactly, doubles only with each other
+      if(aType != BSON.BSON_DATA_NUMBER && bType != BSON.BSON_DATA_NUMBER) return readInteger(a, aIndex, aType).compare(readInteger(b, bIndex, bType));
+      if(aType != BSON.BSON_DATA_NUMBER) return compareIntegerDouble(readInteger(a, aIndex, aType), readDouble(b, bIndex));
+      if(bType != BSON.BSON_DATA_NUMBER) return -compareIntegerDouble(readInteger(b, bIndex, bType), readDouble(a, aIndex));
+      return compareDouble(readDouble(a, aIndex), readDouble(b, bIndex));
+    case BSON.BSON_DATA_STRING:
+    case BSON.BSON_DATA_SYMBOL:
+    case BSON.BSON_DATA_CODE:
+      return compareBytes(a, aIndex + 4, readInt32(a, aIndex) - 1, b, bIndex + 4, readInt32(b, bIndex) - 1);
+    case BSON.BSON_DATA_OBJECT:
+    case BSON.BSON_DATA_ARRAY:
+      return BSON.compareDocuments(a, aIndex, b, bIndex);
+    case BSON.BSON_DATA_BINARY:
+      // By length, then subtype, then the bytes
+      var aLength = readInt32(a, aIndex);
+      var bLength = readInt32(b, bIndex);
+      if(aLength != bLength) return aLength < bLength ? -1 : 1;
+      if(a[aIndex + 4] != b[bIndex + 4]) return a[aIndex + 4] < b[bIndex + 4] ? -1 : 1;
+      return compareBytes(a, aIndex + 5, aLength, b, bIndex + 5, bLength);
+    case BSON.BSON_DATA_OID:
+      return compareBytes(a, aIndex, 12, b, bIndex, 12);
+    case BSON.BSON_DATA_BOOLEAN:
+      return (a[aIndex] != 0) == (b[bIndex] != 0) ? 0 : (a[aIndex] != 0 ? 1 : -1);
+    case BSON.BSON_DATA_DATE:
+      return readInteger(a, aIndex, BSON.BSON_DATA_LONG).compare(readInteger(b, bIndex, BSON.BSON_DATA_LONG));
+    case BSON.BSON_DATA_TIMESTAMP:
+      // Unsigned, the seconds are the high half
+      var aHigh = readInt32(a, aIndex + 4) >>> 0, bHigh = readInt32(b, bIndex + 4) >>> 0;
+      if(aHigh != bHigh) return aHigh < bHigh ? -1 : 1;
+      var aLow = readInt32(a, aIndex) >>> 0, bLow = readInt32(b, bIndex) >>> 0;
+      return aLow < bLow ? -1 : (aLow > bLow ? 1 : 0);
+    case BSON.BSON_DATA_REGEXP:
+      // By pattern, then options
+      var aEnd = regExpEnd(a, aIndex, a.length), bEnd = regExpEnd(b, bIndex, b.length);
+      if(aEnd == -1 || bEnd == -1) throw new Error("Corrupt BSON document");
+      var result = compareBytes(a, aIndex, aEnd - aIndex, b, bIndex, bEnd - bIndex);
+      if(result != 0) return result;
+      aIndex = aEnd + 1;
+      bIndex = bEnd + 1;
+      aEnd = regExpEnd(a, aIndex, a.length);
+      bEnd = regExpEnd(b, bIndex, b.length);
+      if(aEnd == -1 || bEnd == -1) throw new Error("Corrupt BSON document");
+      return compareBytes(a, aIndex, aEnd - aIndex, b, bIndex, bEnd - bIndex);
+    case BSON.BSON_DATA_CODE_W_SCOPE:
+      // By code, then scope. The total size is followed by the code string and the scope document
+      var result = BSON.compareValues(a, aIndex + 4, BSON.BSON_DATA_CODE, b, bIndex + 4, BSON.BSON_DATA_CODE);
+      if(result != 0) return result;
+      return BSON.compareDocuments(a, aIndex + 8 + readInt32(a, aIndex + 4), b, bIndex + 8 + readInt32(b, bIndex + 4));
+    default:
+      // Null, MinKey and MaxKey have no value
+      return 0;
+  }
+};
+
+/**
+ * Compare two documents the way MongoDB sorts them, element by element by the rank
+ * of the type, the name and then the value. A document sorts before the ones it is
+ * a prefix of.
+ *
+ * @param {Buffer} a the data holding the first document
+ * @param {Number} aIndex the start of the first document
+ * @param {Buffer} b the data holding the second document
+ * @param {Number} bIndex the start of the second document
+ * @return {Number} -1, 0 or 1 as the first document sorts before, with or after the second
+ * @api private
+ */
+BSON.compareDocuments = function(a, aIndex, b, bIndex) {
+  var aEnd = aIndex + readInt32(a, aIndex) - 1;
+  var bEnd = bIndex + readInt32(b, bIndex) - 1;
+  if(aEnd > a.length - 1 || bEnd > b.length - 1) throw new Error("Corrupt BSON document");
+  aIndex = aIndex + 4;
+  bIndex = bIndex + 4;
+
+  while(aIndex < aEnd && bIndex < bEnd) {
+    var aType = a[aIndex];
+    var bType = b[bIndex];
+    var rankA = BSON.canonicalType(aType);
+    var rankB = BSON.canonicalType(bType);
+    if(rankA != rankB) return rankA < rankB ? -1 : 1;
+
+    // Names compare as bytes
+    var aName = aIndex + 1, bName = bIndex + 1;
+    aIndex = aName;
+    bIndex = bName;
+    while(aIndex < aEnd && a[aIndex] !== 0) aIndex++;
+    while(bIndex < bEnd && b[bIndex] !== 0) bIndex++;
+    if(aIndex >= aEnd || bIndex >= bEnd) throw new Error("Corrupt BSON document");
+    var result = compareBytes(a, aName, aIndex - aName, b, bName, bIndex - bName);
+    if(result != 0) return result;
+
+    // The values have to end inside their documents before they are compared
+    aIndex = aIndex + 1;
+    bIndex = bIndex + 1;
+    var aSize = BSON.valueSize(a, aIndex, aType, aEnd);
+    var bSize = BSON.valueSize(b, bIndex, bType, bEnd);
+    if(aSize == -1 || bSize == -1) throw new Error("Corrupt BSON document");
+    result = BSON.compareValues(a, aIndex, aType, b, bIndex, bType);
+    if(result != 0) return result;
+
+    aIndex = aIndex + aSize;
+    bIndex = bIndex + bSize;
+  }
+
+  if(aIndex < aEnd) return 1;
+  if(bIndex < bEnd) return -1;
+  return 0;
+};
+
+var readInt32 = function(data, index) {
+  return data[index] | data[index + 1] << 8 | data[index + 2] << 16 | data[index + 3] << 24;
+}
+
+var readDouble = function(data, index) {
+  return ieee754.readIEEE754(data, index, 'little', 52, 8);
+}
+
+// An int32 or int64 value as a Long
+var readInteger = function(data, index, type) {
+  if(type == BSON.BSON_DATA_INT) return Long.fromInt(readInt32(data, index));
+  return new Long(readInt32(data, index), readInt32(data, index + 4));
+}
+
+// NaN sorts before every other number and equal to itself
+var compareDouble = function(a, b) {
+  if(a !== a || b !== b) return a !== a ? (b !== b ? 0 : -1) : 1;
+  return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Compare a Long with a double without rounding the Long
+var compareIntegerDouble = function(a, b) {
+  if(b !== b) return 1;
+  if(b >= 9223372036854775808) return -1;
+  if(b < -9223372036854775808) return 1;
+  var floor = Math.floor(b);
+  var result = a.compare(Long.fromNumber(floor));
+  if(result != 0) return result;
+  return b > floor ? -1 : 0;
+}
+
+var compareBytes = function(a, aIndex, aLength, b, bIndex, bLength) {
+  var length = aLength < bLength ? aLength : bLength;
+
+  for(var i = 0; i < length; i++) {
+    if(a[aIndex + i] != b[bIndex + i]) return a[aIndex + i] < b[bIndex + i] ? -1 : 1;
+  }
+
+  return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+/**
+ * Encode JSON text into a serialized document. Objects holding nothing but a $oid
+ * hex string, a $date (milliseconds, a $numberLong of them or an ISO-8601 string)
+ * or a $numberLong decimal string are written as ObjectID, Date and Long values.
+ *
+ * @param {String|Buffer} json the JSON text of an object
+ * @param {Object} [options] checkKeys rejects field names the server doesn't accept
+ * @return {Buffer} the serialized document
+ */
+BSON.fromJSON = function(json, options) {
+  var object = JSON.parse(json instanceof Buffer ? json.toString('utf8') : json, extendedJSONReviver);
+  if(object == null || typeof object != 'object' || Array.isArray(object)
+    || object instanceof ObjectID || object instanceof Date || object instanceof Long || object instanceof Double) {
+    throw Error("Expected an object at position 0");
+  }
+
+  return BSON.serialize(object, options != null && options.checkKeys == true, true);
+};
+
+/**
+ * Turns the extended JSON objects parsed by BSON.fromJSON into their values.
+ *
+ * @api private
+ */
+var extendedJSONReviver = function(key, value) {
+  if(value == null || typeof value != 'object' || Array.isArray(value)) return value;
+  var keys = Object.keys(value);
+  if(keys.length != 1) return value;
+
+  var field = value[keys[0]];
+  if(keys[0] == '$oid' && typeof field == 'string' && /^[0-9a-fA-F]{24}$/.test(field)) {
+    return ObjectID.createFromHexString(field);
+  } else if(keys[0] == '$numberLong' && typeof field == 'string' && /^-?[0-9]+$/.test(field)) {
+    var long = Long.fromString(field);
+    // Out of range values wrap around, leave those as they are
+    return long.toString() == field.replace(/^(-?)0+(?=[0-9])/, '$1').replace(/^-0$/, '0') ? long : value;
+  } else if(keys[0] == '$numberInt' && typeof field == 'string' && /^-?[0-9]+$/.test(field)) {
+    var number = parseInt(field, 10);
+    return number >= BSON.BSON_INT32_MIN && number < BSON.BSON_INT32_MAX ? number : value;
+  } else if(keys[0] == '$numberDouble' && typeof field == 'string'
+    && /^(-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?|NaN|-?Infinity)$/.test(field)) {
+    var number = Number(field);
+    // Integral values have to be kept as doubles, a negative zero already is one
+    return number === 0 && 1 / number < 0 ? number : new Double(number);
+  } else if(keys[0] == '$date') {
+    if(typeof field == 'number' && Math.abs(field) < BSON.JS_INT_MAX) return new Date(field);
+    if(field instanceof Long) return new Date(field.toNumber());
+    if(typeof field == 'string') return parseISODate(field) || value;
+  }
+
+  return value;
+};
+
+/**
+ * Parse a YYYY-MM-DDTHH:MM:SS[.sss](Z|+HH:MM|-HH:MM) date, returns null if the string isn't one.
+ *
+ * @api private
+ */
+var parseISODate = function(string) {
+  var match = /^(\d{4})-(\d{2})-(\d{2})T(\d{2}):(\d{2}):(\d{2})(?:\.(\d+))?(?:(Z)|([+-])(\d{2}):(\d{2}))$/.exec(string);
+  if(match == null) return null;
+
+  var year = parseInt(match[1], 10), month = parseInt(match[2], 10), day = parseInt(match[3], 10);
+  var hours = parseInt(match[4], 10), minutes = parseInt(match[5], 10), seconds = parseInt(match[6], 10);
+  if(month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month)
+    || hours > 23 || minutes > 59 || seconds > 59) return null;
+
+  // Milliseconds are the first three fraction digits
+  var milliseconds = match[7] == null ? 0 : parseInt((match[7] + '00').substr(0, 3), 10);
+  var offset = match[8] == 'Z' ? 0 : (match[9] == '-' ? -1 : 1) * (parseInt(match[10], 10) * 60 + parseInt(match[11], 10));
+  var days = daysFromCivil(year, month, day);
+  return new Date((((days * 24 + hours) * 60 + minutes - offset) * 60 + seconds) * 1000 + milliseconds);
+};
+
+/**
+ * Number of days in a month of the proleptic Gregorian calendar.
+ *
+ * @api private
+ */
+var daysInMonth = function(year, month) {
+  var leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+  return month == 2 && leap ? 29 : [31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31][month - 1];
+};
+
+/**
+ * Days between 1970-01-01 and the given date of the proleptic Gregorian calendar.
+ *
+ * @api private
+ */
+var daysFromCivil = function(year, month, day) {
+  year = year - (month <= 2 ? 1 : 0);
+  var era = Math.floor(year / 400);
+  var yearOfEra = year - era * 400;
+  var dayOfYear = Math.floor((153 * (month > 2 ? month - 3 : month + 9) + 2) / 5) + day - 1;
+  var dayOfEra = yearOfEra * 365 + Math.floor(yearOfEra / 4) - Math.floor(yearOfEra / 100) + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+};
+
+/**
+ * Write serialized documents straight out as JSON text without deserializing them.
+ * ObjectID, Date, Long, Binary and the other BSON types are written as relaxed
+ * extended JSON, or canonical extended JSON with the canonical option.
+ *
+ * @param {Buffer|Array} documents a serialized document, or an Array of them written as a JSON array
+ * @param {Object} [options] canonical writes canonical extended JSON
+ * @return {Buffer} the JSON text
+ */
+BSON.toJSON = function(documents, options) {
+  var canonical = options != null && options.canonical == true;
+  var parts = [];
+
+  if(Array.isArray(documents)) {
+    parts.push('[');
+    for(var i = 0; i < documents.length; i++) {
+      if(i > 0) parts.push(',');
+      writeJSONDocument(parts, documents[i], 0, false, canonical, 0);
+    }
+    parts.push(']');
+  } else {
+    writeJSONDocument(parts, documents, 0, false, canonical, 0);
+  }
+
+  return new Buffer(parts.join(''), 'utf8');
+};
+
+/**
+ * Write the document at index as JSON, returns the index after it.
+ *
+ * @api private
+ */
+var writeJSONDocument = function(parts, data, index, isArray, canonical, depth) {
+  if(!(data instanceof Buffer) || index + 5 > data.length) throw Error("Corrupt BSON document");
+  var size = data[index] | data[index + 1] << 8 | data[index + 2] << 16 | data[index + 3] << 24;
+  var end = index + size;
+  if(size < 5 || end > data.length || data[end - 1] != 0 || depth >= 100) throw Error("Corrupt BSON document");
+
+  parts.push(isArray ? '[' : '{');
+  var first = true;
+  index = index + 4;
+
+  while(index < end - 1) {
+    var type = data[index++];
+    var name_end = index;
+    while(name_end < end && data[name_end] !== 0) name_end++;
+    if(name_end >= end - 1) throw Error("Corrupt BSON document");
+
+    if(!first) parts.push(',');
+    first = false;
+    if(!isArray) parts.push(JSON.stringify(data.toString('utf8', index, name_end)), ':');
+    index = name_end + 1;
+
+    var valueSize = BSON.valueSize(data, index, type, end - 1);
+    if(valueSize < 0) throw Error("Corrupt BSON document");
+    writeJSONValue(parts, data, index, type, canonical, depth);
+    index = index + valueSize;
+  }
+
+  parts.push(isArray ? ']' : '}');
+  return end;
+};
+
+/**
+ * Write a JSON string from the length prefixed string at index.
+ *
+ * @api private
+ */
+var jsonString = function(data, index) {
+  var size = data[index] | data[index + 1] << 8 | data[index + 2] << 16 | data[index + 3] << 24;
+  if(size < 1) throw Error("Corrupt BSON document");
+  return JSON.stringify(data.toString('utf8', index + 4, index + 4 + size - 1));
+};
+
+/**
+ * Write a double the way JS prints it, non finite values as extended JSON.
+ *
+ * @api private
+ */
+var jsonDouble = function(value, canonical) {
+  if(!isFinite(value) || canonical) {
+    var string = isNaN(value) ? 'NaN' : (value == Infinity ? 'Infinity' : (value == -Infinity ? '-Infinity' : String(value)));
+    // Keep the sign of zero and a fraction on integral values so the text reads back as a double
+    if(value === 0 && 1 / value < 0) string = '-0';
+    if(isFinite(value) && !/[.e]/.test(string)) string = string + '.0';
+    return '{"$numberDouble":"' + string + '"}';
+  }
+  return String(value);
+};
+
+/**
+ * Write a date as ISO-8601 text for the years 1970 to 9999 or as its milliseconds.
+ *
+ * @api private
+ */
+var jsonDate = function(value, canonical) {
+  var milliseconds = value.toNumber();
+  if(!canonical && milliseconds >= 0 && milliseconds < 253402300800000) {
+    return '{"$date":"' + new Date(milliseconds).toISOString() + '"}';
+  }
+  return '{"$date":{"$numberLong":"' + value.toString() + '"}}';
+};
+
+/**
+ * Write the element value at index as JSON.
+ *
+ * @api private
+ */
+var writeJSONValue = function(parts, data, index, type, canonical, depth) {
+  var readInt32 = function(i) { return data[i] | data[i + 1] << 8 | data[i + 2] << 16 | data[i + 3] << 24; };
+  var readLong = function(i) { return new Long(readInt32(i), readInt32(i + 4)); };
+
+  switch(type) {
+    case BSON.BSON_DATA_NUMBER:
+      parts.push(jsonDouble(ieee754.readIEEE754(data, index, 'little', 52, 8), canonical));
+      break;
+    case BSON.BSON_DATA_STRING:
+      parts.push(jsonString(data, index));
+      break;
+    case BSON.BSON_DATA_OBJECT:
+    case BSON.BSON_DATA_ARRAY:
+      writeJSONDocument(parts, data, index, type == BSON.BSON_DATA_ARRAY, canonical, depth + 1);
+      break;
+    case BSON.BSON_DATA_BINARY:
+      var size = readInt32(index);
+      var subType = data[index + 4];
+      parts.push('{"$binary":{"base64":"', data.toString('base64', index + 5, index + 5 + size),
+        '","subType":"', (subType < 16 ? '0' : '') + subType.toString(16), '"}}');
+      break;
+    case BSON.BSON_DATA_OID:
+      parts.push('{"$oid":"', data.toString('hex', index, index + 12), '"}');
+      break;
+    case BSON.BSON_DATA_BOOLEAN:
+      parts.push(data[index] == 1 ? 'true' : 'false');
+      break;
+    case BSON.BSON_DATA_DATE:
+      parts.push(jsonDate(readLong(index), canonical));
+      break;
+    case BSON.BSON_DATA_NULL:
+      parts.push('null');
+      break;
+    case BSON.BSON_DATA_REGEXP:
+      var pattern_end = regExpEnd(data, index, data.length);
+      var options_end = pattern_end == -1 ? -1 : regExpEnd(data, pattern_end + 1, data.length);
+      if(options_end == -1) throw Error("Corrupt BSON document");
+      parts.push('{"$regularExpression":{"pattern":', JSON.stringify(data.toString('utf8', index, pattern_end)),
+        ',"options":', JSON.stringify(data.toString('utf8', pattern_end + 1, options_end)), '}}');
+      break;
+    case BSON.BSON_DATA_CODE:
+      parts.push('{"$code":', jsonString(data, index), '}');
+      break;
+    case BSON.BSON_DATA_SYMBOL:
+      parts.push('{"$symbol":', jsonString(data, index), '}');
+      break;
+    case BSON.BSON_DATA_CODE_W_SCOPE:
+      var code_size = readInt32(index + 4);
+      parts.push('{"$code":', jsonString(data, index + 4), ',"$scope":');
+      writeJSONDocument(parts, data, index + 4 + 4 + code_size, false, canonical, depth + 1);
+      parts.push('}');
+      break;
+    case BSON.BSON_DATA_INT:
+      parts.push(canonical ? '{"$numberInt":"' + readInt32(index) + '"}' : String(readInt32(index)));
+      break;
+    case BSON.BSON_DATA_TIMESTAMP:
+      parts.push('{"$timestamp":{"t":', String(readInt32(index + 4) >>> 0), ',"i":', String(readInt32(index) >>> 0), '}}');
+      break;
+    case BSON.BSON_DATA_LONG:
+      parts.push(canonical ? '{"$numberLong":"' + readLong(index).toString() + '"}' : readLong(index).toString());
+      break;
+    case BSON.BSON_DATA_MIN_KEY:
+      parts.push('{"$minKey":1}');
+      break;
+    case BSON.BSON_DATA_MAX_KEY:
+      parts.push('{"$maxKey":1}');
+      break;
+  }
+};
+
 /**
  * Check if key name is valid.
  *
@@ -1374,3 +2129,6 @@ exports.Timestamp = Timestamp;
 exports.Double = Double;
 exports.MinKey = MinKey;
 exports.MaxKey = MaxKey;
+// After the BSON export, the matcher and the merger read it when they load
+exports.Matcher = require('./matcher').Matcher;
+exports.Merger = require('./merger').Merger;
@@ -0,0 +1,303 @@
+var BSON = require('./bson').BSON;
+
+// Operators of the conditions
+var MATCH_AND = 0;
+var MATCH_OR = 1;
+var MATCH_EQ = 2;
+var MATCH_GT = 3;
+var MATCH_GTE = 4;
+var MATCH_LT = 5;
+var MATCH_LTE = 6;
+var MATCH_IN = 7;
+var MATCH_EXISTS = 8;
+var MATCH_REGEX = 9;
+
+var operators = {'$eq':[MATCH_EQ, false], '$ne':[MATCH_EQ, true], '$gt':[MATCH_GT, false], '$gte':[MATCH_GTE, false],
+  '$lt':[MATCH_LT, false], '$lte':[MATCH_LTE, false], '$in':[MATCH_IN, false], '$nin':[MATCH_IN, true], '$exists':[MATCH_EXISTS, false]};
+
+/**
+ * A query compiled once to test serialized documents without deserializing them.
+ *
+ * Supports comparing with values and the $eq, $ne, $gt, $gte, $lt, $lte, $in, $nin,
+ * $exists and $regex operators on dotted paths, combined with $and, $or and $nor. A
+ * query using anything else is rejected.
+ *
+ * @param query {Object|Buffer} The query, or the query serialized.
+ */
+var Matcher = exports.Matcher = function(query) {
+  this.query = query instanceof Buffer ? query : BSON.serialize(query, false, true);
+  this.root = {op:MATCH_AND, negate:false, conditions:[]};
+  compileDocument(this.root, this.query, 0);
+}
+
+/**
+ * Test a serialized document.
+ *
+ * @param data {Buffer} The data holding the document.
+ * @param index {?number} The start of the document, 0 by default.
+ * @return {boolean} Whether the document matches the query.
+ */
+Matcher.prototype.test = function(data, index) {
+  index = index == null ? 0 : index;
+  documentEnd(data, index);
+  return evaluate(this.root, data, index);
+}
+
+/**
+ * Test serialized documents stored back to back, like the documents of a reply.
+ *
+ * @param data {Buffer} The data holding the documents.
+ * @param index {number} The start of the first document.
+ * @param numberOfDocuments {number} The number of documents.
+ * @return {Array<number>} The start indexes of the documents matching the query.
+ */
+Matcher.prototype.filter = function(data, index, numberOfDocuments) {
+  var matches = [];
+
+  for(var i = 0; i < numberOfDocuments; i++) {
+    var end = documentEnd(data, index);
+    if(evaluate(this.root, data, index)) matches.push(index);
+    index = end + 1;
+  }
+
+  return matches;
+}
+
+// The index of the last byte of the document at index
+var documentEnd = function(data, index) {
+  var size = readInt32(data, index);
+  if(index + 5 > data.length || size < 5 || index + size > data.length || data[index + size - 1] !== 0) {
+    throw new Error("Corrupt BSON document");
+  }
+
+  return index + size - 1;
+}
+
+var readInt32 = function(data, index) {
+  return data[index] | data[index + 1] << 8 | data[index + 2] << 16 | data[index + 3] << 24;
+}
+
+// Read the elements of the document at index, calling fn with each until it returns true
+var eachElement = function(data, index, fn) {
+  var end = documentEnd(data, index);
+  index = index + 4;
+
+  while(index < end) {
+    var type = data[index];
+    var nameEnd = index + 1;
+    while(nameEnd < end && data[nameEnd] !== 0) nameEnd++;
+    if(nameEnd >= end) throw new Error("Corrupt BSON document");
+    var size = BSON.valueSize(data, nameEnd + 1, type, end);
+    if(size == -1) throw new Error("Corrupt BSON document");
+
+    var element = {type:type, name:data.toString('utf8', index + 1, nameEnd), data:data, index:nameEnd + 1};
+    if(fn(element)) return true;
+    index = nameEnd + 1 + size;
+  }
+
+  return false;
+}
+
+// The string value of an element
+var stringValue = function(element) {
+  return element.data.toString('utf8', element.index + 4, element.index + 4 + readInt32(element.data, element.index) - 1);
+}
+
+// Add the conditions of a query document to parent, all of them have to hold
+var compileDocument = function(parent, data, index) {
+  eachElement(data, index, function(element) {
+    if(element.name.charAt(0) == '$') {
+      if(element.name != '$and' && element.name != '$or' && element.name != '$nor') throw new Error("Unsupported query operator " + element.name);
+      if(element.type != BSON.BSON_DATA_ARRAY) throw new Error("Expected an array of queries for " + element.name);
+
+      // Each document of the array is a clause of its own
+      var condition = {op:element.name == '$and' ? MATCH_AND : MATCH_OR, negate:element.name == '$nor', conditions:[]};
+      eachElement(data, element.index, function(clause) {
+        if(clause.type != BSON.BSON_DATA_OBJECT) throw new Error("Expected an array of queries for " + element.name);
+        var clauseCondition = {op:MATCH_AND, negate:false, conditions:[]};
+        compileDocument(clauseCondition, data, clause.index);
+        condition.conditions.push(clauseCondition);
+      });
+
+      if(condition.conditions.length == 0) throw new Error("Expected a nonempty array of queries for " + element.name);
+      parent.conditions.push(condition);
+    } else if(element.type == BSON.BSON_DATA_OBJECT && readInt32(data, element.index) > 5 && data[element.index + 5] == 0x24) {
+      // A document of operators, the first name tells it from a document to compare with
+      compileOperators(parent, element.name.split('.'), data, element.index);
+    } else if(element.type == BSON.BSON_DATA_REGEXP) {
+      var patternEnd = element.index;
+      while(data[patternEnd] !== 0) patternEnd++;
+      var optionsEnd = patternEnd + 1;
+      while(data[optionsEnd] !== 0) optionsEnd++;
+      parent.conditions.push(compileRegExp(element.name.split('.'), data.toString('utf8', element.index, patternEnd),
+        data.toString('utf8', patternEnd + 1, optionsEnd)));
+    } else {
+      parent.conditions.push({op:MATCH_EQ, negate:false, path:element.name.split('.'), operand:element});
+    }
+  });
+}
+
+// Add a condition to parent for each operator of the document of operators on a field
+var compileOperators = function(parent, path, data, index) {
+  var regexp = null;
+  var options = null;
+
+  eachElement(data, index, function(element) {
+    // The pattern and options of a $regex are compiled together once both are known
+    if(element.name == '$regex') {
+      if(element.type != BSON.BSON_DATA_STRING && element.type != BSON.BSON_DATA_REGEXP) throw new Error("Expected a string or regular expression for $regex");
+      regexp = element;
+      return;
+    } else if(element.name == '$options') {
+      if(element.type != BSON.BSON_DATA_STRING) throw new Error("Expected a string for $options");
+      options = stringValue(element);
+      return;
+    }
+
+    var operator = operators[element.name];
+    if(operator == null) throw new Error("Unsupported query operator " + element.name);
+    if(operator[0] == MATCH_IN && element.type != BSON.BSON_DATA_ARRAY) throw new Error("Expected an array for " + element.name);
+    var negate = operator[1];
+
+    // {$exists:false} is the negation of {$exists:true}, anything but false, 0 and null is true
+    if(operator[0] == MATCH_EXISTS) {
+      negate = element.type == BSON.BSON_DATA_NULL || (element.type == BSON.BSON_DATA_BOOLEAN && data[element.index] == 0)
+        || BSON.compareValues(data, element.index, element.type, zero, 0, BSON.BSON_DATA_INT) == 0;
+    }
+
+    parent.conditions.push({op:operator[0], negate:negate, path:path, operand:element});
+  });
+
+  if(regexp != null) {
+    if(regexp.type == BSON.BSON_DATA_REGEXP) {
+      // $options take the place of the flags of a regular expression
+      var patternEnd = regexp.index;
+      while(data[patternEnd] !== 0) patternEnd++;
+      var optionsEnd = patternEnd + 1;
+      while(data[optionsEnd] !== 0) optionsEnd++;
+      parent.conditions.push(compileRegExp(path, data.toString('utf8', regexp.index, patternEnd),
+        options != null ? options : data.toString('utf8', patternEnd + 1, optionsEnd)));
+    } else {
+      parent.conditions.push(compileRegExp(path, stringValue(regexp), options != null ? options : ''));
+    }
+  } else if(options != null) {
+    throw new Error("Expected a $regex with $options");
+  }
+}
+
+var zero = new Buffer([0, 0, 0, 0]);
+
+var compileRegExp = function(path, pattern, options) {
+  for(var i = 0; i < options.length; i++) {
+    if(options.charAt(i) != 'i' && options.charAt(i) != 'm') throw new Error("Unsupported regular expression option " + options.charAt(i));
+  }
+
+  try {
+    var regexp = new RegExp(pattern, options);
+  } catch(err) {
+    throw new Error("Invalid regular expression " + pattern);
+  }
+
+  return {op:MATCH_REGEX, negate:false, path:path, regexp:regexp};
+}
+
+var evaluate = function(condition, data, index) {
+  var result;
+
+  if(condition.op == MATCH_AND) {
+    result = true;
+    for(var i = 0; i < condition.conditions.length && result; i++) {
+      result = evaluate(condition.conditions[i], data, index);
+    }
+  } else if(condition.op == MATCH_OR) {
+    result = false;
+    for(var i = 0; i < condition.conditions.length && !result; i++) {
+      result = evaluate(condition.conditions[i], data, index);
+    }
+  } else {
+    result = matchPath(condition, data, index, 0);
+  }
+
+  return condition.negate ? !result : result;
+}
+
+// Test the field at the path of a condition from depth on in the document at index. An array on the
+// path matches if one of its embedded documents does, or the element picked by a number in the path
+var matchPath = function(condition, data, index, depth) {
+  var found = null;
+  eachElement(data, index, function(element) {
+    if(element.name == condition.path[depth]) found = element;
+    return found != null;
+  });
+
+  if(found == null) return matchMissing(condition);
+  if(depth == condition.path.length - 1) return matchValue(condition, found);
+  if(found.type == BSON.BSON_DATA_OBJECT) return matchPath(condition, data, found.index, depth + 1);
+  if(found.type != BSON.BSON_DATA_ARRAY) return matchMissing(condition);
+
+  if(/^[0-9]/.test(condition.path[depth + 1]) && matchPath(condition, data, found.index, depth + 1)) return true;
+
+  var embedded = false;
+  var matched = eachElement(data, found.index, function(item) {
+    if(item.type != BSON.BSON_DATA_OBJECT) return false;
+    embedded = true;
+    return matchPath(condition, data, item.index, depth + 1);
+  });
+
+  return matched || (!embedded && matchMissing(condition));
+}
+
+// Test a field value, an array also matches if one of its elements does
+var matchValue = function(condition, element) {
+  if(condition.op == MATCH_EXISTS) return true;
+  if(matchScalar(condition, element)) return true;
+  if(element.type != BSON.BSON_DATA_ARRAY) return false;
+
+  return eachElement(element.data, element.index, function(item) {
+    return matchScalar(condition, item);
+  });
+}
+
+var matchScalar = function(condition, element) {
+  if(condition.op == MATCH_REGEX) {
+    if(element.type != BSON.BSON_DATA_STRING && element.type != BSON.BSON_DATA_SYMBOL) return false;
+    return condition.regexp.test(stringValue(element));
+  }
+
+  if(condition.op == MATCH_IN) {
+    return eachElement(condition.operand.data, condition.operand.index, function(item) {
+      return BSON.canonicalType(item.type) == BSON.canonicalType(element.type)
+        && BSON.compareValues(element.data, element.index, element.type, item.data, item.index, item.type) == 0;
+    });
+  }
+
+  // Only values sorting with the same types compare, {$gt:5} never matches a string
+  var operand = condition.operand;
+  if(BSON.canonicalType(element.type) != BSON.canonicalType(operand.type)) return false;
+  var result = BSON.compareValues(element.data, element.index, element.type, operand.data, operand.index, operand.type);
+
+  switch(condition.op) {
+    case MATCH_EQ:
+      return result == 0;
+    case MATCH_GT:
+      return result > 0;
+    case MATCH_GTE:
+      return result >= 0;
+    case MATCH_LT:
+      return result < 0;
+    default:
+      return result <= 0;
+  }
+}
+
+// A missing field is null to $eq, $gte, $lte and $in
+var matchMissing = function(condition) {
+  if(condition.op == MATCH_IN) {
+    return eachElement(condition.operand.data, condition.operand.index, function(item) {
+      return item.type == BSON.BSON_DATA_NULL;
+    });
+  }
+
+  return condition.operand != null && condition.operand.type == BSON.BSON_DATA_NULL
+    && (condition.op == MATCH_EQ || condition.op == MATCH_GTE || condition.op == MATCH_LTE);
+}
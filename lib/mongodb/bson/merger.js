@@ -0,0 +1,272 @@
+var BSON = require('./bson').BSON;
+
+var illegalSort = "Illegal sort clause, must be of the form " +
+  "[['field1', '(ascending|descending)'], ['field2', '(ascending|descending)']]";
+
+// The key of a document missing a field of the sort
+var nullKey = {type:BSON.BSON_DATA_NULL, data:null, index:0};
+// The key of an empty array, no type has its rank so it sorts after MinKey and before null like on the server
+var emptyArrayKey = {type:0, data:null, index:0};
+
+/**
+ * A sort compiled once to compare and merge serialized documents without deserializing them.
+ *
+ * Documents are ordered the way the server sorts them: values of different types by the
+ * rank of their type, an array field by its smallest element ascending and its largest
+ * descending, and a missing field as null. Without a sort whole documents are compared.
+ *
+ * @param sort {?string|Array|Object} The sort, in any of the forms Cursor#sort takes.
+ */
+var Merger = exports.Merger = function(sort) {
+  this.fields = [];
+
+  if(sort == null) {
+    // Whole documents
+  } else if(typeof sort == 'string') {
+    this.addField(sort, 1);
+  } else if(Array.isArray(sort)) {
+    for(var i = 0; i < sort.length; i++) {
+      if(typeof sort[i] == 'string') {
+        this.addField(sort[i], 1);
+      } else if(Array.isArray(sort[i])) {
+        this.addField(sort[i][0], sort[i][1]);
+      } else {
+        throw new Error(illegalSort);
+      }
+    }
+  } else if(typeof sort == 'object' && !(sort instanceof Buffer)) {
+    for(var name in sort) {
+      this.addField(name, sort[name]);
+    }
+  } else {
+    throw new Error(illegalSort);
+  }
+}
+
+/**
+ * Compare two serialized documents by the sort.
+ *
+ * @param a {Buffer} The first document.
+ * @param b {Buffer} The second document.
+ * @return {number} -1, 0 or 1 as the first document sorts before, with or after the second.
+ */
+Merger.prototype.compare = function(a, b) {
+  documentEnd(a, 0);
+  documentEnd(b, 0);
+  if(this.fields.length == 0) return BSON.compareDocuments(a, 0, b, 0);
+  return this.compareKeys(this.findKeys(a), this.findKeys(b));
+}
+
+/**
+ * Merge arrays of serialized documents, each sorted by the sort, into one sorted array
+ * of the same Buffers. Documents sorting together keep the order of their arrays.
+ *
+ * @param streams {Array<Array<Buffer>>} The sorted documents of each stream.
+ * @param limit {?number} The most documents to merge, 0 or none merges them all.
+ * @return {Array<Buffer>} The documents in sorted order.
+ */
+Merger.prototype.merge = function(streams, limit) {
+  var self = this;
+  limit = limit ? limit : Infinity;
+  var merged = [];
+
+  // A head per stream in a binary heap of the streams left, the smallest document on top
+  var heap = [];
+  for(var i = 0; i < streams.length; i++) {
+    if(!Array.isArray(streams[i])) throw new Error("Expected an array of documents for each stream");
+    var head = {stream:i, position:0, documents:streams[i], keys:null};
+    if(this.load(head)) heap.push(head);
+  }
+
+  for(var i = Math.floor(heap.length / 2); i > 0; i--) {
+    this.siftDown(heap, i - 1);
+  }
+
+  while(heap.length > 0 && merged.length < limit) {
+    var head = heap[0];
+    merged.push(head.documents[head.position]);
+
+    // Move on in the stream, dropping it once it runs out
+    head.position = head.position + 1;
+    if(!this.load(head)) {
+      var last = heap.pop();
+      if(heap.length > 0) heap[0] = last;
+    }
+    this.siftDown(heap, 0);
+  }
+
+  return merged;
+}
+
+/**
+ * Append a field of the sort, the direction takes the values Cursor#formatSortValue does.
+ *
+ * @ignore
+ * @api private
+ */
+Merger.prototype.addField = function(name, direction) {
+  var value = ("" + direction).toLowerCase();
+  if(value == 'ascending' || value == 'asc' || value == 1) {
+    direction = 1;
+  } else if(value == 'descending' || value == 'desc' || value == -1) {
+    direction = -1;
+  } else {
+    throw new Error(illegalSort);
+  }
+
+  this.fields.push({path:("" + name).split('.'), direction:direction});
+}
+
+/**
+ * Pick the sort key of the document at the start of data, one element per field.
+ *
+ * @ignore
+ * @api private
+ */
+Merger.prototype.findKeys = function(data) {
+  var keys = new Array(this.fields.length);
+
+  for(var i = 0; i < this.fields.length; i++) {
+    var key = {found:null};
+    findKey(this.fields[i], data, 0, 0, key);
+    keys[i] = key.found == null ? nullKey : key.found;
+  }
+
+  return keys;
+}
+
+/**
+ * @ignore
+ * @api private
+ */
+Merger.prototype.compareKeys = function(a, b) {
+  for(var i = 0; i < this.fields.length; i++) {
+    var result = BSON.compareValues(a[i].data, a[i].index, a[i].type, b[i].data, b[i].index, b[i].type);
+    if(result != 0) return result * this.fields[i].direction;
+  }
+
+  return 0;
+}
+
+/**
+ * Read the document at the position of the head in its stream, returns false at the end of the stream.
+ *
+ * @ignore
+ * @api private
+ */
+Merger.prototype.load = function(head) {
+  if(head.position >= head.documents.length) return false;
+
+  var document = head.documents[head.position];
+  if(!(document instanceof Buffer)) throw new Error("Expected a buffer for each document");
+  documentEnd(document, 0);
+  if(this.fields.length > 0) head.keys = this.findKeys(document);
+  return true;
+}
+
+/**
+ * Move the head at index down the heap until the heads below it sort after it.
+ *
+ * @ignore
+ * @api private
+ */
+Merger.prototype.siftDown = function(heap, index) {
+  while(2 * index + 1 < heap.length) {
+    var child = 2 * index + 1;
+    if(child + 1 < heap.length && this.compareHeads(heap[child + 1], heap[child]) < 0) child = child + 1;
+    if(this.compareHeads(heap[index], heap[child]) <= 0) return;
+
+    var head = heap[index];
+    heap[index] = heap[child];
+    heap[child] = head;
+    index = child;
+  }
+}
+
+/**
+ * Order the heads by their documents, then by their streams.
+ *
+ * @ignore
+ * @api private
+ */
+Merger.prototype.compareHeads = function(a, b) {
+  var result = this.fields.length == 0
+    ? BSON.compareDocuments(a.documents[a.position], 0, b.documents[b.position], 0)
+    : this.compareKeys(a.keys, b.keys);
+  if(result != 0) return result;
+  return a.stream < b.stream ? -1 : (a.stream > b.stream ? 1 : 0);
+}
+
+// The index of the last byte of the document at index
+var documentEnd = function(data, index) {
+  var size = readInt32(data, index);
+  if(index + 5 > data.length || size < 5 || index + size > data.length || data[index + size - 1] !== 0) {
+    throw new Error("Corrupt BSON document");
+  }
+
+  return index + size - 1;
+}
+
+var readInt32 = function(data, index) {
+  return data[index] | data[index + 1] << 8 | data[index + 2] << 16 | data[index + 3] << 24;
+}
+
+// Call fn with each element of the document at index
+var eachElement = function(data, index, fn) {
+  var end = documentEnd(data, index);
+  index = index + 4;
+
+  while(index < end) {
+    var type = data[index];
+    var nameEnd = index + 1;
+    while(nameEnd < end && data[nameEnd] !== 0) nameEnd++;
+    if(nameEnd >= end) throw new Error("Corrupt BSON document");
+    var size = BSON.valueSize(data, nameEnd + 1, type, end);
+    if(size == -1) throw new Error("Corrupt BSON document");
+
+    if(fn({type:type, name:data.toString('utf8', index + 1, nameEnd), data:data, index:nameEnd + 1})) return;
+    index = nameEnd + 1 + size;
+  }
+}
+
+// Offer the values at the path of a field from depth on in the document at index as its key.
+// The elements of an array are offered one by one, as are the fields of the documents embedded
+// in an array on the path unless it's followed by a number picking one of the elements. A
+// missing field is null, an empty array sorts before it
+var findKey = function(field, data, index, depth, key) {
+  var element = null;
+  eachElement(data, index, function(item) {
+    if(item.name == field.path[depth]) element = item;
+    return element != null;
+  });
+
+  if(element == null) return offerKey(field, nullKey, key);
+
+  if(depth == field.path.length - 1) {
+    if(element.type != BSON.BSON_DATA_ARRAY) return offerKey(field, element, key);
+    if(readInt32(data, element.index) <= 5) return offerKey(field, emptyArrayKey, key);
+    return eachElement(data, element.index, function(item) {
+      offerKey(field, item, key);
+    });
+  }
+
+  if(element.type == BSON.BSON_DATA_OBJECT) return findKey(field, data, element.index, depth + 1, key);
+  if(element.type != BSON.BSON_DATA_ARRAY) return offerKey(field, nullKey, key);
+  if(/^[0-9]/.test(field.path[depth + 1])) return findKey(field, data, element.index, depth + 1, key);
+
+  var embedded = false;
+  eachElement(data, element.index, function(item) {
+    if(item.type != BSON.BSON_DATA_OBJECT) return;
+    embedded = true;
+    findKey(field, data, item.index, depth + 1, key);
+  });
+
+  if(!embedded) offerKey(field, nullKey, key);
+}
+
+// Keep the smallest value offered for an ascending field and the largest for a descending one
+var offerKey = function(field, candidate, key) {
+  if(key.found != null && BSON.compareValues(candidate.data, candidate.index, candidate.type,
+    key.found.data, key.found.index, key.found.type) * field.direction >= 0) return;
+  key.found = candidate;
+}
@@ -8,6 +8,7 @@ var InsertCommand = require('./commands/insert_command').InsertCommand
   , DbCommand = require('./commands/db_command').DbCommand
   , BinaryParser = require('./bson/binary_parser').BinaryParser
   , Cursor = require('./cursor').Cursor
+  , PreparedQuery = require('./prepared_query').PreparedQuery
   , debug = require('util').debug
   , inspect = require('util').inspect;
 
@@ -302,7 +303,15 @@ Collection.prototype.insertAll = function insertAll (docs, options, callback) {
         commandOptions[keys[i]] = errorOptions[keys[i]];
       }
     }
+  }
+
+  // Merge the insert with the others of this tick if the db coalesces inserts. The merged command keeps
+  // going past errors, so an insert of several documents that has to stop at its first error goes alone
+  if(this.db.insertCoalescer != null && (docs.length == 1 || insertFlags['keepGoing'])) {
+    return this.db.insertCoalescer.add(insertCommand.collectionName, docs, insertFlags, commandOptions, callback);
+  }
 
+  if(commandOptions['safe']) {
     // Execute command with safe options (rolls up both command and safe command into one and executes them on the same connection)
     this.db._executeInsertCommand(insertCommand, commandOptions, function (err, error) {
       error = error && error.documents;
@@ -630,7 +639,7 @@ Collection.prototype.findAndModify = function findAndModify (query, sort, doc, o
  * 6 selector, fields, skip, limit, timeout, callback?
  *
  * Available options:
- * limit, sort, fields, skip, hint, explain, snapshot, timeout, tailable, batchSize
+ * limit, sort, fields, skip, hint, explain, snapshot, timeout, tailable, batchSize, raw, prefetch, decodeFields, filter
  */
 
 Collection.prototype.find = function find () {
@@ -651,7 +660,7 @@ Collection.prototype.find = function find () {
 
   if (len === 2) {
     // backwards compat for options object
-    var test = ['limit','sort','fields','skip','hint','explain','snapshot','timeout','tailable', 'batchSize', 'raw']
+    var test = ['limit','sort','fields','skip','hint','explain','snapshot','timeout','tailable', 'batchSize', 'raw', 'prefetch', 'decodeFields', 'filter']
       , is_option = false;
 
     for (var idx = 0, l = test.length; idx < l; ++idx) {
@@ -730,9 +739,9 @@ Collection.prototype.find = function find () {
   // callback for backward compatibility
   if (callback) {
     // TODO refactor Cursor args
-    callback(null, new Cursor(this.db, this, selector, fields, o.skip, o.limit, o.sort, o.hint, o.explain, o.snapshot, o.timeout, o.tailable, o.batchSize, o.slaveOk, o.raw));
+    callback(null, new Cursor(this.db, this, selector, fields, o.skip, o.limit, o.sort, o.hint, o.explain, o.snapshot, o.timeout, o.tailable, o.batchSize, o.slaveOk, o.raw, o.prefetch, o.decodeFields, o.filter));
   } else {
-    return new Cursor(this.db, this, selector, fields, o.skip, o.limit, o.sort, o.hint, o.explain, o.snapshot, o.timeout, o.tailable, o.batchSize, o.slaveOk, o.raw);
+    return new Cursor(this.db, this, selector, fields, o.skip, o.limit, o.sort, o.hint, o.explain, o.snapshot, o.timeout, o.tailable, o.batchSize, o.slaveOk, o.raw, o.prefetch, o.decodeFields, o.filter);
   }
 };
 
@@ -922,6 +931,22 @@ Collection.prototype.findOne = function findOne () {
   // }
 };
 
+/**
+ * Prepare a query of a fixed shape to run with different values, the selector
+ * is serialized once and the values are written into a copy of it on each run.
+ *
+ *   var byEmail = collection.prepareFind({email:PreparedQuery.param('email'), active:true}, {limit:1});
+ *   byEmail.findOne({email:'a@b.c'}, function(err, doc) {});
+ *
+ * @param {Object} shape the selector with PreparedQuery.param(name) in place of the values that change
+ * @param {Object} options the options of find except for the ones taking a callback
+ * @return {PreparedQuery}
+ */
+
+Collection.prototype.prepareFind = function prepareFind (shape, options) {
+  return new PreparedQuery(this, shape, options);
+};
+
 /**
  * Creates an index on this collection.
  *
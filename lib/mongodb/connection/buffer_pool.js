@@ -0,0 +1,119 @@
+var Buffer = require('buffer').Buffer;
+
+/**
+ * Pool of receive buffers shared by the connections of a ConnectionPool.
+ *
+ * Buffers are kept in power of two size classes. A lease hands out a slice of
+ * exactly the requested size backed by a pooled buffer of the next class up,
+ * releasing the slice puts the backing buffer back for the next reply of a
+ * similar size. The pool never holds more than maxPooledBytes, buffers
+ * released past that are left to the garbage collector.
+ *
+ * @param maxPooledBytes {number} The most bytes kept in the pool, 0 disables pooling.
+ */
+var BufferPool = exports.BufferPool = function(maxPooledBytes) {
+  this.maxPooledBytes = maxPooledBytes == null ? BufferPool.DEFAULT_MAX_POOLED_BYTES : maxPooledBytes;
+  // Free buffers by size class
+  this.classes = {};
+  this.pooledBytes = 0;
+
+  // Metrics
+  this.hits = 0;
+  this.misses = 0;
+  this.released = 0;
+  this.discarded = 0;
+}
+
+/**
+ * Lease a buffer of the given size.
+ *
+ * @param size {number} The size of the buffer.
+ * @return {Buffer} A buffer of exactly size bytes, hand it back with release.
+ */
+BufferPool.prototype.lease = function(size) {
+  var classSize = BufferPool.classSize(size);
+  // Sizes outside the classes are allocated as is
+  if(classSize == 0 || this.maxPooledBytes == 0) {
+    this.misses = this.misses + 1;
+    return new Buffer(size);
+  }
+
+  var free = this.classes[classSize];
+  var backing = null;
+
+  if(free != null && free.length > 0) {
+    backing = free.pop();
+    this.pooledBytes = this.pooledBytes - classSize;
+    this.hits = this.hits + 1;
+  } else {
+    backing = new Buffer(classSize);
+    this.misses = this.misses + 1;
+  }
+
+  var buffer = backing.slice(0, size);
+  buffer._poolBuffer = backing;
+  return buffer;
+}
+
+/**
+ * Hand a leased buffer back to the pool. Nothing may hold on to the buffer or a
+ * slice of it after it is released. Buffers that were not leased are ignored.
+ *
+ * @param buffer {Buffer} The leased buffer.
+ */
+BufferPool.prototype.release = function(buffer) {
+  if(buffer == null || buffer._poolBuffer == null) return;
+
+  var backing = buffer._poolBuffer;
+  // Make sure a buffer is only put back once
+  buffer._poolBuffer = null;
+
+  if(this.pooledBytes + backing.length > this.maxPooledBytes) {
+    this.discarded = this.discarded + 1;
+    return;
+  }
+
+  if(this.classes[backing.length] == null) this.classes[backing.length] = [];
+  this.classes[backing.length].push(backing);
+  this.pooledBytes = this.pooledBytes + backing.length;
+  this.released = this.released + 1;
+}
+
+/**
+ * Drop all the pooled buffers.
+ */
+BufferPool.prototype.clear = function() {
+  this.classes = {};
+  this.pooledBytes = 0;
+}
+
+/**
+ * @return {object} The pool metrics, hits and misses count the leases served from
+ *     and outside the pool, released and discarded the buffers handed back that were
+ *     kept and dropped, pooledBytes is the size of the free buffers held.
+ */
+BufferPool.prototype.stats = function() {
+  return {hits:this.hits, misses:this.misses, released:this.released, discarded:this.discarded, pooledBytes:this.pooledBytes};
+}
+
+/**
+ * @return {number} The size class for a buffer of the given size or 0 if it's not pooled.
+ */
+BufferPool.classSize = function(size) {
+  if(size > BufferPool.MAX_CLASS_SIZE) return 0;
+  var classSize = BufferPool.MIN_CLASS_SIZE;
+  while(classSize < size) classSize = classSize * 2;
+  return classSize;
+}
+
+/**
+ * Smallest and largest pooled buffer
+ * @constant
+ */
+BufferPool.MIN_CLASS_SIZE = 1024;
+BufferPool.MAX_CLASS_SIZE = 1024 * 1024 * 4;
+/**
+ * Default bytes kept in a pool
+ * @constant
+ */
+BufferPool.DEFAULT_MAX_POOLED_BYTES = 1024 * 1024 * 16;
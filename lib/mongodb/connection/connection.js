@@ -10,7 +10,13 @@ var utils = require('./connection_utils'),
 // Set max bson size
 global.DEFAULT_MAX_BSON_SIZE = 4 * 1024 * 1024 * 4 * 3;
 
-var Connection = exports.Connection = function(id, socketOptions) {
+// Marks the data of a socket chunk as fully parsed
+var EMPTY_BUFFER = new Buffer(0);
+// Op codes of the requests the server replies to
+var OP_QUERY = 2004;
+var OP_GET_MORE = 2005;
+
+var Connection = exports.Connection = function(id, socketOptions, bufferPool) {
   // Store all socket options
   this.socketOptions = socketOptions ? socketOptions : {host:'localhost', port:27017};
   // Id for the connection
@@ -31,6 +37,31 @@ var Connection = exports.Connection = function(id, socketOptions) {
   this.bytesRead = 0;
   // Contains spill over bytes from additional messages
   this.stubBuffer = 0;
+  // Pool the buffers of replies split over several socket chunks are leased from
+  this.bufferPool = bufferPool;
+
+  //
+  // Load of the connection, the requests written that still wait for a reply
+  //
+
+  this.requestsInFlight = 0;
+  this.bytesInFlight = 0;
+  // Size of each request waiting for a reply by request id
+  this.pendingRequests = {};
+
+  //
+  // Messages of the current tick held back to go out in one socket write
+  //
+
+  this.writeBatchSize = socketOptions.writeBatchSize != null ? socketOptions.writeBatchSize : Connection.DEFAULT_WRITE_BATCH_SIZE;
+  this.writeQueue = [];
+  this.writeQueueBytes = 0;
+  // Callbacks of the writes in the queue, told about a failed socket write
+  this.writeCallbacks = [];
+  this.flushScheduled = false;
+  // Socket writes and messages written
+  this.writes = 0;
+  this.messagesWritten = 0;
 
   // Just keeps list of events we allow
   resetHandlers(this, false);
@@ -39,6 +70,9 @@ var Connection = exports.Connection = function(id, socketOptions) {
 // Inherit event emitter so we can emit stuff wohoo
 inherits(Connection, EventEmitter);
 
+// Bytes of messages held back in a tick by default
+Connection.DEFAULT_WRITE_BATCH_SIZE = 1024 * 64;
+
 Connection.prototype.start = function() {
   // Set up event emitter
   EventEmitter.call(this);  
@@ -59,24 +93,106 @@ Connection.prototype.isConnected = function() {
   return this.connected;
 }
 
-// Write the data out to the socket
+// Write the data out to the socket, the messages of a tick go out together
 Connection.prototype.write = function(command, callback) {
   try {
+    if(typeof callback === 'function') this.writeCallbacks.push(callback);
     // If we have a list off commands to be executed on the same socket
     if(Array.isArray(command)) {
       for(var i = 0; i < command.length; i++) {
-        var t = this.connection.write(command[i].toBinary());
+        var binary = command[i].toBinary();
+        trackRequest(this, binary);
+        queueWrite(this, binary);
       }
     } else {
-      var r = this.connection.write(command.toBinary());    
+      var binary = command.toBinary();
+      trackRequest(this, binary);
+      queueWrite(this, binary);
     }    
   } catch (err) {    
     if(typeof callback === 'function') callback(err);    
   }
 }
 
+// Socket writes and the messages they carried
+Connection.prototype.writeStats = function() {
+  return {writes:this.writes, messages:this.messagesWritten};
+}
+
+// Hold a message back until the end of the tick or until the queue reaches the batch size
+var queueWrite = function(self, binary) {
+  self.writeQueue.push(binary);
+  self.writeQueueBytes = self.writeQueueBytes + binary.length;
+
+  if(self.writeQueueBytes >= self.writeBatchSize) {
+    flushWrites(self);
+  } else if(!self.flushScheduled) {
+    self.flushScheduled = true;
+    process.nextTick(function() {
+      self.flushScheduled = false;
+      flushWrites(self);
+    });
+  }
+}
+
+// Write all the queued messages in one socket write
+var flushWrites = function(self) {
+  var queue = self.writeQueue;
+  var callbacks = self.writeCallbacks;
+  if(queue.length == 0) return;
+
+  var data = queue[0];
+  // Concatenate the messages
+  if(queue.length > 1) {
+    data = new Buffer(self.writeQueueBytes);
+    for(var i = 0, index = 0; i < queue.length; i++) {
+      queue[i].copy(data, index);
+      index = index + queue[i].length;
+    }
+  }
+
+  self.writeQueue = [];
+  self.writeQueueBytes = 0;
+  self.writeCallbacks = [];
+
+  try {
+    self.connection.write(data);
+    self.writes = self.writes + 1;
+    self.messagesWritten = self.messagesWritten + queue.length;
+  } catch (err) {
+    for(var i = 0; i < callbacks.length; i++) callbacks[i](err);
+  }
+}
+
+// Account for a reply to one of the requests in flight, takes the reply message
+Connection.prototype.replyReceived = function(message) {
+  var responseTo = binaryutils.decodeUInt32(message, 8);
+  var size = this.pendingRequests[responseTo];
+  if(size == null) return;
+
+  delete this.pendingRequests[responseTo];
+  this.requestsInFlight = this.requestsInFlight - 1;
+  this.bytesInFlight = this.bytesInFlight - size;
+}
+
+// Queries and getMores are answered by a reply, track them until it arrives
+var trackRequest = function(self, binary) {
+  var opCode = binaryutils.decodeUInt32(binary, 12);
+  if(opCode != OP_QUERY && opCode != OP_GET_MORE) return;
+
+  self.pendingRequests[binaryutils.decodeUInt32(binary, 4)] = binary.length;
+  self.requestsInFlight = self.requestsInFlight + 1;
+  self.bytesInFlight = self.bytesInFlight + binary.length;
+}
+
 // Force the closure of the connection
 Connection.prototype.close = function() {
+  // Messages of this tick still go out
+  if(this.connected) flushWrites(this);
+  // No replies will arrive anymore
+  this.pendingRequests = {};
+  this.requestsInFlight = 0;
+  this.bytesInFlight = 0;
   // clear out all the listeners
   resetHandlers(this, true);
   // destroy connection
@@ -138,7 +254,7 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
           self.bytesRead = self.bytesRead + data.length;
 
           // Reset state of buffer
-          data = new Buffer(0);
+          data = EMPTY_BUFFER;
         } else {
           // Copy the missing part of the data into our current buffer
           data.copy(self.buffer, self.bytesRead, 0, remainingBytesToRead);
@@ -151,7 +267,7 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
             
           } catch(err) {
             // We got a parse Error fire it off then keep going
-            self.emit("parseError", {err:"socketHandler", trace:err, bin:buffer, parseState:{
+            self.emit("parseError", {err:"socketHandler", trace:err, bin:self.buffer, parseState:{
               sizeOfMessage:self.sizeOfMessage, 
               bytesRead:self.bytesRead,
               stubBuffer:self.stubBuffer}});
@@ -170,19 +286,35 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
 
           // If we have enough bytes to determine the message size let's do it
           if(self.stubBuffer.length + data.length > 4) {            
-            // Prepad the data
-            var newData = new Buffer(self.stubBuffer.length + data.length);
-            self.stubBuffer.copy(newData, 0);
-            data.copy(newData, self.stubBuffer.length);
-            // Reassign for parsing
-            data = newData;
-
-            // Reset state of buffer
-            self.buffer = null;
-            self.sizeOfMessage = 0;
-            self.bytesRead = 0;
-            self.stubBuffer = null;
+            // Read the size across the stub and the new data instead of joining them
+            var sizeOfMessage = 0;
+            for(var i = 3; i >= 0; i--) {
+              sizeOfMessage = (sizeOfMessage << 8) | (i < self.stubBuffer.length ? self.stubBuffer[i] : data[i - self.stubBuffer.length]);
+            }
+
+            if(sizeOfMessage > 4 && sizeOfMessage < self.maxBsonSize) {
+              // Start the message with the stub bytes, the loop copies in the rest
+              self.buffer = leaseBuffer(self, sizeOfMessage);
+              self.stubBuffer.copy(self.buffer, 0);
+              self.bytesRead = self.stubBuffer.length;
+              self.sizeOfMessage = sizeOfMessage;
+              self.stubBuffer = null;
+            } else {
+              // We got a parse Error fire it off then keep going
+              self.emit("parseError", {err:"socketHandler", trace:null, bin:data, parseState:{
+                sizeOfMessage:sizeOfMessage, 
+                bytesRead:0,
+                buffer:null,                
+                stubBuffer:self.stubBuffer}});     
 
+              // Clear out the state of the parser           
+              self.buffer = null;
+              self.sizeOfMessage = 0;
+              self.bytesRead = 0;
+              self.stubBuffer = null;
+              // Exit parsing loop
+              data = EMPTY_BUFFER;
+            }
           } else {
 
             // Add the the bytes to the stub buffer
@@ -191,8 +323,9 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
             self.stubBuffer.copy(newStubBuffer, 0);
             // Copy missing part of the data
             data.copy(newStubBuffer, self.stubBuffer.length);
+            self.stubBuffer = newStubBuffer;
             // Exit parsing loop
-            data = new Buffer(0);
+            data = EMPTY_BUFFER;
           }
         } else {
           if(data.length > 4) {
@@ -201,7 +334,7 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
 
             // Ensure that the size of message is larger than 0 and less than the max allowed
             if(sizeOfMessage > 4 && sizeOfMessage < self.maxBsonSize && sizeOfMessage > data.length) {
-              self.buffer = new Buffer(sizeOfMessage);
+              self.buffer = leaseBuffer(self, sizeOfMessage);
               // Copy all the data into the buffer
               data.copy(self.buffer, 0);
               // Update bytes read
@@ -211,7 +344,7 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
               // Ensure stub buffer is null
               self.stubBuffer = null;
               // Exit parsing loop
-              data = new Buffer(0);
+              data = EMPTY_BUFFER;
               
             } else if(sizeOfMessage > 4 && sizeOfMessage < self.maxBsonSize && sizeOfMessage == data.length) {
               try {
@@ -222,7 +355,7 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
                 self.bytesRead = 0;
                 self.stubBuffer = null;
                 // Exit parsing loop
-                data = new Buffer(0);
+                data = EMPTY_BUFFER;
                 
               } catch (err) {
                 // We got a parse Error fire it off then keep going
@@ -245,7 +378,7 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
               self.bytesRead = 0;
               self.stubBuffer = null;
               // Exit parsing loop
-              data = new Buffer(0);
+              data = EMPTY_BUFFER;
 
             } else {
               self.emit("message", data.slice(0, sizeOfMessage));
@@ -265,7 +398,7 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
             // Copy the data to the stub buffer
             data.copy(self.stubBuffer, 0);
             // Exit parsing loop
-            data = new Buffer(0);
+            data = EMPTY_BUFFER;
           }
         }
       }      
@@ -273,6 +406,11 @@ var createDataHandler = exports.Connection.createDataHandler = function(self) {
   }
 }
 
+// Lease the buffer for a message from the pool if the connection has one
+var leaseBuffer = function(self, size) {
+  return self.bufferPool != null ? self.bufferPool.lease(size) : new Buffer(size);
+}
+
 var endHandler = function(self) {
   return function() {
     // Set connected to false
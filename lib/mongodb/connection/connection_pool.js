@@ -4,6 +4,7 @@ var utils = require('./connection_utils'),
   EventEmitter = require('events').EventEmitter,
   inherits = require('util').inherits,
   MongoReply = require("../responses/mongo_reply").MongoReply,
+  BufferPool = require("./buffer_pool").BufferPool,
   Connection = require("./connection").Connection;
 
 var ConnectionPool = exports.ConnectionPool = function(host, port, poolSize, bson, socketOptions) {
@@ -35,6 +36,13 @@ var ConnectionPool = exports.ConnectionPool = function(host, port, poolSize, bso
   utils.setStringParameter(this.socketOptions, 'encoding', null);
   // Allows you to set a throttling bufferSize if you need to stop overflows
   utils.setIntegerParameter(this.socketOptions, 'bufferSize', 0);  
+  // Bytes of receive buffers kept for reuse, 0 disables the pool
+  utils.setIntegerParameter(this.socketOptions, 'bufferPoolSize', BufferPool.DEFAULT_MAX_POOLED_BYTES);
+  // Bytes of messages written together at the end of a tick, 0 writes each message right away
+  utils.setIntegerParameter(this.socketOptions, 'writeBatchSize', Connection.DEFAULT_WRITE_BATCH_SIZE);
+  
+  // Receive buffers shared by all the connections
+  this.bufferPool = new BufferPool(this.socketOptions.bufferPoolSize);
   
   // Internal structures
   this.waitingToOpen = {};
@@ -134,7 +142,7 @@ ConnectionPool.prototype.start = function() {
   // Let's boot up all the instances
   for(var i = 0; i < this.socketOptions.poolSize; i++) {    
     // Create a new connection instance
-    var connection = new Connection(this.connectionId++, this.socketOptions);
+    var connection = new Connection(this.connectionId++, this.socketOptions, this.bufferPool);
     // Add connection to list of waiting connections
     this.waitingToOpen[connection.id] = connection;    
     connection.on("connect", connectHandler(this));
@@ -152,6 +160,8 @@ ConnectionPool.prototype.start = function() {
     });    
     
     connection.on("message", function(message) {  
+      // Reply arrived, update the load of the connection
+      this.replyReceived(message);
       self.emit("message", message);
     });
     
@@ -198,6 +208,8 @@ ConnectionPool.prototype.stop = function() {
   this.waitingToOpen = {};
   this.connectionsWithErrors = {};
   this.openConnections = {};   
+  // Drop the pooled receive buffers
+  this.bufferPool.clear();
 
   // Emit a close event so people can track the event
   this.emit("close");
@@ -215,9 +227,43 @@ ConnectionPool.prototype.isConnected = function() {
 ConnectionPool.prototype.checkoutConnection = function(id) {
   // If we have an id return that specific connection
   if(id != null) return this.openConnections[id];
-  // Otherwise let's pick one using roundrobin
+  // Otherwise pick the connection with the least requests in flight, ties go to the one
+  // with the fewest bytes in flight. Start at the next connection in roundrobin order
+  // so idle connections are used in turn
   var keys = Object.keys(this.openConnections);
-  return this.openConnections[(keys[(this.currentConnectionIndex++ % keys.length)])]
+  var start = this.currentConnectionIndex++ % keys.length;
+  var selected = this.openConnections[keys[start]];
+
+  for(var i = 1; i < keys.length; i++) {
+    var connection = this.openConnections[keys[(start + i) % keys.length]];
+
+    if(connection.requestsInFlight < selected.requestsInFlight
+      || (connection.requestsInFlight == selected.requestsInFlight && connection.bytesInFlight < selected.bytesInFlight)) {
+      selected = connection;
+    }
+  }
+
+  return selected;
+}
+
+// Queue depth of each open connection, the requests and bytes waiting for a reply, and
+// the socket writes and messages written
+ConnectionPool.prototype.connectionStats = function() {
+  var keys = Object.keys(this.openConnections);
+  var stats = [];
+
+  for(var i = 0; i < keys.length; i++) {
+    var connection = this.openConnections[keys[i]];
+    stats.push({id:connection.id, requestsInFlight:connection.requestsInFlight, bytesInFlight:connection.bytesInFlight,
+      writes:connection.writes, messagesWritten:connection.messagesWritten});
+  }
+
+  return stats;
+}
+
+// Hit and miss metrics of the receive buffer pool
+ConnectionPool.prototype.bufferPoolStats = function() {
+  return this.bufferPool.stats();
 }
 
 ConnectionPool.prototype.getAllConnections = function() {
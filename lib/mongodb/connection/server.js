@@ -75,7 +75,8 @@ Server.prototype.connect = function(dbInstance, options, callback) {
   // Ensure dbInstance can do a slave query if it's set
   dbInstance.slaveOk = this.slaveOk ? this.slaveOk : dbInstance.slaveOk;
   // Create connection Pool instance with the current BSON serializer
-  var connectionPool = new ConnectionPool(this.host, this.port, this.poolSize, dbInstance.bson_deserializer);
+  var connectionPool = new ConnectionPool(this.host, this.port, this.poolSize, dbInstance.bson_deserializer,
+    {bufferPoolSize:this.options.bufferPoolSize, writeBatchSize:this.options.writeBatchSize});
   
   // Set up a new pool using default settings
   server.connectionPool = connectionPool;
@@ -137,6 +138,8 @@ Server.prototype.connect = function(dbInstance, options, callback) {
           // Emit the error
           eventReceiver.emit("error", new Error("bson length is different from message length"));        
         } else {
+          // Raw documents are slices of the message and the pure js parser slices Binary data out of it
+          var messageRetained = false;
           // Attempt to locate a callback instance
           for(var i = 0; i < server.dbInstances.length; i++) {
             var dbInstanceObject = server.dbInstances[i];
@@ -145,7 +148,9 @@ Server.prototype.connect = function(dbInstance, options, callback) {
             // Only execute callback if we have a caller
             if(typeof callbackInfo.callback === 'function') {
               // Parse the body
-              mongoReply.parseBody(message, connectionPool.bson, callbackInfo.info.raw);          
+              var deserializeOptions = callbackInfo.info.deserializeOptions != null ? callbackInfo.info.deserializeOptions : dbInstanceObject.deserializeOptions;
+              mongoReply.parseBody(message, connectionPool.bson, callbackInfo.info.raw, deserializeOptions);          
+              messageRetained = messageRetained || callbackInfo.info.raw || !dbInstanceObject.native_parser;
               // Get the callback instance
               var callbackInstance = dbInstanceObject._removeHandler(mongoReply.responseTo);
               // Only call if we have an actual callback instance, might have been removed by the reaper
@@ -157,6 +162,9 @@ Server.prototype.connect = function(dbInstance, options, callback) {
               }              
             }
           }
+
+          // Nothing references the message anymore, hand it back for the next reply
+          if(!messageRetained) connectionPool.bufferPool.release(message);
         }        
       } catch (err) {
         // Force close the pool
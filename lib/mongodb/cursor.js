@@ -31,6 +31,16 @@ var QueryCommand = require('./commands/query_command').QueryCommand,
  *     to return for every request. This should initially be greater than 1 otherwise
  *     the database will automatically close the cursor. The batch size can be set to 1
  *     with {@link Cursor#batchSize} after performing the initial query to the database.
+ * @param slaveOk {?boolean}
+ * @param raw {?boolean} Return the documents as serialized BSON Buffers.
+ * @param prefetch {?number} The number of batches to fetch ahead with getMore while the
+ *     current batch is consumed. Defaults to 0, only fetching when a batch is used up.
+ * @param decodeFields {?Array<string>|Object} The top level fields to decode from the returned
+ *     documents, the others are skipped while decoding. Unlike fields the server still returns
+ *     whole documents, so this is for client side filtering reading a few fields of wide documents.
+ * @param filter {?Object} A query the returned documents are tested with before they are decoded, the
+ *     documents not matching it are dropped. Compiled once into a Matcher, see it for the operators
+ *     supported. Skip and limit count the documents the server returns, before they are filtered.
  *
  * @see Cursor#toArray
  * @see Cursor#skip
@@ -40,7 +50,7 @@ var QueryCommand = require('./commands/query_command').QueryCommand,
  * @see Collection#find
  * @see Db#eval
  */
-var Cursor = exports.Cursor = function(db, collection, selector, fields, skip, limit, sort, hint, explain, snapshot, timeout, tailable, batchSize, slaveOk, raw) {
+var Cursor = exports.Cursor = function(db, collection, selector, fields, skip, limit, sort, hint, explain, snapshot, timeout, tailable, batchSize, slaveOk, raw, prefetch, decodeFields, filter) {
   this.db = db;
   this.collection = collection;
   this.selector = selector;
@@ -56,10 +66,31 @@ var Cursor = exports.Cursor = function(db, collection, selector, fields, skip, l
   this.batchSizeValue = batchSize == null ? 0 : batchSize;
   this.slaveOk = slaveOk == null ? collection.slaveOk : slaveOk;
   this.raw = raw == null ? false : raw;
+  this.prefetchValue = prefetch == null || tailable ? 0 : prefetch;
+  // Decode options for the replies narrowed down to the decode projection and filter, the db options are used without them
+  this.deserializeOptions = decodeFields == null && filter == null ? null : {
+    rawTimestamps: db.deserializeOptions.rawTimestamps,
+    rawDates: db.deserializeOptions.rawDates,
+    internStrings: db.deserializeOptions.internStrings,
+    externalStringThreshold: db.deserializeOptions.externalStringThreshold,
+    cacheRegExps: db.deserializeOptions.cacheRegExps,
+    fields: decodeFields == null ? null
+      : Array.isArray(decodeFields) ? decodeFields : Object.keys(decodeFields).filter(function(name) { return decodeFields[name]; }),
+    matcher: filter == null ? null : new db.bson_serializer.Matcher(filter)
+  };
+
+  // The query already serialized with its sort, hint, explain and snapshot options, see PreparedQuery
+  this.preparedSelector = null;
 
   this.totalNumberOfRecords = 0;
-  this.items = [];
+  this.items = new ItemQueue();
+  // Batches fetched ahead of the current one and the getMore still in flight for them
+  this.prefetchedBatches = new ItemQueue();
+  this.prefetchRequest = null;
+  this.prefetchError = null;
   this.cursorId = this.db.bson_serializer.Long.fromInt(0);
+  // Connection the query went out on, the getMores follow it if the db pins cursors
+  this.connection = null;
 
   // State variables for the cursor
   this.state = Cursor.INIT;
@@ -83,7 +114,10 @@ Cursor.prototype.rewind = function() {
 
     self.numberOfReturned = 0;
     self.totalNumberOfRecords = 0;
-    self.items = [];
+    self.items.clear();
+    self.prefetchedBatches.clear();
+    self.prefetchRequest = null;
+    self.prefetchError = null;
     self.cursorId = self.db.bson_serializer.Long.fromInt(0);
     self.state = Cursor.INIT;
     self.queryRun = false;
@@ -130,7 +164,7 @@ Cursor.prototype.toArray = function(callback) {
       } else {
         callback(err, items);
         items = null;
-        self.items = [];
+        self.items.clear();
       }
     });
   } else {
@@ -246,6 +280,8 @@ Cursor.prototype.sort = function(keyOrList, direction, callback) {
     }
 
     this.sortValue = order;
+    // A prepared selector holds the old sort
+    this.preparedSelector = null;
     callback(null, this);
   }
   return this;
@@ -381,6 +417,10 @@ Cursor.prototype.generateQueryCommand = function() {
   // limitValue of -1 is a special case used by Db#eval
   var numberToReturn = this.limitValue == -1 ? -1 : this.limitRequest();
 
+  if(this.preparedSelector != null) {
+    return new QueryCommand(this.db, this.collectionName, queryOptions, this.skipValue, numberToReturn, this.preparedSelector, this.fields);
+  }
+
   // Check if we need a special selector
   if(this.sortValue != null || this.explainValue != null || this.hint != null || this.snapshot != null) {
     // Build special selector
@@ -461,8 +501,9 @@ Cursor.prototype.nextObject = function(callback) {
       return callback(err, null);
     }
 
-    var commandHandler = function(err, result) {
+    var commandHandler = function(err, result, connection) {
       if(err != null && result == null) return callback(err, null);
+      if(self.db.pinCursors) self.connection = connection;
 
       if(!err && result.documents[0] && result.documents[0]['$err']) {
         return self.close(function() {callback(result.documents[0]['$err'], null);});
@@ -473,16 +514,29 @@ Cursor.prototype.nextObject = function(callback) {
       self.cursorId = result.cursorId;
       self.totalNumberOfRecords = result.numberReturned;
 
-      // Add the new documents to the list of items
-      self.items = self.items.concat(result.documents);
+      // Add the new documents to the list of items and start fetching the next batch
+      self.items.pushAll(result.documents);
+      self.prefetch();
       self.nextObject(callback);
       result = null;
     };
 
-    self.db._executeQueryCommand(cmd, {read:true, raw:self.raw}, commandHandler);
+    self.db._executeQueryCommand(cmd, {read:true, raw:self.raw, deserializeOptions:self.deserializeOptions}, commandHandler);
     commandHandler = null;
   } else if(self.items.length) {
     callback(null, self.items.shift());
+  } else if(self.prefetchedBatches.length) {
+    // Move on to the next batch and keep the pipeline full
+    self.items.pushAll(self.prefetchedBatches.shift());
+    self.prefetch();
+    callback(null, self.items.shift());
+  } else if(self.prefetchRequest != null) {
+    // The next batch is already on its way
+    self.prefetchRequest.callback = callback;
+  } else if(self.prefetchError != null) {
+    var err = self.prefetchError;
+    self.prefetchError = null;
+    self.close(function() {callback(err, null);});
   } else if(self.cursorId.greaterThan(self.db.bson_serializer.Long.fromInt(0))) {
     self.getMore(callback);
   } else {
@@ -513,7 +567,7 @@ Cursor.prototype.getMore = function(callback) {
   try {
     var getMoreCommand = new GetMoreCommand(self.db, self.collectionName, self.limitRequest(), self.cursorId);
     // Execute the command
-    self.db._executeQueryCommand(getMoreCommand, {read:true, raw:self.raw}, function(err, result) {
+    self.db._executeQueryCommand(getMoreCommand, getMoreOptions(self), function(err, result) {
       try {
         if(err != null) callback(err, null);
 
@@ -521,15 +575,10 @@ Cursor.prototype.getMore = function(callback) {
         self.totalNumberOfRecords += result.numberReturned;
         // Determine if there's more documents to fetch
         if(result.numberReturned > 0) {
-          if (self.limitValue > 0) {
-            var excessResult = self.totalNumberOfRecords - self.limitValue;
-
-            if (excessResult > 0) {
-              result.documents.splice(-1*excessResult, excessResult);
-            }
-          }
-
-          self.items = self.items.concat(result.documents);
+          trimToLimit(self, result);
+          self.items.pushAll(result.documents);
+          // A batch the filter dropped every document of moves on to the next one
+          if(self.items.length == 0) return self.nextObject(callback);
           callback(null, self.items.shift());
         } else if(self.tailable) {
           self.getMoreTimer = setTimeout(function() {self.getMore(callback);}, 500);
@@ -554,6 +603,89 @@ Cursor.prototype.getMore = function(callback) {
   }
 }
 
+/**
+ * Drop the documents of a batch the server returned past the limit of the cursor.
+ * With a filter the documents kept are cut by their position in the batch, the
+ * limit counts the documents before they are filtered.
+ *
+ * @ignore
+ * @api private
+ */
+var trimToLimit = function(self, result) {
+  var excess = self.totalNumberOfRecords - self.limitValue;
+  if(self.limitValue <= 0 || excess <= 0) return;
+
+  var cutoff = result.numberReturned - excess;
+  var kept = cutoff;
+
+  if(result.ordinals != null) {
+    kept = 0;
+    while(kept < result.ordinals.length && result.ordinals[kept] < cutoff) kept++;
+  }
+
+  result.documents.splice(kept, result.documents.length - kept);
+}
+
+/**
+ * Options for the commands that follow the query of the cursor. If the db pins
+ * cursors they go out on the connection of the query as long as it is still up,
+ * otherwise the pool picks one.
+ *
+ * @ignore
+ * @api private
+ */
+var getMoreOptions = function(self) {
+  var connection = self.connection != null && self.connection.isConnected() ? self.connection : null;
+  return {read:true, raw:self.raw, deserializeOptions:self.deserializeOptions, connection:connection};
+}
+
+/**
+ * Issues a getMore for the next batch while the current one is consumed, until
+ * the number of batches held ahead reaches the prefetch depth. Only one getMore
+ * is in flight at a time so the batches arrive in order.
+ */
+Cursor.prototype.prefetch = function() {
+  var self = this;
+  if(self.prefetchValue <= 0 || self.prefetchRequest != null || self.state != Cursor.OPEN) return;
+  if(self.prefetchedBatches.length >= self.prefetchValue) return;
+  if(!self.cursorId.greaterThan(self.db.bson_serializer.Long.fromInt(0))) return;
+  if(self.limitValue > 0 && (self.limitValue - self.totalNumberOfRecords) < 1) return;
+
+  var request = self.prefetchRequest = {callback:null};
+
+  try {
+    var getMoreCommand = new GetMoreCommand(self.db, self.collectionName, self.limitRequest(), self.cursorId);
+  } catch(err) {
+    self.prefetchRequest = null;
+    self.prefetchError = err;
+    return;
+  }
+
+  self.db._executeQueryCommand(getMoreCommand, getMoreOptions(self), function(err, result) {
+    // The cursor was closed or rewound while the batch was on its way
+    if(self.prefetchRequest !== request) {
+      if(request.callback != null) request.callback(null, null);
+      return;
+    }
+
+    self.prefetchRequest = null;
+
+    if(err != null) {
+      self.prefetchError = err;
+    } else {
+      self.cursorId = result.cursorId;
+      self.totalNumberOfRecords += result.numberReturned;
+
+      trimToLimit(self, result);
+      if(result.documents.length > 0) self.prefetchedBatches.push(result.documents);
+      self.prefetch();
+    }
+
+    // Hand the next document to a caller waiting for this batch
+    if(request.callback != null) self.nextObject(request.callback);
+  });
+};
+
 /**
  * Gets a detailed information about how the query is performed on this cursor and how
  * long it took the database to process it.
@@ -596,7 +728,7 @@ Cursor.prototype.streamRecords = function(options) {
   execute(queryCommand);
 
   function execute(command) {
-    self.db._executeQueryCommand(command, {read:true, raw:self.raw}, function(err,result) {
+    self.db._executeQueryCommand(command, getMoreOptions(self), function(err, result, connection) {
       if(err) {
         stream.emit('error', err);
         self.close(function(){});
@@ -607,6 +739,7 @@ Cursor.prototype.streamRecords = function(options) {
         self.queryRun = true;
         self.cursorId = result.cursorId;
         self.state = Cursor.OPEN;
+        if(self.db.pinCursors) self.connection = connection;
         self.getMoreCommand = new GetMoreCommand(self.db, self.collectionName, queryCommand.numberToReturn, result.cursorId);
       }
       
@@ -631,6 +764,9 @@ Cursor.prototype.streamRecords = function(options) {
         }
         // rinse & repeat
         execute(self.getMoreCommand);
+      } else if (result.numberReturned > 0 && !result.cursorId.isZero()) {
+        // The filter dropped the whole batch
+        execute(self.getMoreCommand);
       } else {
         self.close(function(){
           stream.emit('end', recordLimitValue);
@@ -642,6 +778,82 @@ Cursor.prototype.streamRecords = function(options) {
   return stream;
 };
 
+/**
+ * Streams the results as the text of a single JSON array. The replies are read raw
+ * and their documents written out with BSON.toJSON without deserializing them.
+ *
+ * @param options {?object} fetchSize is the number of documents asked for per reply,
+ *     canonical writes canonical instead of relaxed extended JSON.
+ * @return {EventEmitter} Emits 'data' with Buffers of JSON text, 'end' once the array is
+ *     complete and 'error' if the query fails.
+ */
+Cursor.prototype.streamJSON = function(options) {
+  options = options == null ? {} : options;
+
+  var self = this,
+    stream = new process.EventEmitter(),
+    BSON = this.db.bson_deserializer.BSON,
+    jsonOptions = {canonical:options.canonical == true},
+    recordLimitValue = this.limitValue || 0,
+    emittedRecordCount = 0,
+    queryCommand = this.generateQueryCommand();
+
+  queryCommand.numberToReturn = options.fetchSize ? options.fetchSize : 500;
+
+  var end = function() {
+    self.close(function() {
+      stream.emit('data', new Buffer(emittedRecordCount == 0 ? '[]' : ']'));
+      stream.emit('end', emittedRecordCount);
+    });
+  }
+
+  var execute = function(command) {
+    var commandOptions = getMoreOptions(self);
+    commandOptions.raw = true;
+
+    self.db._executeQueryCommand(command, commandOptions, function(err, result, connection) {
+      // Query failures come back as a single error document
+      if(err == null && (result.responseFlag & 2) != 0) err = BSON.deserialize(result.documents[0])['$err'];
+
+      if(err) {
+        stream.emit('error', err);
+        self.close(function(){});
+        return;
+      }
+
+      if(!self.queryRun) {
+        self.queryRun = true;
+        self.state = Cursor.OPEN;
+        if(self.db.pinCursors) self.connection = connection;
+      }
+      self.cursorId = result.cursorId;
+
+      var documents = result.documents;
+      if(recordLimitValue && emittedRecordCount + documents.length > recordLimitValue) {
+        documents = documents.slice(0, recordLimitValue - emittedRecordCount);
+      }
+
+      if(documents.length > 0) {
+        // Continue the array of the previous batches, the closing bracket comes at the end
+        var json = BSON.toJSON(documents, jsonOptions);
+        if(emittedRecordCount > 0) json[0] = 0x2c;
+        emittedRecordCount = emittedRecordCount + documents.length;
+        stream.emit('data', json.slice(0, json.length - 1));
+      }
+
+      // A batch the filter dropped every document of still continues the stream
+      if(result.numberReturned == 0 || result.cursorId.isZero() || (recordLimitValue && emittedRecordCount >= recordLimitValue)) {
+        end();
+      } else {
+        execute(new GetMoreCommand(self.db, self.collectionName, queryCommand.numberToReturn, self.cursorId));
+      }
+    });
+  }
+
+  execute(queryCommand);
+  return stream;
+};
+
 /**
  * Close this cursor.
  *
@@ -656,18 +868,25 @@ Cursor.prototype.close = function(callback) {
   if(this.cursorId instanceof self.db.bson_serializer.Long && this.cursorId.greaterThan(self.db.bson_serializer.Long.fromInt(0))) {
     try {
       var command = new KillCursorCommand(this.db, [this.cursorId]);
-      this.db._executeQueryCommand(command, {read:true, raw:self.raw}, null);
+      var options = getMoreOptions(this);
+      this.db._executeQueryCommand(command, {read:true, raw:self.raw, connection:options.connection}, null);
     } catch(err) {}
   }
   
   // Reset cursor id
   this.cursorId = self.db.bson_serializer.Long.fromInt(0);
+  this.connection = null;
   // Set to closed status
   this.state = Cursor.CLOSED;
 
+  // Drop the batches read ahead, a getMore still in flight is ignored when it returns
+  this.prefetchedBatches.clear();
+  this.prefetchRequest = null;
+  this.prefetchError = null;
+
   if(callback) {
     callback(null, self);
-    self.items = [];
+    self.items.clear();
   }
 
   return this;
@@ -684,3 +903,63 @@ Cursor.prototype.isClosed = function() {
 Cursor.INIT = 0;
 Cursor.OPEN = 1;
 Cursor.CLOSED = 2;
+
+/**
+ * Queue of documents backed by a ring buffer, so taking the head and adding a
+ * batch don't copy the items still queued like Array shift and concat do.
+ *
+ * @ignore
+ * @api private
+ */
+var ItemQueue = function() {
+  this.buffer = new Array(ItemQueue.INITIAL_SIZE);
+  this.head = 0;
+  this.length = 0;
+};
+
+ItemQueue.INITIAL_SIZE = 16;
+
+ItemQueue.prototype.push = function(item) {
+  if(this.length == this.buffer.length) this.grow(this.length + 1);
+  this.buffer[(this.head + this.length) & (this.buffer.length - 1)] = item;
+  this.length = this.length + 1;
+};
+
+ItemQueue.prototype.pushAll = function(items) {
+  if(this.length + items.length > this.buffer.length) this.grow(this.length + items.length);
+  var mask = this.buffer.length - 1;
+  for(var i = 0; i < items.length; i++) {
+    this.buffer[(this.head + this.length + i) & mask] = items[i];
+  }
+  this.length = this.length + items.length;
+};
+
+ItemQueue.prototype.shift = function() {
+  if(this.length == 0) return undefined;
+  var item = this.buffer[this.head];
+  // Release the reference so the document can be collected
+  this.buffer[this.head] = undefined;
+  this.head = (this.head + 1) & (this.buffer.length - 1);
+  this.length = this.length - 1;
+  return item;
+};
+
+ItemQueue.prototype.clear = function() {
+  if(this.buffer.length > ItemQueue.INITIAL_SIZE || this.length > 0) this.buffer = new Array(ItemQueue.INITIAL_SIZE);
+  this.head = 0;
+  this.length = 0;
+};
+
+// Keep the size a power of two so the index wraps with a mask
+ItemQueue.prototype.grow = function(needed) {
+  var size = this.buffer.length;
+  while(size < needed) size = size * 2;
+
+  var buffer = new Array(size);
+  for(var i = 0; i < this.length; i++) {
+    buffer[i] = this.buffer[(this.head + i) & (this.buffer.length - 1)];
+  }
+
+  this.buffer = buffer;
+  this.head = 0;
+};
@@ -7,6 +7,7 @@ var QueryCommand = require('./commands/query_command').QueryCommand,
   Server = require('./connection/server').Server,
   ReplSetServers = require('./connection/repl_set_servers').ReplSetServers,
   Cursor = require('./cursor').Cursor,
+  InsertCoalescer = require('./insert_coalescer').InsertCoalescer,
   EventEmitter = require('events').EventEmitter,
   inherits = require('util').inherits,
   crypto = require('crypto'),
@@ -65,9 +66,23 @@ var Db = exports.Db = function(databaseName, serverConfig, options) {
 
   // Controls serialization options
   this.serializeFunctions = this.options.serializeFunctions != null ? this.options.serializeFunctions : false;
+
+  // Controls deserialization options
+  this.deserializeOptions = {
+    rawTimestamps: this.options.rawTimestamps != null ? this.options.rawTimestamps : false,
+    rawDates: this.options.rawDates != null ? this.options.rawDates : false,
+    internStrings: this.options.internStrings != null ? this.options.internStrings : false,
+    externalStringThreshold: this.options.externalStringThreshold != null ? this.options.externalStringThreshold : 0,
+    cacheRegExps: this.options.cacheRegExps != null ? this.options.cacheRegExps : false
+  };
   
   // Raw mode
   this.raw = this.options.raw != null ? this.options.raw : false;
+  // Send the getMores of a cursor on the connection its query went out on
+  this.pinCursors = this.options.pinCursors != null ? this.options.pinCursors : false;
+  // Merge the inserts of a tick into one insert command per collection
+  this.insertCoalescer = this.options.coalesceInserts
+    ? new InsertCoalescer(this, this.options.coalesceMaxDocuments, this.options.coalesceMaxBytes) : null;
   
   // Retry information
   this.retryMiliSeconds = this.options.retryMiliSeconds != null ? this.options.retryMiliSeconds : 5000;
@@ -678,12 +693,12 @@ Db.prototype.dropDatabase = function(callback) {
   });
 };
 
-// Register a handler
-Db.prototype._registerHandler = function(db_command, raw, connection, callback) {
+// Register a handler, deserializeOptions overrides the db level options used to decode the reply
+Db.prototype._registerHandler = function(db_command, raw, connection, callback, deserializeOptions) {
   // Add the callback to the list of handlers
   this._mongodbHandlers._mongodbCallbacks[db_command.getRequestId().toString()] = callback;
   // Add the information about the reply
-  this._mongodbHandlers._notReplied[db_command.getRequestId().toString()] = {start: new Date().getTime(), 'raw': raw, 'connection':connection};
+  this._mongodbHandlers._notReplied[db_command.getRequestId().toString()] = {start: new Date().getTime(), 'raw': raw, 'connection':connection, 'deserializeOptions':deserializeOptions};
 }
 
 // Remove a handler
@@ -714,6 +729,7 @@ var __executeQueryCommand = function(self, db_command, options, callback) {
   // Options unpacking
   var read = options['read'] != null ? options['read'] : false;
   var raw = options['raw'] != null ? options['raw'] : self.raw;
+  var deserializeOptions = options['deserializeOptions'];
   var onAll = options['onAll'] != null ? options['onAll'] : false;
   var specifiedConnection = options['connection'] != null ? options['connection'] : null;
   
@@ -729,7 +745,7 @@ var __executeQueryCommand = function(self, db_command, options, callback) {
     if(connection == null) return callback(new Error("no open connections"));        
 
     // Register the handler in the data structure
-    self._registerHandler(db_command, raw, connection, callback);
+    self._registerHandler(db_command, raw, connection, callback, deserializeOptions);
     
     // Write the message out and handle any errors if there are any
     connection.write(db_command, function(err) {
@@ -757,7 +773,7 @@ var __executeQueryCommand = function(self, db_command, options, callback) {
       if(connection == null) return callback(new Error("no open connections"));
 
       // Register the handler in the data structure
-      self._registerHandler(db_command, raw, connection, callback);
+      self._registerHandler(db_command, raw, connection, callback, deserializeOptions);
 
       // Write the message out
       connection.write(db_command, function(err) {
@@ -865,6 +881,7 @@ var __executeInsertCommand = function(self, db_command, options, callback) {
   var connection = self.serverConfig.checkoutWriter();
   var safe = options['safe'] != null ? options['safe'] : false;
   var raw = options['raw'] != null ? options['raw'] : self.raw;
+  var deserializeOptions = options['deserializeOptions'];
   var specifiedConnection = options['connection'] != null ? options['connection'] : null;
   // Override connection if needed
   connection = specifiedConnection != null ? specifiedConnection : connection;
@@ -879,7 +896,7 @@ var __executeInsertCommand = function(self, db_command, options, callback) {
       db_command = [db_command, DbCommand.createGetLastErrorCommand(safe, self)];
 
       // Register the handler in the data structure
-      self._registerHandler(db_command[1], raw, connection, callback);
+      self._registerHandler(db_command[1], raw, connection, callback, deserializeOptions);
     }
   }
   
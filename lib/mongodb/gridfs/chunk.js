@@ -38,6 +38,7 @@ var Chunk = exports.Chunk = function(file, mongoObject) {
   } else if(mongoObjectFinal.data instanceof file.db.bson_serializer.Binary || Object.prototype.toString.call(mongoObjectFinal.data) == "[object Binary]") {    
     this.data = mongoObjectFinal.data;
   } else if(mongoObjectFinal.data instanceof Buffer) {
+    this.data = new file.db.bson_serializer.Binary(mongoObjectFinal.data);
   } else {
     throw Error("Illegal chunk format");
   }
@@ -62,6 +63,13 @@ var Chunk = exports.Chunk = function(file, mongoObject) {
  *     will contain a reference to this object.
  */
 Chunk.prototype.write = function(data, callback) {
+  // Update the running md5 of the file
+  if(this.file.md5Context != null && typeof data == 'string') {
+    this.file.md5Context.update(data, 'binary');
+  } else if(this.file.md5Context != null) {
+    this.file.md5Context.update(data);
+  }
+
   this.data.write(data, this.internalPosition);
   this.internalPosition = this.data.length();
   callback(null, this);
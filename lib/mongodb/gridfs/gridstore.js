@@ -8,6 +8,7 @@
  */
 
 var BinaryParser = require('../bson/binary_parser').BinaryParser,
+  BSONPure = require('../bson/bson').BSON,
   Chunk = require('./chunk').Chunk,
   DbCommand = require('../commands/db_command').DbCommand,
   Buffer = require('buffer').Buffer,
@@ -20,6 +21,13 @@ var BinaryParser = require('../bson/binary_parser').BinaryParser,
 var REFERENCE_BY_FILENAME = 0,
   REFERENCE_BY_ID = 1;
 
+// Used to calculate the md5 while writing, without it the server calculates it using filemd5
+try {
+  var crypto = require('crypto');
+} catch (err) {
+  var crypto = null;
+}
+
 /**
  * A class representation of a file stored in GridFS.
  *
@@ -41,6 +49,8 @@ var REFERENCE_BY_FILENAME = 0,
  *       'root' : , // {string} root collection to use. Defaults to GridStore#DEFAULT_ROOT_COLLECTION
  *       'chunk_type' : , // {string} mime type of the file. Defaults to GridStore#DEFAULT_CONTENT_TYPE
  *       'chunk_size' : , // {number} size for the chunk. Defaults to Chunk#DEFAULT_CHUNK_SIZE.
+ *       'chunks_in_flight' : , // {number} chunk inserts writeFile keeps in flight. Defaults to GridStore#DEFAULT_CHUNKS_IN_FLIGHT.
+ *       'read_ahead' : , // {number} extra chunks readRange fetches past the range. Defaults to GridStore#DEFAULT_READ_AHEAD.
  *       'metadata' : , // {object} arbitrary data the user wants to store
  *     }
  *     </code></pre>
@@ -89,6 +99,11 @@ var GridStore = exports.GridStore = function(db, fileIdObject, mode, options) {
 	 */
   this.__defineGetter__("md5", function() { return this.internalMd5; });
   this.__defineSetter__("md5", function(value) {});
+  
+  // Running md5 of the data written, only kept while the file is written sequentially from the start
+  this.md5Context = null;
+  // Raw chunk documents fetched ahead by readRange, {first: chunk number, documents: [Buffer]}
+  this.readAheadChunks = null;
 };
 
 /**
@@ -174,6 +189,7 @@ var _open = function(self, callback) {
             // Delete any existing chunks
             self.deleteChunks(function(err, result) {
               self.currentChunk = new Chunk(self, {'n':0});
+              self.md5Context = crypto != null ? crypto.createHash('md5') : null;
               self.contentType = self.options['content_type'] == null ? self.contentType : self.options['content_type'];
               self.internalChunkSize = self.options['chunk_size'] == null ? self.internalChunkSize : self.options['chunk_size'];
               self.metadata = self.options['metadata'] == null ? self.metadata : self.options['metadata'];
@@ -205,6 +221,7 @@ var _open = function(self, callback) {
           // Delete any existing chunks
           self.deleteChunks(function(err, result) {
             self.currentChunk = new Chunk(self, {'n':0});
+            self.md5Context = crypto != null ? crypto.createHash('md5') : null;
             self.contentType = self.options['content_type'] == null ? self.contentType : self.options['content_type'];
             self.internalChunkSize = self.options['chunk_size'] == null ? self.internalChunkSize : self.options['chunk_size'];
             self.metadata = self.options['metadata'] == null ? self.metadata : self.options['metadata'];
@@ -248,39 +265,91 @@ GridStore.prototype.writeFile = function (file, callback) {
 
   self.open(function (err, self) {
     fs.fstat(file, function (err, stats) {
-      var offset = 0;
-      var index = 0;
-      var numberOfChunksLeft = Math.min(stats.size / self.chunkSize);
-      
-      // Write a chunk
-      var writeChunk = function() {
-        fs.read(file, self.chunkSize, offset, 'binary', function(err, data, bytesRead) {
-          offset = offset + bytesRead;
-          // Create a new chunk for the data
-          var chunk = new Chunk(self, {n:index++});
-          chunk.write(data, function(err, chunk) {
-            chunk.save(function(err, result) {
-              // Point to current chunk
+      self.chunkCollection(function(err, collection) {
+        var offset = 0;
+        var index = 0;
+        var inFlight = 0;
+        var reading = false;
+        var finished = false;
+        var firstError = null;
+        var maxInFlight = self.options['chunks_in_flight'] == null ? GridStore.DEFAULT_CHUNKS_IN_FLIGHT : self.options['chunks_in_flight'];
+
+        // Close the file once all the reads and chunk inserts are done
+        var finish = function() {
+          if(reading || inFlight > 0) return;
+          fs.close(file);
+          if(firstError != null) return callback(firstError, null);
+
+          self.close(function(err, result) {
+            return callback(err, result);
+          });
+        }
+
+        // Read the next chunk straight into its own buffer and start inserting it
+        var readChunk = function() {
+          reading = true;
+          var buffer = new Buffer(self.chunkSize);
+
+          fs.read(file, buffer, 0, self.chunkSize, offset, function(err, bytesRead) {
+            reading = false;
+            if(err != null) {
+              firstError = firstError == null ? err : firstError;
+              finished = true;
+              return finish();
+            }
+
+            // An insert failed while we were reading
+            if(finished) return finish();
+
+            offset = offset + bytesRead;
+            self.position = offset;
+            // Wrap the bytes read in a chunk, the md5 is updated in file order
+            var data = bytesRead < buffer.length ? buffer.slice(0, bytesRead) : buffer;
+            var chunk = new Chunk(self, {n:index++, data:data});
+            chunk.position = bytesRead;
+            if(self.md5Context != null) self.md5Context.update(data);
+
+            // The last chunk is left as the current chunk and saved by close
+            if(bytesRead == 0 || offset >= stats.size) {
               self.currentChunk = chunk;
-              
-              if(offset >= stats.size) {
-                fs.close(file);
-                self.close(function(err, result) {
-                  return callback(null, result);                  
-                })                 
-              } else {
-                return process.nextTick(writeChunk);
-              }
+              finished = true;
+              return finish();
+            }
+
+            inFlight = inFlight + 1;
+            chunk.buildMongoObject(function(mongoObject) {
+              collection.insert(mongoObject, {safe:true}, function(err, result) {
+                inFlight = inFlight - 1;
+                if(err != null && firstError == null) {
+                  firstError = err;
+                  finished = true;
+                }
+
+                if(finished) return finish();
+                if(!reading && inFlight < maxInFlight) readChunk();
+              });
             });
+
+            // Keep reading while there is room for more inserts
+            if(inFlight < maxInFlight) readChunk();
           });
+        }
+
+        // The chunks are inserted without removing the ones they replace. Only "w" truncates
+        // the file on open, in "w+" the chunks from the first one written on are removed first
+        if(self.mode == "w") return readChunk();
+
+        collection.remove({'files_id':self.fileId, 'n':{'$gte':0}}, {safe:true}, function(err, result) {
+          if(err != null) {
+            fs.close(file);
+            return callback(err, null);
+          }
+
+          readChunk();
         });
-      }
-      
-      // Process the first write
-      process.nextTick(writeChunk);
+      });
     });
   });
-
 };
 
 /**
@@ -438,6 +507,13 @@ GridStore.prototype.buildMongoObject = function(callback) {
     'metadata': this.metadata
   };
 
+  // Use the md5 calculated while writing if we have it
+  if(this.md5Context != null) {
+    mongoObject.md5 = this.md5Context.digest('hex');
+    this.md5Context = null;
+    return callback(mongoObject);
+  }
+
   var md5Command = {filemd5:this.fileId, root:this.root};
   this.db.command(md5Command, function(err, results) {
     mongoObject.md5 = results.md5;
@@ -656,6 +732,7 @@ GridStore.prototype.rewind = function(callback) {
     if(this.mode[0] == "w") {
       self.deleteChunks(function(err, gridStore) {
         self.currentChunk = new Chunk(self, {'n': 0});
+        self.md5Context = crypto != null ? crypto.createHash('md5') : null;
         self.position = 0;
         callback(null, self);
       });
@@ -669,6 +746,7 @@ GridStore.prototype.rewind = function(callback) {
     }
   } else {
     self.currentChunk.rewind();
+    if(self.mode == "w") self.md5Context = crypto != null ? crypto.createHash('md5') : null;
     self.position = 0;
     callback(null, self);
   }
@@ -760,6 +838,105 @@ GridStore.prototype.readBuffer = function(length, buffer, callback) {
   }
 }
 
+/**
+ * Reads a range of this file into a Buffer without moving the read/write head.
+ *
+ * All the chunks covering the range, plus 'read_ahead' chunks after it, are
+ * fetched with a single query as raw documents and their data is copied
+ * straight into the result. The read ahead chunks are kept so sequential
+ * range reads, like HTTP range requests for a video, mostly skip the query.
+ *
+ * @param offset {number} The offset from the head of the file to read from.
+ * @param length {number=} opt_argument The number of bytes to read. Reads up
+ *     to the end of the file if not specified or past the end of the file.
+ * @param callback {function(?Error, ?Buffer)} This will be called after this
+ *     method is executed. An Error is passed to the first parameter if the
+ *     offset is outside the file or chunks are missing, otherwise a Buffer
+ *     with the data is passed to the second.
+ *
+ * @see GridStore#readBuffer
+ */
+GridStore.prototype.readRange = function(offset, length, callback) {
+  var self = this;
+
+  var args = Array.prototype.slice.call(arguments, 1);
+  callback = args.pop();
+  length = args.length ? args.shift() : null;
+
+  if(self.mode[0] != "r") return callback(new Error("readRange is only available in read mode"), null);
+  if(offset < 0 || offset > self.length) return callback(new Error("offset is outside of the file"), null);
+
+  var finalLength = length == null || (offset + length) > self.length ? self.length - offset : length;
+  var finalBuffer = new Buffer(finalLength);
+  if(finalLength == 0) return callback(null, finalBuffer);
+
+  var firstChunk = Math.floor(offset/self.chunkSize);
+  var lastChunk = Math.floor((offset + finalLength - 1)/self.chunkSize);
+
+  // Copy the covered part of each chunk's data into the final buffer
+  var copyChunks = function(first, documents) {
+    var bson = self.db.bson_deserializer.BSON;
+
+    try {
+      for(var n = firstChunk; n <= lastChunk; n++) {
+        var chunkStart = n * self.chunkSize;
+        var sourceStart = Math.max(offset - chunkStart, 0);
+        var sourceEnd = Math.min(offset + finalLength - chunkStart, self.chunkSize);
+        bson.copyBinaryField(documents[n - first], 'data', finalBuffer, chunkStart + sourceStart - offset, sourceStart, sourceEnd);
+      }
+    } catch(err) {
+      return callback(err, null);
+    }
+
+    callback(null, finalBuffer);
+  }
+
+  // Serve the range from the chunks read ahead if possible
+  var cached = self.readAheadChunks;
+  if(cached != null && firstChunk >= cached.first && lastChunk < cached.first + cached.documents.length) {
+    return copyChunks(cached.first, cached.documents);
+  }
+
+  var readAhead = self.options['read_ahead'] == null ? GridStore.DEFAULT_READ_AHEAD : self.options['read_ahead'];
+  var lastFetched = Math.min(lastChunk + readAhead, self.lastChunkNumber());
+
+  self.chunkCollection(function(err, collection) {
+    if(err != null) return callback(err, null);
+
+    var selector = {'files_id':self.fileId, 'n':{'$gte':firstChunk, '$lte':lastFetched}};
+    collection.find(selector, {'sort':[['n', 1]], 'raw':true}, function(err, cursor) {
+      if(err != null) return callback(err, null);
+
+      cursor.toArray(function(err, documents) {
+        if(err != null) return callback(err, null);
+        // Keep the chunks up to the first one out of place, the ones read ahead can hide a missing chunk
+        var inPlace = 0;
+        while(inPlace < documents.length && chunkNumber(documents[inPlace]) == firstChunk + inPlace) inPlace++;
+        documents = documents.slice(0, inPlace);
+        if(documents.length < (lastChunk - firstChunk + 1)) return callback(new Error("chunks missing for the requested range"), null);
+
+        // Keep the last chunk of the range, it's often only partially read, and the ones read ahead
+        self.readAheadChunks = {first:lastChunk, documents:documents.slice(lastChunk - firstChunk)};
+        copyChunks(firstChunk, documents);
+      });
+    });
+  });
+};
+
+// The n of a raw chunk document, -1 if it has none
+var chunkNumber = function(document) {
+  var index = BSONPure.findField(document, 'n');
+  if(index == -1) return -1;
+  // The type byte sits in front of the one character name
+  if(document[index - 3] == BSONPure.BSON_DATA_INT) {
+    return document[index] | document[index + 1] << 8 | document[index + 2] << 16 | document[index + 3] << 24;
+  }
+
+  // Written as a double or a long by another driver
+  var n = BSONPure.deserialize(document).n;
+  return n != null && typeof n.toNumber == 'function' ? n.toNumber() : n;
+}
+
 /**
  * Retrieves the position of the read/write head of this file.
  *
@@ -813,6 +990,9 @@ GridStore.prototype.seek = function(position, seekLocation, callback) {
     targetPosition = finalPosition;
   }
 
+  // Writes are no longer sequential, let the server calculate the md5
+  if(targetPosition != self.position) self.md5Context = null;
+
   var newChunkNumber = Math.floor(targetPosition/self.chunkSize);
   if(newChunkNumber != self.currentChunk.chunkNumber) {
     if(self.mode[0] == 'w') {
@@ -824,6 +1004,13 @@ GridStore.prototype.seek = function(position, seekLocation, callback) {
           callback(null, self);
         });
       });
+    } else {
+      self.nthChunk(newChunkNumber, function(err, chunk) {
+        self.currentChunk = chunk;
+        self.position = targetPosition;
+        self.currentChunk.position = (self.position % self.chunkSize);
+        callback(null, self);
+      });
     }
   } else {
     self.position = targetPosition;
@@ -891,6 +1078,16 @@ GridStore.DEFAULT_ROOT_COLLECTION = 'fs';
  * @constant
  */
 GridStore.DEFAULT_CONTENT_TYPE = 'binary/octet-stream';
+/**
+ * Default number of chunk inserts writeFile keeps in flight
+ * @constant
+ */
+GridStore.DEFAULT_CHUNKS_IN_FLIGHT = 4;
+/**
+ * Default number of chunks readRange fetches past the requested range
+ * @constant
+ */
+GridStore.DEFAULT_READ_AHEAD = 2;
 /**
  * Seek mode where the given length is absolute.
  * @constant
@@ -23,6 +23,7 @@ try {
   , 'cursor'
   , 'db'
   , 'goog/math/long'
+  , 'prepared_query'
   , 'gridfs/grid'
   ,	'gridfs/chunk'
   , 'gridfs/gridstore'].forEach(function (path) {
@@ -53,6 +54,7 @@ exports.native = function() {
     , 'connection/repl_set_servers'
     , 'cursor'
     , 'db'
+    , 'prepared_query'
     , 'gridfs/grid'
     ,	'gridfs/chunk'
     , 'gridfs/gridstore'].forEach(function (path) {
@@ -86,6 +88,7 @@ exports.pure = function() {
     , 'connection/repl_set_servers'
     , 'cursor'
     , 'db'
+    , 'prepared_query'
     , 'gridfs/grid'
     ,	'gridfs/chunk'
     , 'gridfs/gridstore'].forEach(function (path) {
@@ -0,0 +1,153 @@
+var InsertCommand = require('./commands/insert_command').InsertCommand;
+
+/**
+ * Merges the inserts issued in the same tick into one OP_INSERT per collection.
+ *
+ * Inserts to the same collection with the same options are serialized, queued
+ * and written as a single InsertCommand on the next tick, or as soon as the batch reaches
+ * maxDocuments documents or maxBytes bytes. The command is sent with keepGoing so a
+ * document the server rejects, like a duplicate key, doesn't stop the documents of the
+ * other inserts after it. Only single document inserts and inserts with keepGoing are
+ * merged, their own documents are handled the same either way.
+ *
+ * Safe inserts share one getLastError. It can't tell which document failed, so an error
+ * it reports is returned to every safe insert of the batch, including the ones whose
+ * documents were stored. Unsafe inserts are never told about errors, as without merging.
+ *
+ * @param db {Db} The db the inserts run on.
+ * @param maxDocuments {number} The most documents in a batch.
+ * @param maxBytes {number} The most bytes of documents in a batch.
+ */
+var InsertCoalescer = exports.InsertCoalescer = function(db, maxDocuments, maxBytes) {
+  this.db = db;
+  this.maxDocuments = maxDocuments == null ? InsertCoalescer.DEFAULT_MAX_DOCUMENTS : maxDocuments;
+  this.maxBytes = maxBytes == null ? InsertCoalescer.DEFAULT_MAX_BYTES : maxBytes;
+  // Batches waiting for the next tick by collection and options
+  this.batches = {};
+  this.flushScheduled = false;
+
+  // Metrics
+  this.inserts = 0;
+  this.commands = 0;
+}
+
+/**
+ * Queue the documents of an insert.
+ *
+ * @param collectionName {string} The full collection name.
+ * @param docs {Array} The documents, decorated with their _id's.
+ * @param insertFlags {object} The keepGoing and serializeFunctions flags of the insert.
+ * @param commandOptions {object} The safe options of the insert.
+ * @param callback {?function(?Error, ?Array)} Called with the documents once the batch is written.
+ */
+InsertCoalescer.prototype.add = function(collectionName, docs, insertFlags, commandOptions, callback) {
+  // Serialize the documents now, they can change before the batch is written on the next tick
+  var documents = new Array(docs.length);
+
+  try {
+    for(var i = 0; i < docs.length; i++) {
+      documents[i] = docs[i] instanceof Buffer ? docs[i]
+        : this.db.bson_serializer.BSON.serialize(docs[i], true, true, insertFlags.serializeFunctions);
+    }
+  } catch(err) {
+    if(callback == null) throw err;
+    return callback(err);
+  }
+
+  var key = collectionName + JSON.stringify(insertFlags) + JSON.stringify(commandOptions);
+  var batch = this.batches[key];
+
+  if(batch == null) {
+    batch = this.batches[key] = {collectionName:collectionName, insertFlags:insertFlags, commandOptions:commandOptions,
+      documents:[], bytes:0, inserts:[]};
+  }
+
+  for(var i = 0; i < documents.length; i++) {
+    batch.documents.push(documents[i]);
+    batch.bytes = batch.bytes + documents[i].length;
+  }
+
+  batch.inserts.push({docs:docs, callback:callback});
+  this.inserts = this.inserts + 1;
+
+  // A full batch goes out right away
+  if(batch.documents.length >= this.maxDocuments || batch.bytes >= this.maxBytes) {
+    delete this.batches[key];
+    this.write(batch);
+  } else if(!this.flushScheduled) {
+    var self = this;
+    this.flushScheduled = true;
+    process.nextTick(function() { self.flush(); });
+  }
+}
+
+/**
+ * Write out all the queued batches.
+ */
+InsertCoalescer.prototype.flush = function() {
+  var batches = this.batches;
+  var keys = Object.keys(batches);
+  this.batches = {};
+  this.flushScheduled = false;
+
+  for(var i = 0; i < keys.length; i++) {
+    this.write(batches[keys[i]]);
+  }
+}
+
+/**
+ * Write a batch as one InsertCommand and return the outcome to each insert.
+ *
+ * @ignore
+ * @api private
+ */
+InsertCoalescer.prototype.write = function(batch) {
+  var self = this;
+  var insertCommand = new InsertCommand(this.db, batch.collectionName, true,
+    {keepGoing:true, serializeFunctions:batch.insertFlags.serializeFunctions});
+
+  for(var i = 0; i < batch.documents.length; i++) {
+    insertCommand.add(batch.documents[i]);
+  }
+
+  this.commands = this.commands + 1;
+
+  if(batch.commandOptions['safe']) {
+    this.db._executeInsertCommand(insertCommand, batch.commandOptions, function(err, error) {
+      error = error && error.documents;
+      if(!err && error[0].err) err = self.db.wrap(error[0]);
+      complete(batch, err);
+    });
+  } else {
+    var result = this.db._executeInsertCommand(insertCommand, batch.commandOptions);
+    complete(batch, result instanceof Error ? result : null);
+  }
+}
+
+/**
+ * @return {object} The number of inserts queued and the number of insert commands written for them.
+ */
+InsertCoalescer.prototype.stats = function() {
+  return {inserts:this.inserts, commands:this.commands};
+}
+
+// Fan the outcome of a batch back out to its inserts
+var complete = function(batch, err) {
+  for(var i = 0; i < batch.inserts.length; i++) {
+    var insert = batch.inserts[i];
+    if(insert.callback == null) continue;
+
+    if(err) {
+      insert.callback(err);
+    } else {
+      insert.callback(null, insert.docs);
+    }
+  }
+}
+
+/**
+ * Default limits of a batch
+ * @constant
+ */
+InsertCoalescer.DEFAULT_MAX_DOCUMENTS = 1000;
+InsertCoalescer.DEFAULT_MAX_BYTES = 1024 * 1024 * 4;
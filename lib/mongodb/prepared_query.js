@@ -0,0 +1,291 @@
+var Cursor = require('./cursor').Cursor,
+  BSONPure = require('./bson/bson').BSON;
+
+/**
+ * A placeholder for a value given when a prepared query is run.
+ *
+ * @param name {string} The name of the value in the values passed to find.
+ */
+var Parameter = exports.Parameter = function(name) {
+  this.name = name;
+}
+
+/**
+ * A query of a fixed shape serialized once and run with different values.
+ *
+ * The selector, wrapped with its sort, hint, explain and snapshot options the
+ * way a Cursor sends it, is serialized with the first values it is run with
+ * and the offsets of the parameter values are recorded. Later runs copy the
+ * serialized selector and write the new values over the old ones in place.
+ * The selector is only serialized again when a value doesn't encode to the
+ * same number of bytes as the one it replaces, like a string of a different
+ * length.
+ *
+ * @param collection {Collection} The collection to query.
+ * @param shape {object} The selector, with Parameter instances in place of the values that change.
+ * @param options {?object} The fields, skip, limit, sort, hint, explain, snapshot, timeout, tailable,
+ *     batchSize, slaveOk, raw, prefetch, decodeFields and filter options of find.
+ */
+var PreparedQuery = exports.PreparedQuery = function(collection, shape, options) {
+  this.collection = collection;
+  this.db = collection.db;
+  this.shape = shape;
+  this.options = options == null ? {} : options;
+  // Paths of the parameters in the shape
+  this.parameters = [];
+  findParameters(shape, [], this.parameters);
+
+  // The field selector never changes, serialize it right away
+  this.fields = normalizeFields(this.options.fields);
+  if(this.fields != null && !(this.fields instanceof Buffer)) {
+    this.fields = Object.keys(this.fields).length > 0 ? this.db.bson_serializer.BSON.serialize(this.fields, false, true) : null;
+  }
+
+  // The serialized selector and where the parameter values are in it
+  this.template = null;
+  this.slots = null;
+
+  // Metrics
+  this.executions = 0;
+  this.builds = 0;
+}
+
+/**
+ * @return {object} A Parameter named name to put in the shape of a prepared query.
+ */
+PreparedQuery.param = function(name) {
+  return new Parameter(name);
+}
+
+/**
+ * Run the query with the given values.
+ *
+ * @param values {object} The values of the parameters by name.
+ * @param callback {?function(?Error, Cursor)} Called with the cursor, the cursor is returned without a callback.
+ */
+PreparedQuery.prototype.find = function(values, callback) {
+  var o = this.options;
+  var slaveOk = o.slaveOk != null ? o.slaveOk : this.db.slaveOk;
+  var raw = o.raw != null ? o.raw : this.collection.raw;
+  var hint = o.hint != null ? this.collection.normalizeHintField(o.hint) : this.collection.internalHint;
+  var cursor = null;
+
+  try {
+    // The cursor keeps the query object for count, explain and a new sort, the query itself goes out prepared
+    cursor = new Cursor(this.db, this.collection, substitute(this.shape, values), this.fields, o.skip ? o.skip : 0, o.limit ? o.limit : 0,
+      o.sort, hint, o.explain, o.snapshot, o.timeout, o.tailable, o.batchSize, slaveOk, raw, o.prefetch, o.decodeFields, o.filter);
+    cursor.preparedSelector = this.selector(values);
+  } catch(err) {
+    if(callback) return callback(err, null);
+    throw err;
+  }
+
+  if(callback) return callback(null, cursor);
+  return cursor;
+}
+
+/**
+ * Run the query with the given values and return the first document found.
+ *
+ * @param values {object} The values of the parameters by name.
+ * @param callback {function(?Error, ?object)} Called with the document or null.
+ */
+PreparedQuery.prototype.findOne = function(values, callback) {
+  var self = this;
+  var o = this.options;
+  var slaveOk = o.slaveOk != null ? o.slaveOk : this.db.slaveOk;
+  var raw = o.raw != null ? o.raw : this.collection.raw;
+  var hint = o.hint != null ? this.collection.normalizeHintField(o.hint) : this.collection.internalHint;
+
+  try {
+    var cursor = new Cursor(this.db, this.collection, substitute(this.shape, values), this.fields, o.skip ? o.skip : 0, 1,
+      o.sort, hint, o.explain, o.snapshot, o.timeout, null, null, slaveOk, raw, null, o.decodeFields, o.filter);
+    cursor.preparedSelector = this.selector(values);
+  } catch(err) {
+    return callback(err, null);
+  }
+
+  cursor.toArray(function(err, items) {
+    if(err != null) return callback(err instanceof Error ? err : self.db.wrap(new Error(err)), null);
+    callback(null, items.length == 1 ? items[0] : null);
+  });
+}
+
+/**
+ * Serialize the selector for the given values, patching a copy of the
+ * serialized selector when all the values fit in place.
+ *
+ * @param values {object} The values of the parameters by name.
+ * @return {Buffer} The serialized selector.
+ */
+PreparedQuery.prototype.selector = function(values) {
+  values = values == null ? {} : values;
+  this.executions = this.executions + 1;
+
+  if(this.template != null) {
+    var encoded = new Array(this.slots.length);
+
+    for(var i = 0; i < this.slots.length; i++) {
+      encoded[i] = encodeValue(this.db, values[this.slots[i].name]);
+      if(encoded[i] == null || encoded[i].length != this.slots[i].length) break;
+    }
+
+    // Every value fits in the bytes of the one it replaces
+    if(i == this.slots.length) {
+      var selector = new Buffer(this.template.length);
+      this.template.copy(selector, 0);
+
+      for(var i = 0; i < this.slots.length; i++) {
+        selector[this.slots[i].typeIndex] = encoded[i].type;
+        encoded[i].bytes.copy(selector, this.slots[i].valueIndex, encoded[i].start, encoded[i].start + encoded[i].length);
+      }
+
+      return selector;
+    }
+  }
+
+  this.build(values);
+  var selector = new Buffer(this.template.length);
+  this.template.copy(selector, 0);
+  return selector;
+}
+
+/**
+ * Serialize the selector with the given values and record where the values are.
+ *
+ * @ignore
+ * @api private
+ */
+PreparedQuery.prototype.build = function(values) {
+  var o = this.options;
+  var query = substitute(this.shape, values);
+  var hint = o.hint != null ? this.collection.normalizeHintField(o.hint) : this.collection.internalHint;
+  // Let a cursor wrap the selector the way it would send it
+  var cursor = new Cursor(this.db, this.collection, query, null, 0, 0, o.sort, hint, o.explain, o.snapshot);
+  var selector = cursor.generateQueryCommand().query;
+  var prefix = selector === query ? [] : ['query'];
+
+  var template = this.db.bson_serializer.BSON.serialize(selector, false, true);
+  var slots = [];
+
+  for(var i = 0; i < this.parameters.length; i++) {
+    var path = prefix.concat(this.parameters[i].path);
+    var slot = locateValue(template, 0, path, 0);
+    if(slot == null) throw new Error("no value for parameter " + this.parameters[i].name);
+    slot.name = this.parameters[i].name;
+    slots.push(slot);
+  }
+
+  this.template = template;
+  this.slots = slots;
+  this.builds = this.builds + 1;
+}
+
+/**
+ * @return {object} The number of times the query was run and the number of times its selector was serialized.
+ */
+PreparedQuery.prototype.stats = function() {
+  return {executions:this.executions, builds:this.builds};
+}
+
+// Record the paths of the parameters in a shape
+var findParameters = function(shape, path, parameters) {
+  var keys = Object.keys(shape);
+
+  for(var i = 0; i < keys.length; i++) {
+    var value = shape[keys[i]];
+
+    if(value instanceof Parameter) {
+      parameters.push({name:value.name, path:path.concat([keys[i]])});
+    } else if(value != null && (Array.isArray(value) || Object.prototype.toString.call(value) === '[object Object]')) {
+      findParameters(value, path.concat([keys[i]]), parameters);
+    }
+  }
+}
+
+// Copy a shape with the parameters replaced by their values
+var substitute = function(shape, values) {
+  var copy = Array.isArray(shape) ? [] : {};
+  var keys = Object.keys(shape);
+
+  for(var i = 0; i < keys.length; i++) {
+    var value = shape[keys[i]];
+
+    if(value instanceof Parameter) {
+      copy[keys[i]] = values[value.name];
+    } else if(value != null && (Array.isArray(value) || Object.prototype.toString.call(value) === '[object Object]')) {
+      copy[keys[i]] = substitute(value, values);
+    } else {
+      copy[keys[i]] = value;
+    }
+  }
+
+  return copy;
+}
+
+// Find the element at a path of names in a serialized document, returns the offsets of its type and value and the size of the value
+var locateValue = function(data, start, path, depth) {
+  var end = start + (data[start] | data[start + 1] << 8 | data[start + 2] << 16 | data[start + 3] << 24) - 1;
+  var index = start + 4;
+
+  while(index < end) {
+    var type = data[index];
+    var nameEnd = index + 1;
+    while(nameEnd < end && data[nameEnd] !== 0) nameEnd++;
+    if(nameEnd >= end) return null;
+    var valueIndex = nameEnd + 1;
+    var size = BSONPure.valueSize(data, valueIndex, type, end);
+    if(size == -1) return null;
+
+    if(data.toString('utf8', index + 1, nameEnd) == path[depth]) {
+      if(depth == path.length - 1) return {typeIndex:index, valueIndex:valueIndex, length:size};
+      if(type != BSONPure.BSON_DATA_OBJECT && type != BSONPure.BSON_DATA_ARRAY) return null;
+      return locateValue(data, valueIndex, path, depth + 1);
+    }
+
+    index = valueIndex + size;
+  }
+
+  return null;
+}
+
+// Encode a parameter value, returns its type and the bytes holding it or null if it's not serialized
+var encodeValue = function(db, value) {
+  // Integers and strings, the usual lookup keys, are written straight away
+  if(typeof value === 'number' && (value | 0) === value && (value !== 0 || 1 / value > 0)) {
+    var bytes = new Buffer(4);
+    bytes[0] = value & 0xff;
+    bytes[1] = (value >> 8) & 0xff;
+    bytes[2] = (value >> 16) & 0xff;
+    bytes[3] = (value >> 24) & 0xff;
+    return {type:BSONPure.BSON_DATA_INT, bytes:bytes, start:0, length:4};
+  } else if(typeof value === 'string') {
+    var size = Buffer.byteLength(value) + 1;
+    var bytes = new Buffer(size + 4);
+    bytes[0] = size & 0xff;
+    bytes[1] = (size >> 8) & 0xff;
+    bytes[2] = (size >> 16) & 0xff;
+    bytes[3] = (size >> 24) & 0xff;
+    bytes.write(value, 4, 'utf8');
+    bytes[size + 3] = 0;
+    return {type:BSONPure.BSON_DATA_STRING, bytes:bytes, start:0, length:size + 4};
+  }
+
+  // Anything else as the only element named 'v' of a document
+  var document = db.bson_serializer.BSON.serialize({v:value}, false, true);
+  if(document.length == 5) return null;
+  return {type:document[4], bytes:document, start:7, length:document.length - 8};
+}
+
+// Turn an array of field names into a field selector
+var normalizeFields = function(fields) {
+  if(!Array.isArray(fields)) return fields;
+  var selector = {};
+  if(fields.length == 0) selector['_id'] = 1;
+
+  for(var i = 0; i < fields.length; i++) {
+    selector[fields[i]] = 1;
+  }
+
+  return selector;
+}
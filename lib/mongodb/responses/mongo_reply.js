@@ -38,21 +38,47 @@ MongoReply.prototype.parseHeader = function(binary_reply, bson) {
   this.index = this.index + 4;  
 }
 
-MongoReply.prototype.parseBody = function(binary_reply, bson, raw) {
+MongoReply.prototype.parseBody = function(binary_reply, bson, raw, options) {
   raw = raw == null ? false : raw;
-  // Let's unpack all the bson document, deserialize them and store them
-  for(var object_index = 0; object_index < this.numberReturned; object_index++) {
-    // Read the size of the bson object    
-    var bsonObjectSize = binary_reply[this.index] | binary_reply[this.index + 1] << 8 | binary_reply[this.index + 2] << 16 | binary_reply[this.index + 3] << 24;
-    
-    // If we are storing the raw responses to pipe straight through
+  options = options == null ? {} : options;
+
+  // Only the documents matching the filter of the cursor are kept, the others are never decoded. The
+  // error document of a failed query is always kept
+  if(options.matcher != null && (this.responseFlag & 2) == 0) {
+    var matches = options.matcher.filter(binary_reply, this.index, this.numberReturned);
+    // Positions of the documents kept in the batch, the limit of a cursor counts them
+    this.ordinals = [];
+
     if(raw) {
-      // Deserialize the object and add to the documents array
-      this.documents.push(binary_reply.slice(this.index, this.index + bsonObjectSize));            
+      for(var i = 0; i < matches.length; i++) {
+        var bsonObjectSize = binary_reply[matches[i]] | binary_reply[matches[i] + 1] << 8 | binary_reply[matches[i] + 2] << 16 | binary_reply[matches[i] + 3] << 24;
+        this.documents.push(binary_reply.slice(matches[i], matches[i] + bsonObjectSize));
+      }
     } else {
-      // Deserialize the object and add to the documents array
-      this.documents.push(bson.BSON.deserialize(binary_reply.slice(this.index, this.index + bsonObjectSize)));      
+      // One call for all the matches so they share the decoded field names and interned strings
+      bson.BSON.deserializeStream(binary_reply, matches, matches.length, this.documents, this.documents.length, options);
+    }
+
+    // Step over the whole batch
+    for(var object_index = 0; object_index < this.numberReturned; object_index++) {
+      if(this.index === matches[this.ordinals.length]) this.ordinals.push(object_index);
+      this.index = this.index + (binary_reply[this.index] | binary_reply[this.index + 1] << 8 | binary_reply[this.index + 2] << 16 | binary_reply[this.index + 3] << 24);
     }
+    return;
+  }
+
+  // Deserialize the whole batch of documents in one call
+  if(!raw) {
+    this.index = bson.BSON.deserializeStream(binary_reply, this.index, this.numberReturned, this.documents, 0, options);
+    return;
+  }
+
+  // Let's unpack all the bson documents and store them
+  for(var object_index = 0; object_index < this.numberReturned; object_index++) {
+    // Read the size of the bson object    
+    var bsonObjectSize = binary_reply[this.index] | binary_reply[this.index + 1] << 8 | binary_reply[this.index + 2] << 16 | binary_reply[this.index + 3] << 24;
+    // We are storing the raw responses to pipe straight through
+    this.documents.push(binary_reply.slice(this.index, this.index + bsonObjectSize));            
     // Adjust binary index to point to next block of binary bson data
     this.index = this.index + bsonObjectSize;
   }          
@@ -3,7 +3,9 @@
 var testCase = require('../../deps/nodeunit').testCase,
   Buffer = require('buffer').Buffer,
   gleak = require('../../tools/gleak'),
-  Connection = require('../../lib/mongodb/connection/connection').Connection;
+  Connection = require('../../lib/mongodb/connection/connection').Connection,
+  BufferPool = require('../../lib/mongodb/connection/buffer_pool').BufferPool,
+  ConnectionPool = require('../../lib/mongodb/connection/connection_pool').ConnectionPool;
 
 var hexStringToBinary = exports.hexStringToBinary = function(string) {
   var numberofValues = string.length / 2;
@@ -373,6 +375,100 @@ var tests = testCase({
     test.done();
   },
 
+  'Should lease split messages from the buffer pool and reuse released buffers' : function(test) {
+    // Data object
+    var index = 0;
+    var buffer = new Buffer(2000);
+    var value = 2000;
+    // Encode length at start according to wire protocol
+    buffer[index + 3] = (value >> 24) & 0xff;      
+    buffer[index + 2] = (value >> 16) & 0xff;
+    buffer[index + 1] = (value >> 8) & 0xff;
+    buffer[index] = value & 0xff;            
+    buffer[1999] = 0xfe;
+
+    var bufferPool = new BufferPool();
+    var messages = [];
+    // Dummy object for receiving message
+    var self = {maxBsonSize: (4 * 1024 * 1024 * 4 * 3), bufferPool:bufferPool, emit:function(message, data) {
+      assertBuffersEqual(test, buffer, data);
+      messages.push(data);
+    }};
+
+    // Create a connection object
+    var dataHandler = Connection.createDataHandler(self);
+
+    // First message allocates a buffer
+    dataHandler(buffer.slice(0, 2));
+    dataHandler(buffer.slice(2, 1000));
+    dataHandler(buffer.slice(1000));
+    bufferPool.release(messages[0]);
+    // Second one reuses it
+    dataHandler(buffer.slice(0, 1000));
+    dataHandler(buffer.slice(1000));
+
+    test.equal(2, messages.length);
+    test.deepEqual({hits:1, misses:1, released:1, discarded:0, pooledBytes:0}, bufferPool.stats());
+    test.done();
+  },
+
+  'Should track requests in flight and checkout the least loaded connection' : function(test) {
+    // Id, requests and bytes in flight of the connections
+    var queueDepths = function(pool) {
+      return pool.connectionStats().map(function(stats) { return [stats.id, stats.requestsInFlight, stats.bytesInFlight]; });
+    }
+
+    var pool = new ConnectionPool('localhost', 27017, 2, null, {});
+    // Connections writing to a dummy socket
+    for(var i = 0; i < 2; i++) {
+      var connection = new Connection(i, pool.socketOptions, pool.bufferPool);
+      connection.connection = {write:function() {}};
+      pool.openConnections[i] = connection;
+    }
+
+    // A query and an insert on the first connection, only the query waits for a reply
+    pool.openConnections[0].write([header(100, 1, 0, 2004), header(50, 2, 0, 2002)]);
+    test.deepEqual([[0, 1, 100], [1, 0, 0]], queueDepths(pool));
+    test.equal(1, pool.checkoutConnection().id);
+    test.equal(1, pool.checkoutConnection().id);
+
+    // A larger getMore on the second one, ties go to the fewest bytes in flight
+    pool.openConnections[1].write(header(200, 3, 0, 2005));
+    test.equal(0, pool.checkoutConnection().id);
+    test.equal(0, pool.checkoutConnection().id);
+
+    // Replies free the connections up again
+    pool.openConnections[0].replyReceived(header(36, 10, 1, 1).toBinary());
+    pool.openConnections[1].replyReceived(header(36, 11, 3, 1).toBinary());
+    test.deepEqual([[0, 0, 0], [1, 0, 0]], queueDepths(pool));
+    test.done();
+  },
+
+  'Should write the messages of a tick in one socket write' : function(test) {
+    var data = [];
+    var connection = new Connection(0, {writeBatchSize:300}, new BufferPool());
+    connection.connection = {write:function(buffer) { data.push(buffer); }};
+
+    // Messages are held back until the end of the tick
+    connection.write([header(100, 1, 0, 2002), header(100, 2, 0, 2004)]);
+    connection.write(header(50, 3, 0, 2005));
+    test.equal(0, data.length);
+
+    process.nextTick(function() {
+      test.equal(1, data.length);
+      test.equal(250, data[0].length);
+      test.equal(3, data[0][200 + 4]);
+      test.deepEqual({writes:1, messages:3}, connection.writeStats());
+
+      // Reaching the batch size writes right away
+      connection.write([header(200, 4, 0, 2002), header(200, 5, 0, 2002)]);
+      test.equal(2, data.length);
+      test.equal(400, data[1].length);
+      test.deepEqual({writes:2, messages:5}, connection.writeStats());
+      test.done();
+    });
+  },
+
   noGlobalsLeaked : function(test) {
     var leaks = gleak.detectNew();
     test.equal(0, leaks.length, "global var leak detected: " + leaks.join(', '));
@@ -380,5 +476,17 @@ var tests = testCase({
   }
 });
 
+// Command writing a message header with the length, request id, response to and op code
+var header = function(size, requestId, responseTo, opCode) {
+  var buffer = new Buffer(size);
+  [size, requestId, responseTo, opCode].forEach(function(value, i) {
+    buffer[i*4] = value & 0xff;
+    buffer[i*4 + 1] = (value >> 8) & 0xff;
+    buffer[i*4 + 2] = (value >> 16) & 0xff;
+    buffer[i*4 + 3] = (value >> 24) & 0xff;
+  });
+  return {toBinary:function() { return buffer; }};
+}
+
 // Assign out tests
 module.exports = tests;
@@ -1009,6 +1009,86 @@ var tests = testCase({
     });        
   },
 
+  shouldCorrectlyPrefetchBatchesWhileIterating : function(test) {
+    client.createCollection('test_cursor_prefetch', function(err, collection) {
+      var docs = [];
+      for(var i = 0; i < 1000; i++) {
+        docs.push({'a':i});
+      }
+
+      collection.insert(docs, {safe:true}, function(err, result) {
+        collection.find({}, {batchSize:10, limit:995, prefetch:2, sort:'a'}, function(err, cursor) {
+          var count = 0;
+
+          cursor.each(function(err, item) {
+            test.equal(null, err);
+
+            if(item != null) {
+              test.equal(count, item.a);
+              // Never more batches held ahead than asked for
+              test.ok(cursor.prefetchedBatches.length <= 2);
+              count = count + 1;
+            } else {
+              test.equal(995, count);
+              test.ok(cursor.isClosed());
+              test.done();
+            }
+          });
+        });
+      });
+    });
+  },
+
+  shouldOnlyDecodeTheDecodeFieldsOfReturnedDocuments : function(test) {
+    client.createCollection('test_cursor_decode_fields', function(err, collection) {
+      var docs = [];
+      for(var i = 0; i < 50; i++) {
+        docs.push({'a':i, 'b':{'c':i}, 'd':'wide document ' + i, 'e':[i, i]});
+      }
+
+      collection.insert(docs, {safe:true}, function(err, result) {
+        collection.find({}, {decodeFields:['a', 'e'], batchSize:10, sort:'a'}).toArray(function(err, items) {
+          test.equal(null, err);
+          test.equal(50, items.length);
+          test.deepEqual({'a':7, 'e':[7, 7]}, items[7]);
+          test.done();
+        });
+      });
+    });
+  },
+
+  shouldOnlyReturnTheDocumentsMatchingTheFilter : function(test) {
+    client.createCollection('test_cursor_filter', function(err, collection) {
+      var docs = [];
+      for(var i = 0; i < 50; i++) {
+        docs.push({'a':i, 'b':{'c':i % 5}, 'd':i % 2 == 0 ? 'even ' + i : 'odd ' + i, 'e':[i, i + 1]});
+      }
+
+      collection.insert(docs, {safe:true}, function(err, result) {
+        // The whole second batch is dropped by the filter
+        var filter = {'$or':[{'a':{'$lt':5}}, {'a':{'$gte':20}, 'b.c':0, 'd':/^even/}], 'e':{'$in':[1, 2, 20, 41]}};
+        collection.find({}, {filter:filter, batchSize:10, sort:'a'}).toArray(function(err, items) {
+          test.equal(null, err);
+          test.deepEqual([0, 1, 20], items.map(function(item) { return item.a; }));
+
+          collection.find({}, {filter:filter, batchSize:10, sort:'a', raw:true}).toArray(function(err, items) {
+            test.equal(null, err);
+            test.equal(3, items.length);
+            test.ok(items[2] instanceof Buffer);
+            test.equal(20, client.bson_deserializer.BSON.deserialize(items[2]).a);
+
+            // The limit cuts the second batch after its second document, before the filter runs
+            collection.find({}, {filter:{'a':{'$in':[3, 10, 11, 15]}}, batchSize:10, limit:12, sort:'a'}).toArray(function(err, items) {
+              test.equal(null, err);
+              test.deepEqual([3, 10, 11], items.map(function(item) { return item.a; }));
+              test.done();
+            });
+          });
+        });
+      });
+    });
+  },
+
   // run this last
   noGlobalsLeaked: function(test) {
     var leaks = gleak.detectNew();
@@ -9,6 +9,7 @@ var testCase = require('../deps/nodeunit').testCase,
   Db = mongodb.Db,
   Cursor = mongodb.Cursor,
   Collection = mongodb.Collection,
+  PreparedQuery = mongodb.PreparedQuery,
   Server = mongodb.Server;
 
 var MONGODB = 'integration_tests';
@@ -942,6 +943,42 @@ var tests = testCase({
     });
   },
 
+  'Should run a prepared query with different values patched into its selector' : function(test) {
+    client.createCollection('should_run_prepared_queries', function(err, collection) {
+      collection.insert([{a:1, b:'x', c:1}, {a:2, b:'x', c:2}, {a:3, b:'yy', c:3}, {a:4, b:'x', c:4}], {safe:true}, function(err, result) {
+        var query = collection.prepareFind({a:{$gte:PreparedQuery.param('min')}, b:PreparedQuery.param('b')}, {sort:[['c', -1]], fields:{_id:0, c:1}});
+
+        query.find({min:2, b:'x'}, function(err, cursor) {
+          cursor.toArray(function(err, items) {
+            test.deepEqual([{c:4}, {c:2}], items);
+
+            // Same sizes, the values are written into a copy of the selector
+            query.find({min:1, b:'x'}).toArray(function(err, items) {
+              test.deepEqual([{c:4}, {c:2}, {c:1}], items);
+              test.equal(1, query.stats().builds);
+
+              // A longer string doesn't fit, the selector is serialized again
+              query.findOne({min:0, b:'yy'}, function(err, item) {
+                test.deepEqual({c:3}, item);
+                test.deepEqual({executions:3, builds:2}, query.stats());
+
+                // Count and a new sort go out with the query object
+                query.find({min:2, b:'x'}).count(function(err, count) {
+                  test.equal(2, count);
+
+                  query.find({min:2, b:'x'}).sort('c', 1).toArray(function(err, items) {
+                    test.deepEqual([{c:2}, {c:4}], items);
+                    test.done();
+                  });
+                });
+              });
+            });
+          });
+        });
+      });
+    });
+  },
+
   noGlobalsLeaked : function(test) {
     var leaks = gleak.detectNew();
     test.equal(0, leaks.length, "global var leak detected: " + leaks.join(', '));
@@ -566,6 +566,30 @@ var tests = testCase({
     });
   },
   
+  shouldCorrectlyCalculateMD5WhileWritingChunks : function(test) {
+    var crypto = require('crypto');
+    var data = new Buffer('hello world, this is written over several small chunks\n');
+    var gridStore = new GridStore(client, "test_gs_md5_chunks", "w", {chunk_size:5});
+    gridStore.open(function(err, gridStore) {
+      gridStore.write(data, function(err, gridStore) {
+        gridStore.close(function(err, result) {
+          test.equal(crypto.createHash('md5').update(data).digest('hex'), result.md5);
+
+          // Appending falls back to the server calculating the md5 of the whole file
+          var gridStore2 = new GridStore(client, "test_gs_md5_chunks", "w+");
+          gridStore2.open(function(err, gridStore) {
+            gridStore.write('more', function(err, gridStore) {
+              gridStore.close(function(err, result) {
+                test.equal(crypto.createHash('md5').update(data).update('more').digest('hex'), result.md5);
+                test.done();
+              });
+            });
+          });
+        });
+      });
+    });
+  },
+
   shouldCorrectlyUpdateUploadDate : function(test) {
     var now = new Date();
     var originalFileUploadDate = null;
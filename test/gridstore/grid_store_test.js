@@ -460,6 +460,78 @@ var tests = testCase({
     });
   },
   
+  shouldCorrectlyWriteFileWithSeveralChunksInFlight: function(test) {
+    var gridStore = new GridStore(client, 'test_gs_writing_file_in_flight', 'w', {chunk_size:1024, chunks_in_flight:3});
+    var data = fs.readFileSync('./test/gridstore/test_gs_weird_bug.png', 'binary');
+    var md5 = require('crypto').createHash('md5').update(data, 'binary').digest('hex');
+
+    gridStore.writeFile('./test/gridstore/test_gs_weird_bug.png', function(err, doc) {
+      test.equal(null, err);
+      test.equal(data.length, doc.length);
+      test.equal(md5, doc.md5);
+
+      GridStore.read(client, 'test_gs_writing_file_in_flight', function(err, fileData) {
+        test.equal(data, fileData);
+
+        // Every chunk was stored once
+        client.collection('fs.chunks', function(err, collection) {
+          collection.count({files_id:doc._id}, function(err, count) {
+            test.equal(Math.ceil(data.length/1024), count);
+            test.done();
+          });
+        });
+      });
+    });
+  },
+
+  shouldCorrectlyRewriteFileInEditMode: function(test) {
+    var data = fs.readFileSync('./test/gridstore/test_gs_weird_bug.png', 'binary');
+
+    new GridStore(client, 'test_gs_rewriting_file', 'w', {chunk_size:1024}).writeFile('./test/gridstore/test_gs_weird_bug.png', function(err, doc) {
+      // The chunks already stored are replaced, not duplicated
+      new GridStore(client, 'test_gs_rewriting_file', 'w+', {chunks_in_flight:3}).writeFile('./test/gridstore/test_gs_weird_bug.png', function(err, doc) {
+        test.equal(null, err);
+
+        client.collection('fs.chunks', function(err, collection) {
+          collection.count({files_id:doc._id}, function(err, count) {
+            test.equal(Math.ceil(data.length/1024), count);
+
+            GridStore.read(client, 'test_gs_rewriting_file', function(err, fileData) {
+              test.equal(data, fileData);
+              test.done();
+            });
+          });
+        });
+      });
+    });
+  },
+
+  shouldCorrectlyReadRangesAcrossChunks: function(test) {
+    var gridStore = new GridStore(client, 'test_gs_read_range', 'w', {chunk_size:1024});
+    var data = fs.readFileSync('./test/gridstore/test_gs_weird_bug.png', 'binary');
+
+    gridStore.writeFile('./test/gridstore/test_gs_weird_bug.png', function(err, doc) {
+      new GridStore(client, 'test_gs_read_range', 'r', {read_ahead:2}).open(function(err, gridStore) {
+        // Range spanning several chunks
+        gridStore.readRange(1000, 3000, function(err, buffer) {
+          test.equal(null, err);
+          test.equal(data.substr(1000, 3000), buffer.toString('binary'));
+
+          // Served from the chunks read ahead
+          gridStore.readRange(4000, 1500, function(err, buffer) {
+            test.equal(data.substr(4000, 1500), buffer.toString('binary'));
+
+            // Reads past the end are clamped to the file
+            gridStore.readRange(data.length - 10, 100, function(err, buffer) {
+              test.equal(data.substr(data.length - 10), buffer.toString('binary'));
+              test.done();
+            });
+          });
+        });
+      });
+    });
+  },
+
   shouldCorrectlyPerformWorkingFiledRead : function(test) {
     var gridStore = new GridStore(client, "test_gs_working_field_read", "w");
     var data = fs.readFileSync("./test/gridstore/test_gs_working_field_read.pdf", 'binary');
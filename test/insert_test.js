@@ -804,6 +804,67 @@ var tests = testCase({
     });
   },
   
+  'Should coalesce the inserts of a tick into one insert command' : function(test) {
+    var db = new Db(MONGODB, new Server('localhost', 27017, {auto_reconnect: true, poolSize: 1}), {native_parser: (process.env['TEST_NATIVE'] != null), coalesceInserts:true, coalesceMaxDocuments:100});
+    db.open(function(err, db) {
+      db.createCollection('test_should_coalesce_inserts', function(err, collection) {
+
+        Step(
+          function inserts() {
+            var group = this.group();
+
+            for(var i = 0; i < 250; i++) {
+              collection.insert({a:i}, {safe:true}, group());
+            }
+          },
+
+          function done(err, results) {
+            test.equal(null, err);
+            test.equal(250, results.length);
+            test.equal(249, results[249][0].a);
+            // Two full batches and the rest on the next tick
+            test.deepEqual({inserts:250, commands:3}, db.insertCoalescer.stats());
+
+            collection.count(function(err, count) {
+              test.equal(250, count);
+              db.close();
+              test.done();
+            });
+          }
+        )
+      });
+    });
+  },
+
+  'Should store the other coalesced inserts when one of them is rejected' : function(test) {
+    var db = new Db(MONGODB, new Server('localhost', 27017, {auto_reconnect: true, poolSize: 1}), {native_parser: (process.env['TEST_NATIVE'] != null), coalesceInserts:true});
+    db.open(function(err, db) {
+      db.createCollection('test_should_keep_going_coalesced_inserts', function(err, collection) {
+
+        Step(
+          function inserts() {
+            var group = this.group();
+            collection.insert({_id:1}, {safe:true}, group());
+            collection.insert({_id:1}, {safe:true}, group());
+            collection.insert({_id:2}, {safe:true}, group());
+          },
+
+          function done(err, results) {
+            // The error of the batch goes to each of its safe inserts
+            test.ok(err != null);
+            test.deepEqual({inserts:3, commands:1}, db.insertCoalescer.stats());
+
+            collection.count(function(err, count) {
+              test.equal(2, count);
+              db.close();
+              test.done();
+            });
+          }
+        )
+      });
+    });
+  },
+
   'Should Correctly fail to update returning 0 results' : function(test) {
     client.createCollection("Should_Correctly_fail_to_update_returning_0_results", {serializeFunctions:true}, function(err, collection) {
       test.ok(err == null);
@@ -115,6 +115,35 @@ var tests = testCase({
     });    
   },  
   
+  shouldStreamResultsAsOneJSONArray : function(test) {
+    var docs = []
+
+    for(var i = 0; i < 2500; i++) {
+      docs.push({'a':i, 'd':new Date(i)})
+    }
+
+    client.createCollection('test_streaming_results_as_json', function(err, collection) {
+      collection.insertAll(docs, {safe:true}, function(err, ids) {
+        collection.find({}, {'sort':'a', 'fields':{'_id':0}}, function(err, cursor) {
+          var stream = cursor.streamJSON({fetchSize:1000});
+          var chunks = [];
+
+          stream.on('data', function(data) {
+            chunks.push(data.toString());
+          });
+
+          stream.on('end', function(count) {
+            var items = JSON.parse(chunks.join(''));
+            test.equal(2500, count);
+            test.equal(2500, items.length);
+            test.deepEqual({'a':1999, 'd':{'$date':'1970-01-01T00:00:01.999Z'}}, items[1999]);
+            test.done();
+          });
+        });
+      });
+    });
+  },
+
   noGlobalsLeaked : function(test) {
     var leaks = gleak.detectNew();
     test.equal(0, leaks.length, "global var leak detected: " + leaks.join(', '));